@@ -0,0 +1,269 @@
+// ===================================================================
+// CALIBRATION CHECK
+// ===================================================================
+//
+// Checks the noise model of include/noise_calibration.h against a replay.
+// A baseline of noise is fitted the way `/sensitivity auto` does it (pin
+// polled every LOOP_DELAY, the first CALIBRATION_MAX_PULSES pulses kept),
+// the cooldown and debounce are chosen with the firmware's limits, and then
+// more noise from the same source is run through the detector's debounce,
+// session and alert spacing logic. The false alarms counted are printed
+// next to the ones predicted from the baseline and from a fit of all the
+// replayed noise (the model's error without the baseline's sampling error).
+//
+// The noise comes from built-in synthetic scenarios, or from a trace
+// recorded with host/trace_recorder: its first --baseline-min minutes are
+// the baseline and the rest is replayed.
+//
+//   g++ -std=c++11 -O2 -Iinclude host/calibration_check.cpp -o calibration_check
+//   ./calibration_check --days 60 --seed 2
+//   ./calibration_check hall.trace --baseline-min 30
+
+#include "noise_calibration.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+#include <vector>
+
+// Same defaults as config.h
+static const double LOOP_DELAY = 100;
+static const int MAX_PULSES = 256;
+static const CalibrationLimits LIMITS = {5000, 60000, 10000, 500, 100, 10000, 1.0f};
+
+static const double DAY = 86400000.0;
+
+struct Pulse {
+    double start;                               // ms
+    double end;
+};
+
+// ===================================================================
+// NOISE SOURCES
+// ===================================================================
+
+// Bursts arrive at random; a burst has a geometric number of pulses with
+// exponential gaps, pulse widths are log-normal
+struct Scenario {
+    const char* name;
+    double burstsPerHour;
+    double burstSize;                           // Mean pulses per burst
+    double burstGap;                            // Mean gap inside a burst (ms)
+    double widthMedian;                         // ms
+    double widthSigma;                          // Of log(width)
+};
+
+static const Scenario SCENARIOS[] = {
+    {"quiet", 0.5, 1, 1000, 300, 0.5},
+    {"poisson", 20, 1, 1000, 300, 0.5},
+    {"bursty", 6, 5, 1500, 300, 0.5},
+    {"noisy", 60, 3, 800, 300, 0.5},
+    {"glitches", 40, 2, 1000, 120, 0.6},        // Short pulses the debounce can drop
+};
+
+static std::vector<Pulse> generate(const Scenario& scenario, double length, std::mt19937& random) {
+    std::exponential_distribution<double> between(scenario.burstsPerHour / 3600000.0);
+    std::exponential_distribution<double> inside(1.0 / scenario.burstGap);
+    std::geometric_distribution<int> extra(1.0 / scenario.burstSize);
+    std::lognormal_distribution<double> width(log(scenario.widthMedian), scenario.widthSigma);
+
+    std::vector<Pulse> pulses;
+    for (double t = between(random); t < length; ) {
+        int count = extra(random) + 1;
+        for (int i = 0; i < count && t < length; i++) {
+            Pulse pulse = {t, t + width(random)};
+            pulses.push_back(pulse);
+            t = pulse.end + inside(random);
+        }
+        t += between(random);
+    }
+    return pulses;
+}
+
+// Pulses of a trace_recorder file, captures laid end to end. Returns the
+// length covered (ms), 0 if the file cannot be read
+static double readTrace(const char* path, std::vector<Pulse>& pulses) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 0;
+    }
+
+    double rate = 0, offset = 0, position = 0;
+    int active = 1, level = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        unsigned int samples = 0;
+        if (!strncmp(line, "capture ", 8)) {
+            const char* r = strstr(line, "rate=");
+            const char* act = strstr(line, "active=");
+            offset += position;
+            position = 0;
+            rate = r ? atof(r + 5) : 0;
+            active = act ? atoi(act + 7) : 1;
+        } else if (sscanf(line, "gap %u", &samples) == 1 && rate > 0) {
+            position += samples * 1000.0 / rate;    // Pulses in it are lost
+        } else if (sscanf(line, "%d %u", &level, &samples) == 2 && rate > 0) {
+            double ms = samples * 1000.0 / rate;
+            if (level == active && samples > 0) {
+                // A run split across packets continues the previous pulse
+                if (!pulses.empty() && pulses.back().end == offset + position) {
+                    pulses.back().end += ms;
+                } else {
+                    Pulse pulse = {offset + position, offset + position + ms};
+                    pulses.push_back(pulse);
+                }
+            }
+            position += ms;
+        }
+    }
+    fclose(in);
+    return offset + position;
+}
+
+// ===================================================================
+// FIRMWARE EMULATION
+// ===================================================================
+
+// The pulses as seen by a loop reading the pin every LOOP_DELAY: from the
+// first poll inside the pulse to the first poll after it. Pulses between
+// two polls are not seen at all.
+static std::vector<Pulse> poll(const std::vector<Pulse>& pulses) {
+    std::vector<Pulse> seen;
+    for (const Pulse& pulse : pulses) {
+        double start = ceil(pulse.start / LOOP_DELAY) * LOOP_DELAY;
+        if (start >= pulse.end) {
+            continue;
+        }
+        double end = ceil(pulse.end / LOOP_DELAY) * LOOP_DELAY;
+        if (!seen.empty() && start <= seen.back().end) {
+            seen.back().end = std::max(seen.back().end, end);
+        } else {
+            Pulse polled = {start, end};
+            seen.push_back(polled);
+        }
+    }
+    return seen;
+}
+
+// serviceCalibration() and fitCalibration() over [from, to)
+static CalibrationFit fitBaseline(const std::vector<Pulse>& seen, double from, double to, int maxPulses) {
+    std::vector<uint32_t> widths, gaps;
+    unsigned long count = 0;
+    double lastEnd = 0;
+    for (const Pulse& pulse : seen) {
+        if (pulse.start <= from || pulse.end > to) {
+            continue;                           // (A pulse running at the start is skipped)
+        }
+        if ((int)widths.size() < maxPulses) {
+            widths.push_back((uint32_t)(pulse.end - pulse.start));
+            gaps.push_back(count ? (uint32_t)(pulse.start - lastEnd) : 0);
+        }
+        count++;
+        lastEnd = pulse.end;
+    }
+    return fitCalibration(widths.data(), gaps.data(), (int)widths.size(), count, (unsigned long)(to - from));
+}
+
+// handleMotionDetection() and shouldSendNotification(): alerts in [from, to)
+static unsigned long countAlerts(const std::vector<Pulse>& seen, double from, double to, const CalibrationChoice& choice) {
+    unsigned long alerts = 0;
+    bool session = false;
+    double lastEnd = 0, lastAlert = -1e18;
+    for (const Pulse& pulse : seen) {
+        if (pulse.start < from || pulse.start >= to) {
+            continue;
+        }
+        // Motion from the first poll at least `debounce` into the pulse
+        double motion = pulse.start + ceil(choice.debounce / LOOP_DELAY) * LOOP_DELAY;
+        if (motion >= pulse.end) {
+            continue;
+        }
+        // A session ends at the first poll `cooldown` after the motion stopped
+        if (!session || motion - lastEnd > choice.cooldown) {
+            session = true;
+            if (motion - lastAlert >= LIMITS.spacing) {
+                alerts++;
+                lastAlert = motion;
+            }
+        }
+        lastEnd = pulse.end;
+    }
+    return alerts;
+}
+
+// ===================================================================
+// MAIN
+// ===================================================================
+
+static void printHeader() {
+    printf("%-10s %9s %9s %9s | %10s %10s | %10s %s\n", "noise", "pulses/d", "cooldown", "debounce", "baseline",
+           "replay fit", "counted", "(alerts)");
+}
+
+static void check(const char* name, const std::vector<Pulse>& pulses, double baseline, double length) {
+    std::vector<Pulse> seen = poll(pulses);
+    CalibrationFit fit = fitBaseline(seen, 0, baseline, MAX_PULSES);
+    CalibrationChoice choice = chooseCalibration(fit, LIMITS);
+
+    // The model with everything replayed fitted, and the alerts counted
+    CalibrationFit full = fitBaseline(seen, baseline, length, (int)seen.size());
+    float predicted = expectedFalseAlarms(full, choice.cooldown, LIMITS.spacing, choice.debounce);
+    unsigned long alerts = countAlerts(seen, baseline, length, choice);
+    double days = (length - baseline) / DAY;
+
+    printf("%-10s %9.0f %8.0fs %7.0fms | %10.2f %10.2f | %10.2f (%lu)\n", name, full.pulses / days,
+           choice.cooldown / 1000, choice.debounce, choice.falseAlarms, predicted, alerts / days, alerts);
+}
+
+int main(int argc, char** argv) {
+    const char* trace = nullptr;
+    double days = 30;
+    double baselineMinutes = 30;                // CALIBRATION_PERIOD
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--days" && hasValue) days = atof(argv[++i]);
+        else if (arg == "--baseline-min" && hasValue) baselineMinutes = atof(argv[++i]);
+        else if (arg == "--seed" && hasValue) seed = (unsigned)atoi(argv[++i]);
+        else if (!trace && arg[0] != '-') trace = argv[i];
+        else {
+            fprintf(stderr, "usage: %s [trace] [--baseline-min m] [--days d] [--seed n]\n"
+                            "Without a trace, synthetic noise is replayed for --days after the baseline.\n", argv[0]);
+            return 1;
+        }
+    }
+    double baseline = baselineMinutes * 60000;
+    if (baseline <= 0 || days <= 0) {
+        fprintf(stderr, "--baseline-min and --days must be positive\n");
+        return 1;
+    }
+
+    printf("False alarms per day: predicted from the %.0f min baseline, predicted from a fit of the\n"
+           "replayed noise, and counted in the replay\n\n", baselineMinutes);
+    printHeader();
+
+    if (trace) {
+        std::vector<Pulse> pulses;
+        double length = readTrace(trace, pulses);
+        if (length <= baseline) {
+            fprintf(stderr, "%s: %.1f min, not longer than the baseline\n", trace, length / 60000);
+            return 1;
+        }
+        check("trace", pulses, baseline, length);
+        return 0;
+    }
+
+    for (const Scenario& scenario : SCENARIOS) {
+        std::mt19937 random(seed);
+        double length = baseline + days * DAY;
+        check(scenario.name, generate(scenario, length, random), baseline, length);
+    }
+    return 0;
+}
@@ -0,0 +1,170 @@
+// ===================================================================
+// HOST CLUSTER NODE
+// ===================================================================
+//
+// Runs the detector's cluster coordinator on Linux so that leader
+// election, alert merging and failover can be tried with several
+// instances on one machine (multicast loopback is enabled).
+//
+//   g++ -std=c++11 -O2 -Iinclude host/cluster_node.cpp -o cluster_node
+//   ./cluster_node 1 hall --key s3cret &  ./cluster_node 2 stairs --key s3cret &
+//   ./cluster_node 3 door --key s3cret
+//
+// Each line on stdin ("m" or empty) reports motion on that node;
+// --motion-every <ms> reports it periodically. Kill the leader to see
+// the next node take over. --key must match CLUSTER_KEY on the detectors.
+
+#include "cluster_protocol.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+static const char* multicastGroup = "239.255.42.99";
+static uint16_t multicastPort = 42099;
+
+struct HostNode {
+    int socket;
+    sockaddr_in group;
+    ClusterCoordinator cluster;
+};
+
+static uint32_t monotonicMillis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+static void sendToGroup(const uint8_t* data, size_t length, void* context) {
+    HostNode* node = static_cast<HostNode*>(context);
+    sendto(node->socket, data, length, 0, (const sockaddr*)&node->group, sizeof(node->group));
+}
+
+static void printAlert(const ClusterAlert& alert, void* context) {
+    HostNode* node = static_cast<HostNode*>(context);
+    if (alert.sessionEnd) {
+        printf("[%u] building session ended: %u reports in %u ms\n", node->cluster.nodeId(), alert.events, alert.duration);
+    } else {
+        printf("[%u] ALERT%s: %u reports from", node->cluster.nodeId(), alert.failover ? " (failover)" : "", alert.events);
+        for (int i = 0; i < alert.nodeCount; i++) {
+            const char* name = node->cluster.nodeName(alert.nodes[i]);
+            printf(" %s#%u", name ? name : "?", alert.nodes[i]);
+        }
+        printf("\n");
+    }
+    fflush(stdout);
+}
+
+static int openMulticastSocket(HostNode& node) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+#ifdef SO_REUSEPORT
+    setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes));
+#endif
+
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(multicastPort);
+    local.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (const sockaddr*)&local, sizeof(local)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    ip_mreq membership = {};
+    membership.imr_multiaddr.s_addr = inet_addr(multicastGroup);
+    membership.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &membership, sizeof(membership)) < 0) {
+        close(fd);
+        return -1;
+    }
+    unsigned char loop = 1;
+    setsockopt(fd, IPPROTO_IP, IP_MULTICAST_LOOP, &loop, sizeof(loop));
+
+    node.group = sockaddr_in();
+    node.group.sin_family = AF_INET;
+    node.group.sin_port = htons(multicastPort);
+    node.group.sin_addr.s_addr = membership.imr_multiaddr.s_addr;
+    return fd;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "usage: %s <node id> <name> --key passphrase [--motion-every ms] [--group addr] [--port n]\n",
+                argv[0]);
+        return 1;
+    }
+
+    uint32_t nodeId = strtoul(argv[1], nullptr, 0);
+    uint32_t motionEvery = 0;
+    const char* key = "";
+    for (int i = 3; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--motion-every")) motionEvery = strtoul(argv[i + 1], nullptr, 0);
+        else if (!strcmp(argv[i], "--key")) key = argv[i + 1];
+        else if (!strcmp(argv[i], "--group")) multicastGroup = argv[i + 1];
+        else if (!strcmp(argv[i], "--port")) multicastPort = (uint16_t)atoi(argv[i + 1]);
+    }
+    if (nodeId == 0) {
+        fprintf(stderr, "node id must be non-zero\n");
+        return 1;
+    }
+    if (!*key) {
+        fprintf(stderr, "--key is required (the cluster passphrase)\n");
+        return 1;
+    }
+
+    static HostNode node;
+    node.socket = openMulticastSocket(node);
+    if (node.socket < 0) {
+        perror("multicast socket");
+        return 1;
+    }
+
+    // Same defaults as config.h
+    ClusterTiming timing = {1000, 3500, 750, 1500, 30000, 30};
+    // The start time grows with every restart, like the firmware's boot counter
+    node.cluster.begin(nodeId, argv[2], timing, clusterDeriveKey(key), (uint32_t)time(nullptr));
+    node.cluster.setCallbacks(sendToGroup, printAlert, &node);
+
+    uint32_t lastMotion = monotonicMillis();
+    uint32_t leader = 0;
+    bool stdinOpen = true;
+    for (;;) {
+        pollfd fds[2] = {{node.socket, POLLIN, 0}, {STDIN_FILENO, POLLIN, 0}};
+        poll(fds, stdinOpen ? 2 : 1, 20);
+        uint32_t now = monotonicMillis();
+
+        if (fds[0].revents & POLLIN) {
+            uint8_t buffer[256];
+            ssize_t length = recv(node.socket, buffer, sizeof(buffer), 0);
+            if (length > 0) node.cluster.receive(buffer, (size_t)length, now, (uint32_t)time(nullptr));
+        }
+        if (stdinOpen && (fds[1].revents & (POLLIN | POLLHUP))) {
+            char line[64];
+            if (fgets(line, sizeof(line), stdin)) {
+                node.cluster.localMotion(now, (uint32_t)time(nullptr));
+            } else {
+                stdinOpen = false;
+            }
+        }
+        if (motionEvery > 0 && now - lastMotion >= motionEvery) {
+            node.cluster.localMotion(now, (uint32_t)time(nullptr));
+            lastMotion = now;
+        }
+
+        node.cluster.tick(now, (uint32_t)time(nullptr));
+        if (node.cluster.leaderId() != leader) {
+            leader = node.cluster.leaderId();
+            printf("[%u] leader is now %u (%d peers)\n", nodeId, leader, node.cluster.peerCount());
+            fflush(stdout);
+        }
+    }
+}
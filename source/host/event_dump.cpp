@@ -0,0 +1,170 @@
+// ===================================================================
+// MOTION EVENT DUMP
+// ===================================================================
+//
+// Decodes binary motion event blocks (include/motion_event.h) and prints
+// one line per record. Input is a file of frames, each a little-endian
+// uint16 length followed by one block; "-" reads stdin. --hex reads a
+// serial log instead and decodes its "JOURNAL <hex>" lines (the journal
+// printed at boot). --bench encodes and decodes synthetic events to
+// measure the codec's throughput.
+//
+//   g++ -std=c++11 -O2 -Iinclude host/event_dump.cpp -o event_dump
+//   ./event_dump journal.bin
+//   ./event_dump --hex serial.log
+//   ./event_dump --bench 10000000
+
+#include "motion_event.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <vector>
+
+static const char* typeName(uint8_t type) {
+    static const char* const names[] = {"?", "boot", "start", "trigger", "end", "status", "error"};
+    return type < sizeof(names) / sizeof(names[0]) ? names[type] : "?";
+}
+
+static bool dumpBlock(const uint8_t* data, size_t length) {
+    MotionEventHeader header;
+    MotionEventReader reader(data, length);
+    if (!reader.readHeader(header)) {
+        return false;
+    }
+    printf("# device %08x \"%s\" boot %08x seq %u base %u ms wall %u\n", header.deviceId, header.name, header.boot,
+           header.firstSeq, header.baseUptime, header.wallClock);
+
+    MotionEventRecord record;
+    uint32_t seq = header.firstSeq;
+    while (reader.next(record)) {
+        printf("%u\t%u\t%-7s\tzone %u\tflags %02x", seq++, record.uptime, typeName(record.type), record.zone, record.flags);
+        if (record.duration) printf("\t%u ms", record.duration);
+        if (record.textLength) printf("\t%.*s", (int)record.textLength, record.text);
+        printf("\n");
+    }
+    return !reader.error();
+}
+
+static double seconds() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int bench(unsigned long events) {
+    // Blocks of 256 bytes, like the firmware journal
+    std::vector<uint8_t> blocks;
+    std::vector<size_t> offsets;
+    uint8_t block[256];
+    MotionEventWriter writer(block, sizeof(block));
+    MotionEventHeader header = {0x12345678, 42, 1, 1000, 1700000000, "bench"};
+    MotionEventRecord record = {};
+    uint32_t uptime = 1000;
+    srand(1);
+
+    double start = seconds();
+    writer.begin(header);
+    for (unsigned long i = 0; i < events; i++) {
+        uptime += rand() % 5000;
+        record.type = (i % 10 == 0) ? MOTION_EVENT_SESSION_START : (i % 10 == 9 ? MOTION_EVENT_SESSION_END : MOTION_EVENT_TRIGGER);
+        record.duration = record.type == MOTION_EVENT_SESSION_END ? rand() % 60000 : 0;
+        record.flags = record.type == MOTION_EVENT_SESSION_START ? MOTION_FLAG_NOTIFIED : 0;
+        record.uptime = uptime;
+        if (!writer.append(record)) {
+            offsets.push_back(blocks.size());
+            blocks.insert(blocks.end(), writer.data(), writer.data() + writer.size());
+            header.firstSeq = (uint32_t)i + 1;
+            header.baseUptime = uptime;
+            writer.begin(header);
+            writer.append(record);
+        }
+    }
+    offsets.push_back(blocks.size());
+    blocks.insert(blocks.end(), writer.data(), writer.data() + writer.size());
+    double encoded = seconds();
+
+    unsigned long decoded = 0;
+    uint64_t checksum = 0;
+    offsets.push_back(blocks.size());
+    for (size_t b = 0; b + 1 < offsets.size(); b++) {
+        MotionEventReader reader(blocks.data() + offsets[b], offsets[b + 1] - offsets[b]);
+        MotionEventHeader h;
+        if (!reader.readHeader(h)) return 1;
+        while (reader.next(record)) {
+            checksum += record.uptime + record.duration;
+            decoded++;
+        }
+    }
+    double done = seconds();
+
+    printf("%lu events in %zu blocks, %zu bytes (%.2f bytes/event)\n", events, offsets.size() - 1, blocks.size(),
+           (double)blocks.size() / events);
+    printf("encode %.1f M events/s, decode %.1f M events/s (%.0f MB/s), checksum %llu\n",
+           events / (encoded - start) / 1e6, decoded / (done - encoded) / 1e6,
+           blocks.size() / (done - encoded) / 1e6, (unsigned long long)checksum);
+    return decoded == events ? 0 : 1;
+}
+
+static int dumpHexLog(FILE* input) {
+    static char line[4096];
+    std::vector<uint8_t> block;
+    int status = 0;
+    while (fgets(line, sizeof(line), input)) {
+        const char* hex = strstr(line, "JOURNAL ");
+        if (!hex) continue;
+        block.clear();
+        for (hex += 8; isxdigit((unsigned char)hex[0]) && isxdigit((unsigned char)hex[1]); hex += 2) {
+            char byte[3] = {hex[0], hex[1], 0};
+            block.push_back((uint8_t)strtoul(byte, nullptr, 16));
+        }
+        if (!dumpBlock(block.data(), block.size())) {
+            fprintf(stderr, "malformed block\n");
+            status = 1;
+        }
+    }
+    return status;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <file|-> | --hex <log|-> | --bench [events]\n", argv[0]);
+        return 1;
+    }
+    if (!strcmp(argv[1], "--bench")) {
+        return bench(argc > 2 ? strtoul(argv[2], nullptr, 10) : 10000000UL);
+    }
+
+    bool hexLog = !strcmp(argv[1], "--hex");
+    const char* path = hexLog ? (argc > 2 ? argv[2] : "-") : argv[1];
+    FILE* input = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!input) {
+        perror(path);
+        return 1;
+    }
+    if (hexLog) {
+        int status = dumpHexLog(input);
+        if (input != stdin) fclose(input);
+        return status;
+    }
+
+    uint8_t prefix[2];
+    std::vector<uint8_t> block;
+    int status = 0;
+    while (fread(prefix, 1, 2, input) == 2) {
+        block.resize(prefix[0] | (prefix[1] << 8));
+        if (fread(block.data(), 1, block.size(), input) != block.size()) {
+            fprintf(stderr, "truncated frame\n");
+            status = 1;
+            break;
+        }
+        if (!dumpBlock(block.data(), block.size())) {
+            fprintf(stderr, "malformed block\n");
+            status = 1;
+        }
+    }
+    if (input != stdin) fclose(input);
+    return status;
+}
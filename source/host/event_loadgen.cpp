@@ -0,0 +1,134 @@
+// ===================================================================
+// FLEET LOAD GENERATOR
+// ===================================================================
+//
+// Simulates thousands of detectors sending UDP notifier events to the
+// relay (host/event_relay.cpp): mostly motion, some status texts, and a
+// share of repeated datagrams that the relay must drop. Like a real fleet
+// flashed from one config, every node reports the same device name and is
+// told apart by its id and location. With --key the datagrams are signed
+// like NOTIFY_UDP_KEY does on the devices.
+//
+//   g++ -std=c++11 -O2 -Iinclude host/event_loadgen.cpp -o event_loadgen
+//   ./event_loadgen --nodes 5000 --rate 20000 --seconds 30 --repeat 0.1
+
+#include "cluster_protocol.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct SimulatedNode {
+    uint32_t id;
+    char name[24];
+    uint32_t boot;
+    uint32_t seq;
+};
+
+static uint64_t monotonicMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int main(int argc, char** argv) {
+    const char* host = "127.0.0.1";
+    uint16_t port = 5005;
+    int nodeCount = 1000;
+    double rate = 5000;                         // Events per second, whole fleet
+    double seconds = 10;
+    double repeatShare = 0.05;                  // Events sent twice
+    double statusShare = 0.02;                  // Status texts instead of motion
+    bool sign = false;
+    ClusterKey key = {};
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        if (arg == "--host") host = argv[i + 1];
+        else if (arg == "--port") port = (uint16_t)atoi(argv[i + 1]);
+        else if (arg == "--nodes") nodeCount = atoi(argv[i + 1]);
+        else if (arg == "--rate") rate = atof(argv[i + 1]);
+        else if (arg == "--seconds") seconds = atof(argv[i + 1]);
+        else if (arg == "--repeat") repeatShare = atof(argv[i + 1]);
+        else if (arg == "--status") statusShare = atof(argv[i + 1]);
+        else if (arg == "--key") {
+            key = clusterDeriveKey(argv[i + 1]);
+            sign = true;
+        } else {
+            fprintf(stderr, "usage: %s [--host ip] [--port n] [--nodes n] [--rate events/s] [--seconds s] "
+                            "[--repeat share] [--status share] [--key passphrase]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (nodeCount < 1 || rate <= 0) {
+        fprintf(stderr, "--nodes and --rate must be positive\n");
+        return 1;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in relay = {};
+    relay.sin_family = AF_INET;
+    relay.sin_port = htons(port);
+    if (fd < 0 || inet_pton(AF_INET, host, &relay.sin_addr) != 1) {
+        fprintf(stderr, "bad relay address %s\n", host);
+        return 1;
+    }
+
+    std::mt19937 random(12345);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::vector<SimulatedNode> nodes(nodeCount);
+    for (int i = 0; i < nodeCount; i++) {
+        snprintf(nodes[i].name, sizeof(nodes[i].name), "node-%05d", i);
+        nodes[i].id = 0x10000000 + i;
+        nodes[i].boot = random();
+        nodes[i].seq = 0;
+    }
+
+    uint64_t start = monotonicMicros();
+    uint64_t end = start + (uint64_t)(seconds * 1e6);
+    double interval = 1e6 / rate;
+    unsigned long events = 0, datagrams = 0, errors = 0;
+    char body[256 + CLUSTER_MAC_SIZE];
+
+    // Paced by the schedule rather than by sleeps, so short sleeps that
+    // overshoot are caught up with a burst
+    for (double next = start; next < end; next += interval) {
+        uint64_t now = monotonicMicros();
+        if (now + 200 < next) {
+            std::this_thread::sleep_for(std::chrono::microseconds((uint64_t)next - now));
+        }
+
+        SimulatedNode& node = nodes[random() % nodeCount];
+        bool status = unit(random) < statusShare;
+        int length = snprintf(body, sizeof(body),
+                              "{\"device\":\"ESP32-Motion-Detector\",\"id\":\"%08x\",\"location\":\"%s\",\"class\":\"%s\","
+                              "\"text\":\"%s\",\"boot\":%u,\"seq\":%u}",
+                              node.id, node.name, status ? "status" : "motion", status ? "💓 System heartbeat" : ".",
+                              node.boot, ++node.seq);
+        if (sign) {
+            clusterPutMac(key, (const uint8_t*)body, length, (uint8_t*)body + length);
+            length += CLUSTER_MAC_SIZE;
+        }
+        int copies = unit(random) < repeatShare ? 2 : 1;
+        for (int c = 0; c < copies; c++) {
+            if (sendto(fd, body, length, 0, (const sockaddr*)&relay, sizeof(relay)) < 0) errors++;
+            else datagrams++;
+        }
+        events++;
+    }
+
+    double elapsed = (monotonicMicros() - start) / 1e6;
+    printf("%lu events (%lu datagrams, %lu send errors) from %d nodes in %.1fs = %.0f events/s\n",
+           events, datagrams, errors, nodeCount, elapsed, events / elapsed);
+    return 0;
+}
@@ -0,0 +1,789 @@
+// ===================================================================
+// FLEET EVENT RELAY
+// ===================================================================
+//
+// Linux daemon that collects events from many detectors and relays them to
+// Telegram, so a fleet shares one bot without every device polling and
+// posting on its own. Devices send their events with the UDP notifier
+// (NOTIFY_UDP_ENABLED pointing at this host, Telegram notifications off),
+// as JSON or as binary motion_event.h blocks (NOTIFY_UDP_BINARY).
+//
+// - Datagrams must end in the SipHash MAC of the devices' NOTIFY_UDP_KEY
+//   (--key); anything else is dropped, so nobody who can reach the port
+//   can post to the chats. --bind limits the interface the relay listens on.
+// - Duplicates (repeated datagrams, NOTIFY_UDP_REPEAT) are dropped by
+//   device, boot id and sequence number, and so are replays from a boot
+//   the device has since left. A device is told apart by its id
+//   (or, from senders without one, its address), never by DEVICE_NAME,
+//   which a fleet flashed from one config shares; messages name it by
+//   DEVICE_LOCATION.
+// - Events are batched: motion from any number of devices within the batch
+//   interval becomes one message, status and error texts are listed in it.
+// - A pool of worker threads keeps TLS connections to the Bot API open;
+//   a global token bucket and a per-chat interval keep the relay inside the
+//   API limits, and a 429 pauses the whole pool for retry_after. While
+//   messages are still waiting for the pool, new events keep collecting
+//   in the open batch, so an overload produces fewer, larger messages
+//   instead of a growing backlog. A batch held longer than --max-hold-ms
+//   is queued anyway, and every socket operation has a timeout, so a
+//   stalled connection cannot hold up the relay for good.
+//
+//   g++ -std=c++11 -O2 -pthread -Iinclude host/event_relay.cpp -o event_relay -lssl -lcrypto
+//   TELEGRAM_BOT_TOKEN=123:abc ./event_relay --chat 123456789 --key "fleet passphrase"
+//   ./event_relay --dry-run           # print instead of sending (load tests)
+
+#include "cluster_protocol.h"
+#include "motion_event.h"
+
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// ===================================================================
+// OPTIONS
+// ===================================================================
+
+struct RelayOptions {
+    uint16_t port = 5005;
+    in_addr bind = {htonl(INADDR_ANY)};
+    bool authenticate = false;                  // Set by --key
+    ClusterKey key = {};
+    std::string token;
+    std::vector<std::string> chats;
+    int poolSize = 2;
+    double globalRate = 25.0;                   // Messages per second across all chats
+    unsigned long chatInterval = 1000;          // Minimum spacing per chat (ms)
+    unsigned long batchInterval = 2000;         // Events collected into one message (ms)
+    unsigned long maxHold = 30000;              // Longest a due batch waits for an idle pool (ms)
+    unsigned long socketTimeout = 15000;        // Connect, send and receive timeout per operation (ms)
+    unsigned long statsInterval = 10000;
+    bool dryRun = false;
+    bool quiet = false;
+};
+
+static RelayOptions options;
+
+static uint64_t monotonicMillis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// ===================================================================
+// EVENT DECODING
+// ===================================================================
+
+// One datagram from the UDP notifier:
+// {"device":"…","id":"…","location":"…","class":"motion|status|error","text":"…","boot":N,"seq":N}
+struct DeviceEvent {
+    std::string key;                            // Identifies the device: id, or sender address
+    std::string label;                          // Shown in messages: location, else device name
+    std::string device;
+    std::string messageClass;
+    std::string text;
+    uint32_t boot = 0;
+    uint32_t seq = 0;
+};
+
+static void appendUtf8(std::string& out, unsigned code) {
+    if (code < 0x80) {
+        out += (char)code;
+    } else if (code < 0x800) {
+        out += (char)(0xC0 | (code >> 6));
+        out += (char)(0x80 | (code & 0x3F));
+    } else {
+        out += (char)(0xE0 | (code >> 12));
+        out += (char)(0x80 | ((code >> 6) & 0x3F));
+        out += (char)(0x80 | (code & 0x3F));
+    }
+}
+
+// Finds "key": and returns the position of its value, or npos
+static size_t findJsonValue(const char* body, size_t length, const char* key) {
+    size_t keyLength = strlen(key);
+    for (size_t i = 0; i + keyLength + 3 <= length; i++) {
+        if (body[i] == '"' && memcmp(body + i + 1, key, keyLength) == 0 && body[i + 1 + keyLength] == '"') {
+            size_t pos = i + keyLength + 2;
+            while (pos < length && (body[pos] == ' ' || body[pos] == ':')) pos++;
+            return pos;
+        }
+    }
+    return std::string::npos;
+}
+
+static bool jsonString(const char* body, size_t length, const char* key, std::string& out) {
+    size_t pos = findJsonValue(body, length, key);
+    if (pos == std::string::npos || pos >= length || body[pos] != '"') {
+        return false;
+    }
+    out.clear();
+    for (pos++; pos < length; pos++) {
+        char c = body[pos];
+        if (c == '"') return true;
+        if (c != '\\') {
+            out += c;
+            continue;
+        }
+        if (++pos >= length) return false;
+        switch (body[pos]) {
+            case 'n': out += '\n'; break;
+            case 'r': out += '\r'; break;
+            case 't': out += '\t'; break;
+            case 'u':
+                if (pos + 4 >= length) return false;
+                appendUtf8(out, (unsigned)strtoul(std::string(body + pos + 1, 4).c_str(), nullptr, 16));
+                pos += 4;
+                break;
+            default: out += body[pos]; break;
+        }
+    }
+    return false;
+}
+
+static bool jsonNumber(const char* body, size_t length, const char* key, uint32_t& out) {
+    size_t pos = findJsonValue(body, length, key);
+    if (pos == std::string::npos || pos >= length || body[pos] < '0' || body[pos] > '9') {
+        return false;
+    }
+    uint64_t value = 0;
+    while (pos < length && body[pos] >= '0' && body[pos] <= '9') {
+        value = value * 10 + (body[pos++] - '0');
+    }
+    out = (uint32_t)value;
+    return true;
+}
+
+// `sender` identifies devices that send no id
+static bool decodeEvent(const char* body, size_t length, const std::string& sender, DeviceEvent& event) {
+    if (!jsonString(body, length, "device", event.device) || !jsonString(body, length, "text", event.text)) {
+        return false;
+    }
+    if (!jsonString(body, length, "id", event.key) || event.key.empty()) event.key = sender;
+    if (!jsonString(body, length, "location", event.label) || event.label.empty()) event.label = event.device;
+    if (!jsonString(body, length, "class", event.messageClass)) event.messageClass = "status";
+    event.boot = 0;
+    event.seq = 0;
+    jsonNumber(body, length, "boot", event.boot);
+    jsonNumber(body, length, "seq", event.seq);
+    return true;
+}
+
+// A binary block; motion starts and triggers, status and error records
+// become events, the rest (boot, session end) is not relayed
+static void decodeBlock(const uint8_t* data, size_t length, std::vector<DeviceEvent>& events) {
+    MotionEventHeader header;
+    MotionEventReader reader(data, length);
+    if (!reader.readHeader(header)) {
+        return;
+    }
+    char id[12];
+    snprintf(id, sizeof(id), "%08x", header.deviceId);
+
+    MotionEventRecord record;
+    for (uint32_t seq = header.firstSeq; reader.next(record); seq++) {
+        DeviceEvent event;
+        switch (record.type) {
+            case MOTION_EVENT_SESSION_START:
+            case MOTION_EVENT_TRIGGER: event.messageClass = "motion"; break;
+            case MOTION_EVENT_STATUS: event.messageClass = "status"; break;
+            case MOTION_EVENT_ERROR: event.messageClass = "error"; break;
+            default: continue;
+        }
+        event.device = header.name[0] ? header.name : id;
+        event.key = id;                         // Same key as the JSON "id" of this device
+        event.label = event.device;
+        event.text = record.textLength ? std::string(record.text, record.textLength) : ".";
+        event.boot = header.boot;
+        event.seq = seq;
+        events.push_back(event);
+    }
+}
+
+static std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size() + 16);
+    for (char c : text) {
+        switch (c) {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
+// ===================================================================
+// DEDUPLICATION
+// ===================================================================
+
+// Remembers the last 64 sequence numbers of each device's current boot
+// and the ids of its earlier boots
+class DuplicateFilter {
+public:
+    bool isDuplicate(const DeviceEvent& event) {
+        if (event.seq == 0) {
+            return false;                       // Sender without sequence numbers
+        }
+        Stream& stream = streams_[event.key];
+        if (stream.boot != event.boot || stream.highest == 0) {
+            for (uint32_t boot : stream.pastBoots) {
+                if (boot != 0 && boot == event.boot) return true;   // Replay from an earlier boot
+            }
+            if (stream.highest != 0) {
+                memmove(stream.pastBoots + 1, stream.pastBoots, sizeof(stream.pastBoots) - sizeof(uint32_t));
+                stream.pastBoots[0] = stream.boot;
+            }
+            stream.boot = event.boot;           // New device, or it rebooted
+            stream.highest = event.seq;
+            stream.seen = 1;
+            return false;
+        }
+
+        if (event.seq > stream.highest) {
+            uint32_t shift = event.seq - stream.highest;
+            stream.seen = shift >= 64 ? 0 : stream.seen << shift;
+            stream.seen |= 1;
+            stream.highest = event.seq;
+            return false;
+        }
+        uint32_t age = stream.highest - event.seq;
+        if (age >= 64) {
+            return true;                        // Too old to tell; treat as a late duplicate
+        }
+        bool seen = stream.seen & (1ULL << age);
+        stream.seen |= 1ULL << age;
+        return seen;
+    }
+
+    size_t devices() const { return streams_.size(); }
+
+private:
+    struct Stream {
+        uint32_t boot = 0;
+        uint32_t highest = 0;
+        uint64_t seen = 0;                      // Bit n: highest - n was received
+        uint32_t pastBoots[4] = {};             // Most recent first
+    };
+    std::unordered_map<std::string, Stream> streams_;
+};
+
+// ===================================================================
+// BATCHING
+// ===================================================================
+
+class EventBatcher {
+public:
+    void add(const DeviceEvent& event, uint64_t now) {
+        if (empty()) openedAt_ = now;
+        if (event.messageClass == "motion") {
+            MotionCount& count = motion_[event.key];
+            count.label = event.label;
+            count.events++;
+            motionEvents_++;
+        } else {
+            lines_.push_back((event.messageClass == "error" ? "❌ " : "📟 ") + event.label + ": " + event.text);
+        }
+    }
+
+    bool due(uint64_t now) const {
+        return !empty() && now - openedAt_ >= options.batchInterval;
+    }
+
+    // Time since the batch opened
+    uint64_t age(uint64_t now) const { return empty() ? 0 : now - openedAt_; }
+
+    bool empty() const { return motion_.empty() && lines_.empty(); }
+
+    // Builds the message and starts a new batch; stays under the Bot API's 4096 characters
+    std::string take() {
+        std::string message;
+        if (!motion_.empty()) {
+            std::vector<MotionCount> devices;
+            devices.reserve(motion_.size());
+            for (const auto& entry : motion_) devices.push_back(entry.second);
+            std::stable_sort(devices.begin(), devices.end(),
+                             [](const MotionCount& a, const MotionCount& b) { return a.events > b.events; });
+            message = "🚨 Motion:";
+            size_t shown = 0;
+            for (; shown < devices.size() && message.size() < 3000; shown++) {
+                message += (shown ? ", " : " ") + devices[shown].label;
+            }
+            if (shown < devices.size()) message += ", +" + std::to_string(devices.size() - shown) + " more";
+            if (motionEvents_ > devices.size()) message += " (" + std::to_string(motionEvents_) + " events)";
+        }
+        size_t shown = 0;
+        for (; shown < lines_.size() && message.size() + lines_[shown].size() < 3900; shown++) {
+            if (!message.empty()) message += "\n";
+            message += lines_[shown];
+        }
+        if (shown < lines_.size()) message += "\n+" + std::to_string(lines_.size() - shown) + " more messages";
+
+        motion_.clear();
+        lines_.clear();
+        motionEvents_ = 0;
+        return message;
+    }
+
+private:
+    struct MotionCount {
+        std::string label;
+        unsigned events = 0;
+    };
+
+    std::map<std::string, MotionCount> motion_;
+    std::vector<std::string> lines_;
+    size_t motionEvents_ = 0;
+    uint64_t openedAt_ = 0;
+};
+
+// ===================================================================
+// TELEGRAM CONNECTION POOL
+// ===================================================================
+
+struct RelayStats {
+    std::atomic<unsigned long> datagrams{0};
+    std::atomic<unsigned long> malformed{0};
+    std::atomic<unsigned long> unauthenticated{0};
+    std::atomic<unsigned long> duplicates{0};
+    std::atomic<unsigned long> batches{0};
+    std::atomic<unsigned long> sent{0};
+    std::atomic<unsigned long> failed{0};
+    std::atomic<unsigned long> rateLimited{0};
+    std::atomic<unsigned long> connects{0};
+};
+
+static RelayStats stats;
+
+struct OutboundMessage {
+    std::string chat;
+    std::string text;
+    int attempts = 0;
+};
+
+// Global token bucket plus per-chat spacing; a 429 blocks everyone
+class RateLimiter {
+public:
+    // Waits until `chat` may be sent to and takes a token
+    void acquire(const std::string& chat) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            uint64_t now = monotonicMillis();
+            refill(now);
+            uint64_t chatReady = nextPerChat_[chat];
+            uint64_t wait = 0;
+            if (now < pausedUntil_) wait = pausedUntil_ - now;
+            else if (now < chatReady) wait = chatReady - now;
+            else if (tokens_ < 1.0) wait = (uint64_t)((1.0 - tokens_) * 1000.0 / options.globalRate) + 1;
+            if (wait == 0) {
+                tokens_ -= 1.0;
+                nextPerChat_[chat] = now + options.chatInterval;
+                return;
+            }
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+            lock.lock();
+        }
+    }
+
+    void pause(unsigned long seconds) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pausedUntil_ = std::max(pausedUntil_, monotonicMillis() + seconds * 1000);
+    }
+
+private:
+    void refill(uint64_t now) {
+        if (lastRefill_ != 0) {
+            tokens_ = std::min(options.globalRate, tokens_ + (now - lastRefill_) * options.globalRate / 1000.0);
+        }
+        lastRefill_ = now;
+    }
+
+    std::mutex mutex_;
+    double tokens_ = 1.0;
+    uint64_t lastRefill_ = 0;
+    uint64_t pausedUntil_ = 0;
+    std::unordered_map<std::string, uint64_t> nextPerChat_;
+};
+
+// One persistent HTTPS connection to the Bot API
+class BotConnection {
+public:
+    explicit BotConnection(SSL_CTX* context) : context_(context) {}
+    ~BotConnection() { close(); }
+
+    // POSTs a JSON body; returns the HTTP status (-1 on connection failure)
+    int post(const std::string& path, const std::string& body, std::string& response) {
+        for (int attempt = 0; attempt < 2; attempt++) {
+            if (!ssl_ && !open()) return -1;
+            std::string request = "POST " + path + " HTTP/1.1\r\nHost: api.telegram.org\r\n"
+                                  "Content-Type: application/json\r\nConnection: keep-alive\r\n"
+                                  "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+            int status = -1;
+            if (writeAll(request) && (status = readResponse(response)) > 0) {
+                return status;
+            }
+            close();                            // Stale keep-alive connection: retry once on a new one
+        }
+        return -1;
+    }
+
+private:
+    bool open() {
+        addrinfo hints = {}, *result = nullptr;
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo("api.telegram.org", "443", &hints, &result) != 0) return false;
+        fd_ = socket(result->ai_family, result->ai_socktype, result->ai_protocol);
+        if (fd_ >= 0) {
+            // Bounds connect(), the TLS handshake and every read and write
+            timeval timeout = {(time_t)(options.socketTimeout / 1000), (suseconds_t)(options.socketTimeout % 1000 * 1000)};
+            setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+            setsockopt(fd_, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        }
+        bool connected = fd_ >= 0 && connect(fd_, result->ai_addr, result->ai_addrlen) == 0;
+        freeaddrinfo(result);
+        if (!connected) {
+            close();
+            return false;
+        }
+
+        ssl_ = SSL_new(context_);
+        SSL_set_fd(ssl_, fd_);
+        SSL_set_tlsext_host_name(ssl_, "api.telegram.org");
+        SSL_set1_host(ssl_, "api.telegram.org");
+        if (SSL_connect(ssl_) != 1) {
+            close();
+            return false;
+        }
+        stats.connects++;
+        return true;
+    }
+
+    void close() {
+        if (ssl_) {
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+        }
+        if (fd_ >= 0) {
+            ::close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    bool writeAll(const std::string& data) {
+        size_t offset = 0;
+        while (offset < data.size()) {
+            int written = SSL_write(ssl_, data.data() + offset, (int)(data.size() - offset));
+            if (written <= 0) return false;
+            offset += written;
+        }
+        return true;
+    }
+
+    int readResponse(std::string& body) {
+        std::string data;
+        char buffer[4096];
+        size_t headerEnd;
+        while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos) {
+            int n = SSL_read(ssl_, buffer, sizeof(buffer));
+            if (n <= 0) return -1;
+            data.append(buffer, n);
+        }
+
+        int status = atoi(data.c_str() + data.find(' ') + 1);
+        size_t contentLength = 0;
+        size_t lengthPos = data.find("Content-Length:");
+        if (lengthPos == std::string::npos) lengthPos = data.find("content-length:");
+        if (lengthPos != std::string::npos && lengthPos < headerEnd) {
+            contentLength = strtoul(data.c_str() + lengthPos + 15, nullptr, 10);
+        }
+        body = data.substr(headerEnd + 4);
+        while (body.size() < contentLength) {
+            int n = SSL_read(ssl_, buffer, sizeof(buffer));
+            if (n <= 0) return -1;
+            body.append(buffer, n);
+        }
+        return status;
+    }
+
+    SSL_CTX* context_;
+    SSL* ssl_ = nullptr;
+    int fd_ = -1;
+};
+
+class RelayPool {
+public:
+    void start() {
+        if (!options.dryRun) {
+            SSL_library_init();
+            SSL_load_error_strings();
+            context_ = SSL_CTX_new(TLS_client_method());
+            SSL_CTX_set_default_verify_paths(context_);
+            SSL_CTX_set_verify(context_, SSL_VERIFY_PEER, nullptr);
+        }
+        for (int i = 0; i < options.poolSize; i++) {
+            workers_.emplace_back(&RelayPool::run, this);
+        }
+    }
+
+    void submit(const OutboundMessage& message) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(message);
+        ready_.notify_one();
+    }
+
+    size_t depth() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return queue_.size();
+    }
+
+private:
+    void run() {
+        BotConnection connection(context_);
+        for (;;) {
+            OutboundMessage message;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                ready_.wait(lock, [this] { return !queue_.empty(); });
+                message = queue_.front();
+                queue_.pop_front();
+            }
+
+            limiter_.acquire(message.chat);
+            if (options.dryRun) {
+                if (!options.quiet) {
+                    printf("→ %s: %s\n", message.chat.c_str(), message.text.c_str());
+                    fflush(stdout);
+                }
+                stats.sent++;
+                continue;
+            }
+
+            std::string response;
+            std::string body = "{\"chat_id\":\"" + jsonEscape(message.chat) + "\",\"text\":\"" + jsonEscape(message.text) + "\"}";
+            int status = connection.post("/bot" + options.token + "/sendMessage", body, response);
+            if (status == 200) {
+                stats.sent++;
+                continue;
+            }
+
+            if (status == 429) {
+                stats.rateLimited++;
+                uint32_t retryAfter = 5;
+                jsonNumber(response.data(), response.size(), "retry_after", retryAfter);
+                limiter_.pause(retryAfter);
+            }
+            if ((status == 429 || status < 0 || status >= 500) && ++message.attempts < 3) {
+                submit(message);                // Transient: try again later
+            } else {
+                stats.failed++;
+                fprintf(stderr, "sendMessage to %s failed (HTTP %d)\n", message.chat.c_str(), status);
+            }
+        }
+    }
+
+    SSL_CTX* context_ = nullptr;
+    RateLimiter limiter_;
+    std::mutex mutex_;
+    std::condition_variable ready_;
+    std::deque<OutboundMessage> queue_;
+    std::vector<std::thread> workers_;
+};
+
+// ===================================================================
+// MAIN
+// ===================================================================
+
+static int openSocket(in_addr address, uint16_t port) {
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) return -1;
+    int bufferSize = 8 * 1024 * 1024;           // Absorb bursts from thousands of devices
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &bufferSize, sizeof(bufferSize));
+    sockaddr_in local = {};
+    local.sin_family = AF_INET;
+    local.sin_port = htons(port);
+    local.sin_addr = address;
+    if (bind(fd, (const sockaddr*)&local, sizeof(local)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void usage(const char* program) {
+    fprintf(stderr,
+            "usage: %s --key passphrase [--bind ip] [--port n] [--chat id]... [--pool n] [--rate msg/s]\n"
+            "          [--chat-interval ms] [--batch-ms ms] [--max-hold-ms ms] [--timeout-ms ms] [--stats-ms ms]\n"
+            "          [--dry-run] [--quiet]\n"
+            "The bot token is read from TELEGRAM_BOT_TOKEN. --key is the devices' NOTIFY_UDP_KEY;\n"
+            "only --dry-run accepts unsigned datagrams.\n", program);
+}
+
+int main(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--dry-run") options.dryRun = true;
+        else if (arg == "--quiet") options.quiet = true;
+        else if (arg == "--port" && hasValue) options.port = (uint16_t)atoi(argv[++i]);
+        else if (arg == "--bind" && hasValue && inet_pton(AF_INET, argv[i + 1], &options.bind) == 1) i++;
+        else if (arg == "--key" && hasValue && argv[i + 1][0]) {
+            options.key = clusterDeriveKey(argv[++i]);
+            options.authenticate = true;
+        }
+        else if (arg == "--chat" && hasValue) options.chats.push_back(argv[++i]);
+        else if (arg == "--pool" && hasValue) options.poolSize = std::max(1, atoi(argv[++i]));
+        else if (arg == "--rate" && hasValue) options.globalRate = std::max(0.1, atof(argv[++i]));
+        else if (arg == "--chat-interval" && hasValue) options.chatInterval = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--batch-ms" && hasValue) options.batchInterval = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--max-hold-ms" && hasValue) options.maxHold = strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--timeout-ms" && hasValue) options.socketTimeout = std::max(1UL, strtoul(argv[++i], nullptr, 10));
+        else if (arg == "--stats-ms" && hasValue) options.statsInterval = strtoul(argv[++i], nullptr, 10);
+        else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    const char* token = getenv("TELEGRAM_BOT_TOKEN");
+    if (token) options.token = token;
+    if (options.chats.empty()) options.chats.push_back("dry-run");
+    if (!options.dryRun && (options.token.empty() || options.chats[0] == "dry-run" || !options.authenticate)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // A connection the server closed must fail the write, not kill the relay
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = openSocket(options.bind, options.port);
+    if (fd < 0) {
+        perror("bind");
+        return 1;
+    }
+
+    RelayPool pool;
+    pool.start();
+    DuplicateFilter duplicates;
+    EventBatcher batcher;
+    char address[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET, &options.bind, address, sizeof(address));
+    printf("Relaying UDP %s:%u to %zu chat(s) through %d connection(s)%s%s\n", address, options.port,
+           options.chats.size(), options.poolSize, options.dryRun ? " (dry run)" : "",
+           options.authenticate ? "" : ", unsigned datagrams accepted");
+    fflush(stdout);
+
+    // Datagrams are read in bursts of up to 64 per system call
+    static const int BURST = 64;
+    static char buffers[BURST][1500];
+    mmsghdr messages[BURST];
+    iovec vectors[BURST];
+    sockaddr_in senders[BURST];
+    uint64_t lastStats = monotonicMillis();
+    unsigned long lastDatagrams = 0;
+
+    for (;;) {
+        pollfd pfd = {fd, POLLIN, 0};
+        poll(&pfd, 1, 50);
+        uint64_t now = monotonicMillis();
+
+        if (pfd.revents & POLLIN) {
+            for (int i = 0; i < BURST; i++) {
+                vectors[i] = {buffers[i], sizeof(buffers[i])};
+                messages[i] = mmsghdr();
+                messages[i].msg_hdr.msg_iov = &vectors[i];
+                messages[i].msg_hdr.msg_iovlen = 1;
+                messages[i].msg_hdr.msg_name = &senders[i];
+                messages[i].msg_hdr.msg_namelen = sizeof(senders[i]);
+            }
+            int count = recvmmsg(fd, messages, BURST, MSG_DONTWAIT, nullptr);
+            std::vector<DeviceEvent> events;
+            for (int i = 0; i < count; i++) {
+                stats.datagrams++;
+                events.clear();
+                const char* body = buffers[i];
+                size_t length = messages[i].msg_len;
+                if (options.authenticate) {
+                    if (!clusterCheckMac(options.key, (const uint8_t*)body, length)) {
+                        stats.unauthenticated++;
+                        continue;
+                    }
+                    length -= CLUSTER_MAC_SIZE;
+                }
+                if (length >= 2 && body[0] == 'M' && body[1] == 'E') {
+                    decodeBlock((const uint8_t*)body, length, events);
+                } else {
+                    char sender[INET_ADDRSTRLEN] = "";
+                    inet_ntop(AF_INET, &senders[i].sin_addr, sender, sizeof(sender));
+                    events.resize(1);
+                    if (!decodeEvent(body, length, sender, events[0])) events.clear();
+                }
+                if (events.empty()) {
+                    stats.malformed++;
+                }
+                for (const DeviceEvent& event : events) {
+                    if (duplicates.isDuplicate(event)) {
+                        stats.duplicates++;
+                    } else {
+                        batcher.add(event, now);
+                    }
+                }
+            }
+        }
+
+        if (batcher.due(now) && (pool.depth() == 0 || batcher.age(now) >= options.maxHold)) {
+            std::string text = batcher.take();
+            stats.batches++;
+            for (const std::string& chat : options.chats) {
+                OutboundMessage message;
+                message.chat = chat;
+                message.text = text;
+                pool.submit(message);
+            }
+        }
+
+        if (options.statsInterval > 0 && now - lastStats >= options.statsInterval) {
+            unsigned long datagrams = stats.datagrams;
+            printf("📊 %.0f events/s | %lu received, %lu unauthenticated, %lu malformed, %lu duplicates | %zu devices | "
+                   "%lu batches, %lu sent, %lu failed, %lu rate-limited, %zu queued, %lu connects\n",
+                   (datagrams - lastDatagrams) * 1000.0 / (now - lastStats), datagrams, stats.unauthenticated.load(),
+                   stats.malformed.load(), stats.duplicates.load(), duplicates.devices(), stats.batches.load(),
+                   stats.sent.load(), stats.failed.load(), stats.rateLimited.load(), pool.depth(),
+                   stats.connects.load());
+            fflush(stdout);
+            lastStats = now;
+            lastDatagrams = datagrams;
+        }
+    }
+}
@@ -0,0 +1,314 @@
+// ===================================================================
+// PIR TRACE RECORDER
+// ===================================================================
+//
+// Records the raw PIR trace streamed by the firmware's /trace command
+// (include/pir_trace.h frames mixed into the serial log) into a trace file
+// for replay benchmarks. The input is a serial device, a saved serial log
+// or "-" for stdin; it stops after the capture's STOP packet unless --keep
+// is given. --summary prints pulse statistics of a recorded trace.
+//
+//   g++ -std=c++11 -O2 -Iinclude host/trace_recorder.cpp -o trace_recorder
+//   ./trace_recorder /dev/ttyUSB0 -o hall.trace --echo
+//   ./trace_recorder --summary hall.trace
+//
+// Trace file, one line per run of the pin at the capture's sample rate:
+//
+//   capture rate=5000 pin=4 active=1 boot=1a2b3c4d uptime=123456
+//   0 41250          <level> <samples>
+//   1 12500
+//   gap 380          samples lost (dropped runs or a corrupted frame)
+//   end samples=60000 dropped=0
+
+#include "pir_trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+struct RecorderStats {
+    unsigned long frames = 0;
+    unsigned long badFrames = 0;
+    unsigned long lostPackets = 0;
+    unsigned long runs = 0;
+    unsigned long gaps = 0;
+    unsigned long captures = 0;
+};
+
+struct TraceWriter {
+    FILE* out = nullptr;
+    bool capturing = false;
+    int pendingLevel = -1;              // Run not written yet (merges split runs)
+    uint32_t pendingLength = 0;
+    uint32_t nextSample = 0;
+    uint16_t nextSeq = 0;
+    RecorderStats stats;
+
+    void flushRun() {
+        if (pendingLevel >= 0) {
+            fprintf(out, "%d %u\n", pendingLevel, pendingLength);
+            stats.runs++;
+        }
+        pendingLevel = -1;
+        pendingLength = 0;
+    }
+
+    void run(int level, uint32_t length) {
+        if (length == 0) return;
+        if (level != pendingLevel) {
+            flushRun();
+            pendingLevel = level;
+        }
+        pendingLength += length;
+        nextSample += length;
+    }
+
+    void gap(uint32_t samples) {
+        flushRun();
+        fprintf(out, "gap %u\n", samples);
+        stats.gaps++;
+    }
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void onSignal(int) {
+    interrupted = 1;
+}
+
+// Log text has no control characters besides line breaks and tabs; every
+// frame header has some
+static bool isBinary(const std::vector<uint8_t>& chunk) {
+    for (uint8_t c : chunk) {
+        if (c < 0x20 && c != '\r' && c != '\n' && c != '\t') return true;
+    }
+    return false;
+}
+
+// Returns false once the capture has ended
+static bool handlePacket(TraceWriter& writer, const PirTracePacket& packet) {
+    const uint8_t* p = packet.payload;
+    size_t length = packet.payloadLength;
+
+    if (writer.capturing && packet.seq != writer.nextSeq) {
+        writer.stats.lostPackets += (uint16_t)(packet.seq - writer.nextSeq);
+    }
+    writer.nextSeq = packet.seq + 1;
+
+    if (packet.type == PIR_TRACE_START && length >= 14) {
+        if (writer.capturing) {
+            writer.flushRun();
+            fprintf(writer.out, "end incomplete\n");
+        }
+        fprintf(writer.out, "capture rate=%u pin=%u active=%u boot=%08x uptime=%u\n", pirTraceGetU32(p), p[4], p[5],
+                pirTraceGetU32(p + 6), pirTraceGetU32(p + 10));
+        writer.capturing = true;
+        writer.nextSample = 0;
+        writer.stats.captures++;
+        return true;
+    }
+    if (!writer.capturing) {
+        return true; // Joined in the middle of a capture; wait for the next START
+    }
+
+    size_t pos = 0;
+    uint32_t value = 0, dropped = 0;
+    if (packet.type == PIR_TRACE_RUNS) {
+        if (!pirTraceReadVarint(p, length, pos, value) || pos >= length) return true;
+        if (value != writer.nextSample) {
+            writer.gap(value - writer.nextSample);
+            writer.nextSample = value;
+        }
+        int level = p[pos++] ? 1 : 0;
+        while (pirTraceReadVarint(p, length, pos, value)) {
+            writer.run(level, value);
+            level ^= 1;
+        }
+        return true;
+    }
+    if (packet.type == PIR_TRACE_STOP) {
+        pirTraceReadVarint(p, length, pos, value);
+        pirTraceReadVarint(p, length, pos, dropped);
+        writer.flushRun();
+        fprintf(writer.out, "end samples=%u dropped=%u\n", value, dropped);
+        fflush(writer.out);
+        writer.capturing = false;
+        return false;
+    }
+    return true;
+}
+
+static void configureSerial(int fd, int baud) {
+    static const struct { int baud; speed_t speed; } speeds[] = {
+        {9600, B9600}, {57600, B57600}, {115200, B115200}, {230400, B230400}, {460800, B460800}, {921600, B921600}};
+    termios tty;
+    if (tcgetattr(fd, &tty) != 0) {
+        return; // Not a terminal (a file or pipe)
+    }
+    cfmakeraw(&tty);
+    for (const auto& s : speeds) {
+        if (s.baud == baud) {
+            cfsetispeed(&tty, s.speed);
+            cfsetospeed(&tty, s.speed);
+        }
+    }
+    tty.c_cc[VMIN] = 1;
+    tty.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSANOW, &tty);
+}
+
+static int record(const char* inputPath, const char* outputPath, int baud, bool echo, bool keep) {
+    int fd = strcmp(inputPath, "-") ? open(inputPath, O_RDONLY | O_NOCTTY) : STDIN_FILENO;
+    if (fd < 0) {
+        perror(inputPath);
+        return 1;
+    }
+    configureSerial(fd, baud);
+
+    TraceWriter writer;
+    writer.out = strcmp(outputPath, "-") ? fopen(outputPath, "w") : stdout;
+    if (!writer.out) {
+        perror(outputPath);
+        return 1;
+    }
+
+    struct sigaction action = {};
+    action.sa_handler = onSignal;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+
+    // Bytes between two zero delimiters: a frame, or log text
+    std::vector<uint8_t> chunk;
+    uint8_t decoded[PIR_TRACE_MAX_FRAME];
+    uint8_t buffer[4096];
+    bool running = true;
+    while (running && !interrupted) {
+        ssize_t count = read(fd, buffer, sizeof(buffer));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+
+        for (ssize_t i = 0; i < count && running; i++) {
+            if (buffer[i] != 0) {
+                chunk.push_back(buffer[i]);
+                if (chunk.size() < 4096) continue;
+            }
+            if (chunk.empty()) continue;
+
+            PirTracePacket packet;
+            size_t length = chunk.size() <= PIR_TRACE_MAX_FRAME ? pirTraceCobsDecode(chunk.data(), chunk.size(), decoded) : 0;
+            if (length > 0 && pirTraceParsePacket(decoded, length, packet)) {
+                writer.stats.frames++;
+                running = handlePacket(writer, packet) || keep;
+            } else if (isBinary(chunk)) {
+                writer.stats.badFrames++; // A frame with a bad CRC, or cut short
+            } else if (echo) {
+                fwrite(chunk.data(), 1, chunk.size(), stderr);
+            }
+            chunk.clear();
+        }
+    }
+
+    if (writer.capturing) {
+        writer.flushRun();
+        fprintf(writer.out, "end incomplete\n");
+    }
+    if (writer.out != stdout) fclose(writer.out);
+    if (fd != STDIN_FILENO) close(fd);
+
+    const RecorderStats& s = writer.stats;
+    fprintf(stderr, "%lu captures, %lu frames (%lu damaged, %lu lost), %lu runs, %lu gaps\n", s.captures, s.frames,
+            s.badFrames, s.lostPackets, s.runs, s.gaps);
+    return s.captures > 0 ? 0 : 1;
+}
+
+static void printDistribution(const char* name, std::vector<double>& values) {
+    if (values.empty()) {
+        printf("%-10s none\n", name);
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    auto at = [&](double q) { return values[(size_t)(q * (values.size() - 1))]; };
+    printf("%-10s n=%-6zu min %.1f  p10 %.1f  median %.1f  p90 %.1f  max %.1f ms\n", name, values.size(), values.front(),
+           at(0.1), at(0.5), at(0.9), values.back());
+}
+
+// Pulse widths and the gaps between pulses, in ms, for tuning the filters
+static int summarize(const char* path) {
+    FILE* in = fopen(path, "r");
+    if (!in) {
+        perror(path);
+        return 1;
+    }
+
+    std::vector<double> widths, intervals;
+    double rate = 0, position = 0, lastPulseEnd = -1;
+    int active = 1, level = 0;
+    unsigned long samples = 0, gaps = 0;
+    char line[256];
+    while (fgets(line, sizeof(line), in)) {
+        unsigned int a = 0, b = 0;
+        if (!strncmp(line, "capture ", 8)) {
+            const char* r = strstr(line, "rate=");
+            const char* act = strstr(line, "active=");
+            rate = r ? atof(r + 5) : 0;
+            active = act ? atoi(act + 7) : 1;
+            position = 0;
+            lastPulseEnd = -1;
+        } else if (sscanf(line, "gap %u", &a) == 1) {
+            position += a;
+            lastPulseEnd = -1; // The interval across a gap is unknown
+            gaps++;
+        } else if (sscanf(line, "%d %u", &level, &b) == 2 && rate > 0) {
+            double ms = b * 1000.0 / rate;
+            if (level == active) {
+                widths.push_back(ms);
+                if (lastPulseEnd >= 0) intervals.push_back((position - lastPulseEnd) * 1000.0 / rate);
+                lastPulseEnd = position + b;
+            }
+            position += b;
+            samples += b;
+        }
+    }
+    fclose(in);
+
+    printf("%s: %.1f s at %.0f Hz, %zu pulses, %lu gaps\n", path, rate > 0 ? samples / rate : 0.0, rate, widths.size(), gaps);
+    printDistribution("width", widths);
+    printDistribution("quiet", intervals);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    const char* input = nullptr;
+    const char* output = "trace.txt";
+    int baud = 115200;
+    bool echo = false, keep = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--summary" && i + 1 < argc) return summarize(argv[i + 1]);
+        else if (arg == "-o" && i + 1 < argc) output = argv[++i];
+        else if (arg == "--baud" && i + 1 < argc) baud = atoi(argv[++i]);
+        else if (arg == "--echo") echo = true;
+        else if (arg == "--keep") keep = true;
+        else if (!input && (arg[0] != '-' || arg == "-")) input = argv[i];
+        else {
+            input = nullptr;
+            break;
+        }
+    }
+    if (!input) {
+        fprintf(stderr, "usage: %s <serial device|log|-> [-o trace] [--baud n] [--echo] [--keep]\n"
+                        "       %s --summary <trace>\n", argv[0], argv[0]);
+        return 1;
+    }
+    return record(input, output, baud, echo, keep);
+}
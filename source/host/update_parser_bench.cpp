@@ -0,0 +1,244 @@
+// ===================================================================
+// UPDATE PARSER BENCHMARK
+// ===================================================================
+//
+// Feeds a recorded getUpdates response (host/data/get_updates_batch.json,
+// 16 updates: commands, group and channel posts, stickers, photos, edits,
+// \u escapes) through include/telegram_update_parser.h the way the firmware
+// does: socket-sized chunks into TELEGRAM_UPDATE_BATCH_SIZE command slots.
+// Larger batches are made by repeating the recorded updates with fresh
+// update_ids. For comparison it also runs the old approach of buffering the
+// whole body before parsing it, and reports the peak heap of both.
+//
+//   g++ -std=c++11 -O2 -Iinclude host/update_parser_bench.cpp -o update_parser_bench
+//   ./update_parser_bench host/data/get_updates_batch.json --updates 16,100,1000
+
+#include "telegram_update_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <new>
+#include <string>
+#include <vector>
+
+// Heap accounting: every allocation made while a benchmark runs
+static size_t heapLive = 0;
+static size_t heapPeak = 0;
+
+void* operator new(size_t size) {
+    size_t* block = (size_t*)malloc(size + sizeof(size_t));
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    heapLive += size;
+    heapPeak = std::max(heapPeak, heapLive);
+    return block + 1;
+}
+
+void operator delete(void* p) noexcept {
+    if (!p) return;
+    size_t* block = (size_t*)p - 1;
+    heapLive -= *block;
+    free(block);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+static void resetHeapPeak() {
+    heapPeak = heapLive;
+}
+
+static double nowMicros() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+// The recorded response split into the envelope and the updates, with each
+// update's id cut out so copies can be renumbered
+struct RecordedBatch {
+    std::string head;                       // {"ok":true,"result":[
+    std::string tail;                       // ]}
+    std::vector<std::string> pieces;        // Text between update_id values
+    int updates = 0;
+};
+
+static bool loadBatch(const char* path, RecordedBatch& batch) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return false;
+    }
+    std::string text;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0) text.append(buffer, n);
+    fclose(in);
+    while (!text.empty() && (text.back() == '\n' || text.back() == '\r')) text.pop_back();
+
+    size_t open = text.find("\"result\":[");
+    size_t close = text.rfind(']');
+    if (open == std::string::npos || close == std::string::npos || close < open) {
+        fprintf(stderr, "%s: not a getUpdates response\n", path);
+        return false;
+    }
+    open += 10;
+    batch.head = text.substr(0, open);
+    batch.tail = text.substr(close);
+
+    const std::string key = "\"update_id\":";
+    std::string updates = text.substr(open, close - open);
+    size_t pos = 0, found;
+    while ((found = updates.find(key, pos)) != std::string::npos) {
+        found += key.size();
+        batch.pieces.push_back(updates.substr(pos, found - pos));
+        pos = updates.find_first_not_of("0123456789", found);
+        batch.updates++;
+    }
+    batch.pieces.push_back(updates.substr(pos));
+    return batch.updates > 0;
+}
+
+// A response with `count` updates, ids counting up from `firstId`
+static std::string buildResponse(const RecordedBatch& batch, int count, long long firstId) {
+    std::string body = batch.head;
+    for (int i = 0; i < count; i++) {
+        int k = i % batch.updates;
+        if (k == 0 && i > 0) body += batch.pieces.back() + ',';
+        body += batch.pieces[k];
+        body += std::to_string(firstId + i);
+    }
+    body += batch.pieces.back();
+    body += batch.tail;
+    return body;
+}
+
+struct RunResult {
+    double micros = 0;
+    size_t peakHeap = 0;
+    int updates = 0;
+    int commands = 0;
+    bool ok = false;
+};
+
+static RunResult parseStreaming(const std::string& body, size_t chunk, TelegramInboundCommand* slots, int capacity) {
+    RunResult result;
+    resetHeapPeak();
+    double start = nowMicros();
+    TelegramUpdateParser parser;
+    parser.begin(TelegramUpdateParser::LAYOUT_UPDATES_RESPONSE, slots, capacity);
+    for (size_t pos = 0; pos < body.size(); pos += chunk) {
+        if (!parser.feed(body.data() + pos, std::min(chunk, body.size() - pos))) break;
+    }
+    result.micros = nowMicros() - start;
+    result.peakHeap = heapPeak - heapLive;
+    result.updates = parser.updateCount();
+    result.commands = parser.commandCount();
+    result.ok = parser.ok();
+    return result;
+}
+
+// The old path: the body is collected into a growing string as it arrives,
+// then parsed in one go
+static RunResult parseBuffered(const std::string& body, size_t chunk, TelegramInboundCommand* slots, int capacity) {
+    RunResult result;
+    size_t before = heapLive;
+    resetHeapPeak();
+    double start = nowMicros();
+    {
+        std::string received;
+        for (size_t pos = 0; pos < body.size(); pos += chunk) {
+            received.append(body.data() + pos, std::min(chunk, body.size() - pos));
+        }
+        TelegramUpdateParser parser;
+        parser.begin(TelegramUpdateParser::LAYOUT_UPDATES_RESPONSE, slots, capacity);
+        parser.feed(received.data(), received.size());
+        result.updates = parser.updateCount();
+        result.commands = parser.commandCount();
+        result.ok = parser.ok();
+    }
+    result.micros = nowMicros() - start;
+    result.peakHeap = heapPeak - before;
+    return result;
+}
+
+template <typename Parse>
+static RunResult best(Parse parse, int iterations) {
+    RunResult fastest;
+    for (int i = 0; i < iterations; i++) {
+        RunResult run = parse();
+        if (i == 0 || run.micros < fastest.micros) fastest = run;
+    }
+    return fastest;
+}
+
+static std::vector<int> parseList(const char* text) {
+    std::vector<int> values;
+    for (const char* p = text; *p;) {
+        values.push_back(atoi(p));
+        const char* comma = strchr(p, ',');
+        if (!comma) break;
+        p = comma + 1;
+    }
+    return values;
+}
+
+int main(int argc, char** argv) {
+    const char* path = "host/data/get_updates_batch.json";
+    std::vector<int> sizes = {16, 100, 1000};
+    std::vector<int> chunks = {64, 256, 1460};
+    int capacity = 16;
+    int iterations = 20;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--updates" && i + 1 < argc) sizes = parseList(argv[++i]);
+        else if (arg == "--chunks" && i + 1 < argc) chunks = parseList(argv[++i]);
+        else if (arg == "--slots" && i + 1 < argc) capacity = atoi(argv[++i]);
+        else if (arg == "--iterations" && i + 1 < argc) iterations = atoi(argv[++i]);
+        else if (arg[0] != '-') path = argv[i];
+        else {
+            fprintf(stderr, "usage: %s [batch.json] [--updates 16,100] [--chunks 64,256] [--slots n] [--iterations n]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    RecordedBatch batch;
+    if (!loadBatch(path, batch) || capacity <= 0 || iterations <= 0) {
+        return 1;
+    }
+    std::vector<TelegramInboundCommand> slots(capacity);
+
+    printf("%s: %d recorded updates\n", path, batch.updates);
+    printf("Parser state %zu bytes + %d slots x %zu bytes (stack or static, no heap)\n\n", sizeof(TelegramUpdateParser),
+           capacity, sizeof(TelegramInboundCommand));
+    printf("%8s %9s %6s  %-9s %10s %8s %11s  %s\n", "updates", "bytes", "chunk", "mode", "parse us", "MB/s", "peak heap",
+           "updates/commands");
+
+    int failures = 0;
+    for (int size : sizes) {
+        std::string body = buildResponse(batch, size, 501234001LL);
+        for (size_t chunk : chunks) {
+            const char* modes[] = {"streaming", "buffered"};
+            for (int mode = 0; mode < 2; mode++) {
+                RunResult r = best(
+                    [&]() {
+                        return mode == 0 ? parseStreaming(body, chunk, slots.data(), capacity)
+                                         : parseBuffered(body, chunk, slots.data(), capacity);
+                    },
+                    iterations);
+                bool valid = r.ok && r.updates == size;
+                if (!valid) failures++;
+                printf("%8d %9zu %6zu  %-9s %10.1f %8.1f %11zu  %d/%d%s\n", size, body.size(), chunk, modes[mode], r.micros,
+                       body.size() / std::max(r.micros, 0.001), r.peakHeap, r.updates, r.commands,
+                       valid ? "" : "  PARSE FAILED");
+            }
+        }
+    }
+    return failures ? 1 : 0;
+}
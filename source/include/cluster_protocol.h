@@ -0,0 +1,568 @@
+#ifndef CLUSTER_PROTOCOL_H
+#define CLUSTER_PROTOCOL_H
+
+// ===================================================================
+// LAN CLUSTER COORDINATION
+// ===================================================================
+//
+// Detectors in one building share their motion events over UDP multicast
+// so that one person walking past several units raises a single alert.
+//
+// - Every node sends a heartbeat; a peer that stays silent for the peer
+//   timeout is dropped. The node with the lowest id among the live ones
+//   is the leader, so when the leader disappears the next one takes over.
+// - A node reports local motion to the group. The leader acknowledges
+//   it, collects the events from all nodes for the merge window and
+//   raises one alert naming every node involved. Motion arriving while
+//   that building session is still active is counted but not alerted.
+// - A follower whose report is not acknowledged within the ack timeout
+//   alerts on its own, so no motion is lost while the cluster fails over.
+//   It drops the leader only if nothing at all was heard from it since the
+//   report; a leader whose heartbeats still arrive just missed one ACK.
+// - Every packet carries a SipHash-2-4 MAC under a key derived from the
+//   shared cluster passphrase. Packets with a wrong MAC are ignored.
+// - Every packet also carries the sender's boot number, which must grow
+//   with each restart, and a sequence number that grows with each packet.
+//   A packet not newer than the last one accepted from that node is a
+//   replay and is dropped, so a recorded motion report cannot raise an
+//   alert again and a recorded heartbeat cannot bring back a dead leader.
+//   A node that just restarted has no history; it drops packets whose
+//   wall clock is off by more than the allowed skew instead.
+//
+// The caller owns the socket and the clock: packets go out through the
+// send callback, received packets are fed to receive() and tick() is
+// called from the main loop. Has no Arduino dependencies so the host
+// harness (host/cluster_node.cpp) runs the same code.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef CLUSTER_MAX_PEERS
+#define CLUSTER_MAX_PEERS 8
+#endif
+
+#define CLUSTER_NAME_LENGTH 16
+#define CLUSTER_MAC_SIZE 8
+#define CLUSTER_PACKET_SIZE (48 + CLUSTER_MAC_SIZE)
+#define CLUSTER_PROTOCOL_VERSION 3
+
+// Nodes whose last boot and sequence number are remembered; kept after a
+// peer times out so its old packets stay rejected
+#ifndef CLUSTER_MAX_SENDERS
+#define CLUSTER_MAX_SENDERS (2 * CLUSTER_MAX_PEERS)
+#endif
+
+enum ClusterPacketType : uint8_t {
+    CLUSTER_HEARTBEAT = 1,
+    CLUSTER_MOTION = 2,                         // Local motion report
+    CLUSTER_ACK = 3,                            // Leader took over a report (arg = reporter, ref = its seq)
+    CLUSTER_ALERT = 4                           // Leader raised an alert (arg = node count)
+};
+
+// Wire format: "MC", version, type, then seven little-endian uint32, the
+// zero-padded node name and the MAC of everything before it
+struct ClusterPacket {
+    uint8_t type;
+    uint32_t nodeId;
+    uint32_t boot;                              // Sender's boot number
+    uint32_t seq;                               // Sender's packet number within the boot
+    uint32_t ref;                               // seq of the report an ACK answers
+    uint32_t wallClock;                         // Unix time of the event or heartbeat, 0 if unknown
+    uint32_t uptime;                            // Sender's clock (ms)
+    uint32_t arg;
+    char name[CLUSTER_NAME_LENGTH];
+};
+
+inline void clusterPutU32(uint8_t* p, uint32_t value) {
+    p[0] = value & 0xFF;
+    p[1] = (value >> 8) & 0xFF;
+    p[2] = (value >> 16) & 0xFF;
+    p[3] = value >> 24;
+}
+
+inline uint32_t clusterGetU32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+struct ClusterKey {
+    uint64_t k0;
+    uint64_t k1;
+};
+
+inline uint64_t clusterRotl(uint64_t x, int bits) {
+    return (x << bits) | (x >> (64 - bits));
+}
+
+inline void clusterSipRound(uint64_t& v0, uint64_t& v1, uint64_t& v2, uint64_t& v3) {
+    v0 += v1; v1 = clusterRotl(v1, 13); v1 ^= v0; v0 = clusterRotl(v0, 32);
+    v2 += v3; v3 = clusterRotl(v3, 16); v3 ^= v2;
+    v0 += v3; v3 = clusterRotl(v3, 21); v3 ^= v0;
+    v2 += v1; v1 = clusterRotl(v1, 17); v1 ^= v2; v2 = clusterRotl(v2, 32);
+}
+
+// SipHash-2-4
+inline uint64_t clusterSipHash(const ClusterKey& key, const uint8_t* data, size_t length) {
+    uint64_t v0 = 0x736f6d6570736575ULL ^ key.k0;
+    uint64_t v1 = 0x646f72616e646f6dULL ^ key.k1;
+    uint64_t v2 = 0x6c7967656e657261ULL ^ key.k0;
+    uint64_t v3 = 0x7465646279746573ULL ^ key.k1;
+
+    size_t blocks = length - length % 8;
+    for (size_t i = 0; i < blocks; i += 8) {
+        uint64_t m = 0;
+        for (int j = 7; j >= 0; j--) m = (m << 8) | data[i + j];
+        v3 ^= m;
+        clusterSipRound(v0, v1, v2, v3);
+        clusterSipRound(v0, v1, v2, v3);
+        v0 ^= m;
+    }
+    uint64_t last = (uint64_t)length << 56;
+    for (size_t j = 0; j < length % 8; j++) last |= (uint64_t)data[blocks + j] << (8 * j);
+    v3 ^= last;
+    clusterSipRound(v0, v1, v2, v3);
+    clusterSipRound(v0, v1, v2, v3);
+    v0 ^= last;
+
+    v2 ^= 0xFF;
+    for (int i = 0; i < 4; i++) clusterSipRound(v0, v1, v2, v3);
+    return v0 ^ v1 ^ v2 ^ v3;
+}
+
+// Turns the shared passphrase into the MAC key
+inline ClusterKey clusterDeriveKey(const char* passphrase) {
+    static const ClusterKey salt0 = {0x6d6f74696f6e2d63ULL, 1};
+    static const ClusterKey salt1 = {0x6d6f74696f6e2d63ULL, 2};
+    size_t length = strlen(passphrase);
+    ClusterKey key;
+    key.k0 = clusterSipHash(salt0, (const uint8_t*)passphrase, length);
+    key.k1 = clusterSipHash(salt1, (const uint8_t*)passphrase, length);
+    return key;
+}
+
+// The MAC trails the data it covers. Also used by the UDP notifier and the
+// fleet relay (host/event_relay.cpp) to sign whole datagrams
+inline void clusterPutMac(const ClusterKey& key, const uint8_t* data, size_t length, uint8_t* mac) {
+    uint64_t value = clusterSipHash(key, data, length);
+    clusterPutU32(mac, (uint32_t)value);
+    clusterPutU32(mac + 4, (uint32_t)(value >> 32));
+}
+
+// `length` includes the trailing MAC
+inline bool clusterCheckMac(const ClusterKey& key, const uint8_t* data, size_t length) {
+    if (length < CLUSTER_MAC_SIZE) {
+        return false;
+    }
+    uint8_t mac[CLUSTER_MAC_SIZE];
+    clusterPutMac(key, data, length - CLUSTER_MAC_SIZE, mac);
+    uint8_t difference = 0;
+    for (int i = 0; i < CLUSTER_MAC_SIZE; i++) difference |= mac[i] ^ data[length - CLUSTER_MAC_SIZE + i];
+    return difference == 0;
+}
+
+inline size_t encodeClusterPacket(const ClusterPacket& packet, const ClusterKey& key, uint8_t* out) {
+    out[0] = 'M';
+    out[1] = 'C';
+    out[2] = CLUSTER_PROTOCOL_VERSION;
+    out[3] = packet.type;
+    clusterPutU32(out + 4, packet.nodeId);
+    clusterPutU32(out + 8, packet.boot);
+    clusterPutU32(out + 12, packet.seq);
+    clusterPutU32(out + 16, packet.ref);
+    clusterPutU32(out + 20, packet.wallClock);
+    clusterPutU32(out + 24, packet.uptime);
+    clusterPutU32(out + 28, packet.arg);
+    memset(out + 32, 0, CLUSTER_NAME_LENGTH);
+    strncpy((char*)out + 32, packet.name, CLUSTER_NAME_LENGTH);
+
+    clusterPutMac(key, out, CLUSTER_PACKET_SIZE - CLUSTER_MAC_SIZE, out + CLUSTER_PACKET_SIZE - CLUSTER_MAC_SIZE);
+    return CLUSTER_PACKET_SIZE;
+}
+
+// Checks the MAC before trusting any field
+inline bool decodeClusterPacket(const uint8_t* in, size_t length, const ClusterKey& key, ClusterPacket& packet) {
+    if (length < CLUSTER_PACKET_SIZE || in[0] != 'M' || in[1] != 'C' || in[2] != CLUSTER_PROTOCOL_VERSION ||
+        !clusterCheckMac(key, in, CLUSTER_PACKET_SIZE)) {
+        return false;
+    }
+    packet.type = in[3];
+    packet.nodeId = clusterGetU32(in + 4);
+    packet.boot = clusterGetU32(in + 8);
+    packet.seq = clusterGetU32(in + 12);
+    packet.ref = clusterGetU32(in + 16);
+    packet.wallClock = clusterGetU32(in + 20);
+    packet.uptime = clusterGetU32(in + 24);
+    packet.arg = clusterGetU32(in + 28);
+    memcpy(packet.name, in + 32, CLUSTER_NAME_LENGTH);
+    packet.name[CLUSTER_NAME_LENGTH - 1] = '\0';
+    return packet.nodeId != 0;
+}
+
+struct ClusterTiming {
+    uint32_t heartbeatInterval;
+    uint32_t peerTimeout;                       // Silence after which a peer is dropped
+    uint32_t mergeWindow;                       // Events merged into one alert
+    uint32_t ackTimeout;                        // Follower alerts itself after this
+    uint32_t sessionCooldown;                   // Quiet time ending a building session
+    uint32_t maxClockSkew;                      // Wall clock difference accepted (s), 0 = no check
+};
+
+// An alert to raise (or, with sessionEnd, a building session that ended)
+struct ClusterAlert {
+    bool failover;                              // Raised by a follower without a leader
+    bool sessionEnd;
+    uint8_t nodeCount;
+    uint32_t nodes[CLUSTER_MAX_PEERS + 1];
+    uint32_t wallClock;                         // Time of the first event, 0 if unknown
+    uint32_t events;                            // Reports covered
+    uint32_t duration;                          // Session length (ms), sessionEnd only
+};
+
+struct ClusterStats {
+    uint32_t reportsSent;
+    uint32_t reportsReceived;
+    uint32_t acksReceived;
+    uint32_t alertsRaised;
+    uint32_t eventsMerged;                      // Reports that did not cause an alert of their own
+    uint32_t failovers;
+    uint32_t leaderChanges;
+    uint32_t buildingSessions;
+    uint32_t rejected;                          // Malformed or failed the MAC check
+    uint32_t replayed;                          // Not newer than the sender's last packet, or stale
+    uint32_t notesDropped;                      // Session ends the host had no room for (see noteDropped())
+};
+
+class ClusterCoordinator {
+public:
+    typedef void (*SendCallback)(const uint8_t* data, size_t length, void* context);
+    typedef void (*AlertCallback)(const ClusterAlert& alert, void* context);
+
+    // boot must be larger than on any earlier run of this node
+    void begin(uint32_t nodeId, const char* name, const ClusterTiming& timing, const ClusterKey& key,
+               uint32_t boot) {
+        nodeId_ = nodeId;
+        boot_ = boot;
+        key_ = key;
+        strncpy(name_, name, CLUSTER_NAME_LENGTH - 1);
+        name_[CLUSTER_NAME_LENGTH - 1] = '\0';
+        timing_ = timing;
+        leaderId_ = nodeId;
+    }
+
+    void setCallbacks(SendCallback send, AlertCallback alert, void* context) {
+        send_ = send;
+        alert_ = alert;
+        context_ = context;
+    }
+
+    // Reports motion seen by this node
+    void localMotion(uint32_t now, uint32_t wallClock) {
+        uint32_t seq = sendPacket(CLUSTER_MOTION, wallClock, now, 0, 0);
+        stats_.reportsSent++;
+        if (isLeader()) {
+            accountMotion(nodeId_, wallClock, now);
+        } else {
+            pending_ = true;
+            pendingSeq_ = seq;
+            pendingSince_ = now;
+            pendingWallClock_ = wallClock;
+        }
+    }
+
+    // wallClock is the local Unix time, 0 if not known yet
+    void receive(const uint8_t* data, size_t length, uint32_t now, uint32_t wallClock = 0) {
+        ClusterPacket packet;
+        if (!decodeClusterPacket(data, length, key_, packet)) {
+            stats_.rejected++;
+            return;
+        }
+        if (packet.nodeId == nodeId_) {
+            return;                             // Our own multicast looped back
+        }
+        if (!isFresh(packet, now, wallClock)) {
+            stats_.replayed++;
+            return;
+        }
+        touchPeer(packet.nodeId, packet.name, now);
+        electLeader();
+
+        switch (packet.type) {
+            case CLUSTER_MOTION:
+                stats_.reportsReceived++;
+                if (isLeader()) {
+                    accountMotion(packet.nodeId, packet.wallClock, now);
+                    sendPacket(CLUSTER_ACK, packet.wallClock, now, packet.nodeId, packet.seq);
+                }
+                break;
+            case CLUSTER_ACK:
+                if (pending_ && packet.arg == nodeId_ && packet.ref == pendingSeq_) {
+                    pending_ = false;
+                    stats_.acksReceived++;
+                }
+                break;
+        }
+    }
+
+    // Heartbeats, peer expiry, failover and alert timing
+    void tick(uint32_t now, uint32_t wallClock = 0) {
+        if (!heartbeatSent_ || now - lastHeartbeat_ >= timing_.heartbeatInterval) {
+            sendPacket(CLUSTER_HEARTBEAT, wallClock, now, 0, 0);
+            lastHeartbeat_ = now;
+            heartbeatSent_ = true;
+        }
+
+        for (int i = 0; i < peerCount_; ) {
+            if (now - peers_[i].lastSeen > timing_.peerTimeout) {
+                removePeer(i);
+            } else {
+                i++;
+            }
+        }
+        electLeader();
+
+        if (pending_ && now - pendingSince_ >= timing_.ackTimeout) {
+            // The leader did not answer: alert ourselves. Let the next node
+            // lead only if the leader has been silent since the report; one
+            // lost ACK from a live leader must not start a failover.
+            pending_ = false;
+            stats_.failovers++;
+            for (int i = 0; i < peerCount_; i++) {
+                if (peers_[i].id == leaderId_) {
+                    if ((int32_t)(peers_[i].lastSeen - pendingSince_) < 0) {
+                        removePeer(i);
+                    }
+                    break;
+                }
+            }
+            electLeader();
+
+            ClusterAlert alert = {};
+            alert.failover = true;
+            alert.nodeCount = 1;
+            alert.nodes[0] = nodeId_;
+            alert.wallClock = pendingWallClock_;
+            alert.events = 1;
+            raiseAlert(alert);
+        }
+
+        if (windowOpen_ && now - windowStart_ >= timing_.mergeWindow) {
+            flushWindow(now);
+        }
+        if (sessionActive_ && !windowOpen_ && now - lastMotion_ >= timing_.sessionCooldown) {
+            endSession();
+        }
+    }
+
+    bool isLeader() const { return leaderId_ == nodeId_; }
+    uint32_t nodeId() const { return nodeId_; }
+    uint32_t leaderId() const { return leaderId_; }
+    int peerCount() const { return peerCount_; }
+    bool sessionActive() const { return sessionActive_; }
+    const ClusterStats& stats() const { return stats_; }
+
+    // Called by the host when it could not keep a session-end notice
+    void noteDropped() { stats_.notesDropped++; }
+
+    // Name announced by a node, or nullptr if it is not a live peer
+    const char* nodeName(uint32_t id) const {
+        if (id == nodeId_) return name_;
+        for (int i = 0; i < peerCount_; i++) {
+            if (peers_[i].id == id) return peers_[i].name;
+        }
+        return nullptr;
+    }
+
+private:
+    struct Peer {
+        uint32_t id;
+        uint32_t lastSeen;
+        char name[CLUSTER_NAME_LENGTH];
+    };
+
+    struct Sender {
+        uint32_t id;
+        uint32_t boot;
+        uint32_t seq;
+        uint32_t lastSeen;
+    };
+
+    // Every packet takes the next own sequence number; ref is the report an ACK answers
+    uint32_t sendPacket(uint8_t type, uint32_t wallClock, uint32_t now, uint32_t arg, uint32_t ref) {
+        ClusterPacket packet;
+        packet.type = type;
+        packet.nodeId = nodeId_;
+        packet.boot = boot_;
+        packet.seq = ++seq_;
+        packet.ref = ref;
+        packet.wallClock = wallClock;
+        packet.uptime = now;
+        packet.arg = arg;
+        memcpy(packet.name, name_, CLUSTER_NAME_LENGTH);
+
+        uint8_t buffer[CLUSTER_PACKET_SIZE];
+        size_t length = encodeClusterPacket(packet, key_, buffer);
+        if (send_) send_(buffer, length, context_);
+        return packet.seq;
+    }
+
+    // Accepts a packet only if it is newer than the last one from its sender
+    bool isFresh(const ClusterPacket& packet, uint32_t now, uint32_t wallClock) {
+        if (timing_.maxClockSkew && wallClock && packet.wallClock) {
+            uint32_t skew = packet.wallClock > wallClock ? packet.wallClock - wallClock : wallClock - packet.wallClock;
+            if (skew > timing_.maxClockSkew) {
+                return false;
+            }
+        }
+
+        int slot = -1;
+        for (int i = 0; i < senderCount_; i++) {
+            if (senders_[i].id == packet.nodeId) {
+                slot = i;
+                break;
+            }
+        }
+        if (slot >= 0) {
+            const Sender& last = senders_[slot];
+            if (packet.boot < last.boot || (packet.boot == last.boot && packet.seq <= last.seq)) {
+                return false;
+            }
+        } else if (senderCount_ < CLUSTER_MAX_SENDERS) {
+            slot = senderCount_++;
+        } else {
+            // Forget the node heard from least recently
+            slot = 0;
+            for (int i = 1; i < senderCount_; i++) {
+                if (now - senders_[i].lastSeen > now - senders_[slot].lastSeen) slot = i;
+            }
+        }
+        senders_[slot].id = packet.nodeId;
+        senders_[slot].boot = packet.boot;
+        senders_[slot].seq = packet.seq;
+        senders_[slot].lastSeen = now;
+        return true;
+    }
+
+    void touchPeer(uint32_t id, const char* name, uint32_t now) {
+        for (int i = 0; i < peerCount_; i++) {
+            if (peers_[i].id == id) {
+                peers_[i].lastSeen = now;
+                return;
+            }
+        }
+        if (peerCount_ >= CLUSTER_MAX_PEERS) {
+            return;
+        }
+        Peer& peer = peers_[peerCount_++];
+        peer.id = id;
+        peer.lastSeen = now;
+        memcpy(peer.name, name, CLUSTER_NAME_LENGTH);
+    }
+
+    void removePeer(int index) {
+        peers_[index] = peers_[--peerCount_];
+    }
+
+    void electLeader() {
+        uint32_t leader = nodeId_;
+        for (int i = 0; i < peerCount_; i++) {
+            if (peers_[i].id < leader) leader = peers_[i].id;
+        }
+        if (leader == leaderId_) {
+            return;
+        }
+
+        // A leader stepping down hands over whatever it has not alerted yet
+        if (isLeader() && windowOpen_) {
+            flushWindow(lastMotion_);
+        }
+        sessionActive_ = false;
+        leaderId_ = leader;
+        stats_.leaderChanges++;
+    }
+
+    void accountMotion(uint32_t id, uint32_t wallClock, uint32_t now) {
+        lastMotion_ = now;
+        if (!sessionActive_) {
+            sessionActive_ = true;
+            sessionStart_ = now;
+            sessionEvents_ = 0;
+            windowOpen_ = true;
+            windowStart_ = now;
+            window_ = ClusterAlert();
+            window_.wallClock = wallClock;
+        }
+        sessionEvents_++;
+
+        if (!windowOpen_) {
+            stats_.eventsMerged++;              // Already covered by this session's alert
+            return;
+        }
+        window_.events++;
+        for (int i = 0; i < window_.nodeCount; i++) {
+            if (window_.nodes[i] == id) return;
+        }
+        if (window_.nodeCount < CLUSTER_MAX_PEERS + 1) {
+            window_.nodes[window_.nodeCount++] = id;
+        }
+    }
+
+    void flushWindow(uint32_t now) {
+        windowOpen_ = false;
+        stats_.eventsMerged += window_.events - 1;
+        sendPacket(CLUSTER_ALERT, window_.wallClock, now, window_.nodeCount, 0);
+        raiseAlert(window_);
+    }
+
+    void endSession() {
+        sessionActive_ = false;
+        stats_.buildingSessions++;
+
+        ClusterAlert alert = {};
+        alert.sessionEnd = true;
+        alert.events = sessionEvents_;
+        alert.duration = lastMotion_ - sessionStart_;
+        if (alert_) alert_(alert, context_);
+    }
+
+    void raiseAlert(const ClusterAlert& alert) {
+        stats_.alertsRaised++;
+        if (alert_) alert_(alert, context_);
+    }
+
+    uint32_t nodeId_ = 0;
+    uint32_t boot_ = 0;
+    char name_[CLUSTER_NAME_LENGTH] = {};
+    ClusterKey key_ = {};
+    ClusterTiming timing_ = {};
+    SendCallback send_ = nullptr;
+    AlertCallback alert_ = nullptr;
+    void* context_ = nullptr;
+
+    Peer peers_[CLUSTER_MAX_PEERS];
+    int peerCount_ = 0;
+    Sender senders_[CLUSTER_MAX_SENDERS];
+    int senderCount_ = 0;
+    uint32_t leaderId_ = 0;
+    uint32_t seq_ = 0;
+    uint32_t lastHeartbeat_ = 0;
+    bool heartbeatSent_ = false;
+
+    // Follower: report waiting for the leader's acknowledgement
+    bool pending_ = false;
+    uint32_t pendingSeq_ = 0;
+    uint32_t pendingSince_ = 0;
+    uint32_t pendingWallClock_ = 0;
+
+    // Leader: merge window and building session
+    bool windowOpen_ = false;
+    uint32_t windowStart_ = 0;
+    ClusterAlert window_ = {};
+    bool sessionActive_ = false;
+    uint32_t sessionStart_ = 0;
+    uint32_t lastMotion_ = 0;
+    uint32_t sessionEvents_ = 0;
+
+    ClusterStats stats_ = {};
+};
+
+#endif // CLUSTER_PROTOCOL_H
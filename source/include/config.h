@@ -43,6 +43,60 @@
 #define BOT_MAX_MESSAGE_LENGTH 4096     // Telegram message limit
 #define BOT_RETRY_ATTEMPTS 3            // Retry failed messages
 #define BOT_RETRY_DELAY 2000            // Delay between retries (ms)
+#define TELEGRAM_API_HOST "api.telegram.org" // Bot API server
+
+// DNS Cache (Bot API host resolved with its TTL at boot/reconnect, refreshed before expiry)
+#define DNS_CACHE_ENABLED true          // Connect to the cached address instead of resolving each time
+#define DNS_QUERY_TIMEOUT 2000          // Resolver answer timeout (ms)
+#define DNS_MIN_TTL 30                  // Shortest TTL honoured (seconds)
+#define DNS_MAX_TTL 3600                // Longest TTL honoured (seconds)
+#define DNS_REFRESH_PERCENT 80          // Refresh once this much of the TTL has passed
+#define DNS_RETRY_INTERVAL 30000        // Retry delay after a failed refresh (ms)
+
+// Long Polling (getUpdates runs on a background task instead of every BOT_MTBS)
+#define TELEGRAM_LONG_POLL_ENABLED (!TELEGRAM_WEBHOOK_ENABLED) // Use server-side long polling for bot commands
+#define TELEGRAM_LONG_POLL_TIMEOUT 25   // Server-side getUpdates timeout (seconds)
+#define TELEGRAM_POLL_TASK_STACK 8192   // Poll task stack size (bytes)
+#define TELEGRAM_POLL_TASK_CORE 0       // Core for the poll task (WiFi stack runs on core 0)
+#define TELEGRAM_COMMAND_QUEUE_LENGTH 16 // Commands buffered between poll task and main loop
+#define TELEGRAM_COMMAND_MAX_LENGTH 128 // Longest command text kept (bytes)
+#define TELEGRAM_COMMAND_QUEUE_WAIT 5000 // Wait for queue room before leaving updates unacknowledged (ms)
+
+// Connection Pre-warm (open the TLS connection on the raw PIR edge, before the alert is decided)
+#define TELEGRAM_PREWARM_ENABLED true   // Connect speculatively from a PIR edge interrupt
+#define TELEGRAM_PREWARM_TIMEOUT 20000  // Close a pre-warmed connection nothing used (ms)
+#define TELEGRAM_PREWARM_TASK_STACK 8192 // Pre-warm task stack size (TLS handshake)
+
+// Webhook Receive Mode (Telegram pushes updates to the device; no polling)
+#define TELEGRAM_WEBHOOK_ENABLED ENABLE_WEB_SERVER // Run the on-device webhook endpoint
+#define WEBHOOK_PORT 8443               // Telegram accepts 443, 80, 88 or 8443
+#define WEBHOOK_PATH "/telegram"        // URI the updates are POSTed to
+#define WEBHOOK_PUBLIC_URL ""           // Public URL passed to setWebhook at boot ("" = configured externally)
+#define WEBHOOK_SECRET_TOKEN ""         // Expected X-Telegram-Bot-Api-Secret-Token ("" = random, needs WEBHOOK_PUBLIC_URL)
+#define WEBHOOK_MAX_BODY_SIZE 4096      // Largest accepted update (bytes)
+#define WEBHOOK_TASK_STACK 10240        // HTTPS server task stack (TLS needs extra room)
+
+// Update Batching
+#define TELEGRAM_UPDATE_BATCH_SIZE 16   // Updates requested per getUpdates call
+#define TELEGRAM_READ_WAIT_MAX 20       // Longest sleep between checks for response data (ms)
+#define TELEGRAM_REPLY_SLOTS 4          // Distinct chats whose replies are merged per batch
+#define OUTBOUND_QUEUE_SLOTS 6          // Messages queued per priority class
+#define TELEGRAM_SEND_TASK_STACK 8192   // Sender task stack size (TLS handshake)
+#define TELEGRAM_SEND_TASK_INTERVAL 200 // Sender wake-up for retries and live edits when nothing is queued (ms)
+
+// Multi-Chat Fan-out (alerts to several chats are pipelined on one connection)
+#define TELEGRAM_FANOUT_ENABLED true    // Pipeline alerts to all chats, retry each chat independently
+#define FANOUT_MAX_DELIVERIES 8         // Chat deliveries in flight or awaiting retry
+#define FANOUT_MESSAGE_SLOTS 2          // Alerts whose deliveries can be pending at once
+
+// Rate Limiting (Bot API: ~30 messages/s per bot, 1/s per chat, 20/min per group)
+#define RATE_GLOBAL_PER_MINUTE 60       // Sustained messages per minute, all chats
+#define RATE_GLOBAL_BURST 10            // Messages that may go out back-to-back
+#define RATE_CHAT_PER_MINUTE 20         // Sustained messages per minute to one chat
+#define RATE_CHAT_BURST 3               // Back-to-back messages to one chat
+#define RATE_CHAT_BUCKETS 8             // Chats tracked at once (least recently used is reused)
+#define RATE_MAX_BLOCKING_WAIT 3000     // Longest a direct send waits for the limiter (ms)
+#define RATE_MAX_DEFER 300000           // Alerts still throttled after this are dropped (ms)
 
 // Advanced Telegram Features
 #define ENABLE_BOT_COMMANDS (!PRODUCTION_MODE)      // Enable /status, /test, /help commands
@@ -58,6 +112,91 @@
 #define HEARTBEAT_MESSAGE_ENABLED false
 #define HEARTBEAT_INTERVAL 3600000      // Send heartbeat every hour (ms)
 
+// ===================================================================
+// MQTT CONFIGURATION
+// ===================================================================
+
+// LAN Broker (motion events, session boundaries and telemetry; runs alongside Telegram)
+#define MQTT_ENABLED false             // Publish events to an MQTT broker
+#define MQTT_BROKER_HOST ""            // Broker hostname or IP ("" = disabled)
+#define MQTT_BROKER_PORT 1883          // Broker port
+#define MQTT_USERNAME ""               // Broker username ("" = anonymous)
+#define MQTT_PASSWORD ""               // Broker password
+#define MQTT_BASE_TOPIC "esp32-motion" // Topics: <base>/status|motion|session|telemetry
+#define MQTT_KEEPALIVE 30              // Keep-alive interval (seconds)
+#define MQTT_CONNECT_TIMEOUT 3000      // CONNACK timeout (ms)
+#define MQTT_RECONNECT_INTERVAL 10000  // Delay between connection attempts (ms)
+#define MQTT_RETRY_INTERVAL 5000       // Re-send a QoS 1 message without PUBACK after (ms)
+#define MQTT_QUEUE_SLOTS 32            // Messages kept while the broker is unreachable
+#define MQTT_MAX_INFLIGHT 8            // Unacknowledged messages on the wire
+#define MQTT_PAYLOAD_MAX_LENGTH 160    // Longest JSON payload (bytes)
+#define MQTT_TELEMETRY_INTERVAL 60000  // Retained telemetry publish interval (ms)
+
+// ===================================================================
+// NOTIFIER CONFIGURATION
+// ===================================================================
+
+// Notification Sinks (every event goes to each enabled sink, each with its own queue)
+#define NOTIFY_WEBHOOK_ENABLED false   // POST events as JSON to an HTTP endpoint
+#define NOTIFY_WEBHOOK_URL ""          // e.g. "http://192.168.1.10:8123/api/webhook/motion"
+#define NOTIFY_UDP_ENABLED false       // Send events as JSON datagrams
+#define NOTIFY_UDP_HOST ""             // Datagram destination (IP or hostname)
+#define NOTIFY_UDP_PORT 5005           // Datagram destination port
+#define NOTIFY_UDP_REPEAT 1            // Copies of each datagram (receiver drops duplicates)
+#define NOTIFY_UDP_BINARY false        // Send motion_event.h blocks instead of JSON
+#define NOTIFY_UDP_KEY ""              // Passphrase the fleet relay checks (signs each datagram, "" = unsigned)
+#define NOTIFY_LOOPBACK_ENABLED false  // Benchmark sink that accepts every event
+#define NOTIFY_LOOPBACK_DELAY 0        // Simulated delivery time of the loopback sink (ms)
+#define NOTIFIER_QUEUE_LENGTH 8        // Events buffered per worker sink
+#define NOTIFIER_TEXT_MAX_LENGTH 256   // Longest text kept per queued event (bytes)
+#define NOTIFIER_TASK_STACK 6144       // Worker task stack size (bytes)
+#define NOTIFIER_MAX_ATTEMPTS 3        // Delivery attempts per event (webhook)
+#define NOTIFIER_RETRY_DELAY 1000      // First retry delay, doubled per attempt (ms)
+
+// ===================================================================
+// CLUSTER CONFIGURATION
+// ===================================================================
+
+// LAN Coordination (detectors in one building merge their alerts; the lowest node id leads)
+#define CLUSTER_ENABLED false          // Share motion with other detectors over UDP multicast
+#define CLUSTER_MULTICAST_GROUP "239.255.42.99" // Multicast group shared by the detectors
+#define CLUSTER_PORT 42099             // Multicast port
+#define CLUSTER_NODE_ID 0              // Node id (0 = derived from the MAC address)
+#define CLUSTER_MAX_PEERS 8            // Other detectors tracked
+#define CLUSTER_HEARTBEAT_INTERVAL 1000 // Heartbeat interval (ms)
+#define CLUSTER_PEER_TIMEOUT 3500      // Silence after which a detector is considered gone (ms)
+#define CLUSTER_MERGE_WINDOW 750       // Reports merged into one alert by the leader (ms)
+#define CLUSTER_ACK_TIMEOUT 1500       // Alert directly if the leader does not answer (ms)
+#define CLUSTER_SESSION_COOLDOWN 30000 // Quiet time ending a building-wide session (ms)
+#define CLUSTER_MAX_CLOCK_SKEW 30      // Packets whose time differs more are dropped as replays (s, 0 = off)
+#define CLUSTER_KEY ""                 // Passphrase authenticating cluster packets (required, same on every detector)
+#define CLUSTER_TASK_STACK 4096        // Cluster socket task stack size (bytes)
+#define CLUSTER_TASK_INTERVAL 10       // Cluster socket poll interval (ms)
+#define CLUSTER_ALERT_QUEUE_LENGTH 16  // Alerts and session ends waiting for the main loop
+
+// ===================================================================
+// EVENT JOURNAL CONFIGURATION
+// ===================================================================
+
+// Binary Event Journal (motion_event.h records, a few bytes each, kept in flash)
+#define EVENT_JOURNAL_ENABLED true     // Record boots and motion sessions
+#define EVENT_JOURNAL_BLOCKS 4         // Blocks in the ring (the oldest is overwritten)
+#define EVENT_JOURNAL_BLOCK_SIZE 256   // Bytes per block; a full block is saved to flash
+#define EVENT_ZONE 0                   // Zone id written into this detector's events
+
+// ===================================================================
+// TRACE CAPTURE CONFIGURATION
+// ===================================================================
+
+// Raw PIR Trace (pir_trace.h packets on the serial port, recorded by host/trace_recorder)
+#define TRACE_CAPTURE_ENABLED false    // Allow /trace to stream the sampled PIR pin
+#define TRACE_SAMPLE_RATE 5000         // Pin samples per second (hardware timer)
+#define TRACE_RING_RUNS 256            // Runs buffered between the timer and the serial task (power of 2)
+#define TRACE_FLUSH_INTERVAL 250       // Packet interval; also splits longer runs (ms)
+#define TRACE_DEFAULT_DURATION 60      // Capture length when /trace has no argument (s, 0 = until /trace off)
+#define TRACE_TIMER 0                  // Hardware timer used for sampling
+#define TRACE_TASK_STACK 3072          // Stack of the packet task (bytes)
+
 // ===================================================================
 // DEVICE CONFIGURATION
 // ===================================================================
@@ -109,6 +248,16 @@
 #define RANGE_LONG 2                    // Long range - delayed response
 #define DEFAULT_RANGE RANGE_MEDIUM
 
+// Auto-Calibration (/sensitivity auto learns the sensor's noise while the area is empty)
+#define AUTO_CALIBRATION_ENABLED true   // Allow learned debounce/cooldown in place of the tables above
+#define CALIBRATION_PERIOD 1800000      // Default baseline length (ms)
+#define CALIBRATION_MAX_PULSES 256      // Noise pulses kept for the fit (later ones are only counted)
+#define CALIBRATION_TARGET_FALSE_ALARMS 1.0f // Accepted false alarms per day
+#define CALIBRATION_MIN_COOLDOWN 5000   // Bounds of the learned cooldown (ms)
+#define CALIBRATION_MAX_COOLDOWN 60000
+#define CALIBRATION_MAX_DEBOUNCE 500    // Longest learned debounce (ms); alerts wait this long, keep it
+                                        // well below the sensor's hold time
+
 // Current sensor settings (can be changed at runtime)
 extern int current_sensitivity_level;
 extern int current_range_setting;
@@ -119,10 +268,28 @@ extern bool sensor_config_mode_active;
 #define MOTION_DEBOUNCE_DELAY 2000      // Ignore motion for 2s after detection
 #define MOTION_COOLDOWN_PERIOD 10000    // Wait 10s after motion stops before ending session
 #define NOTIFICATION_INTERVAL 10000     // Minimum 10 sec between notifications (ms)
-#define MAX_NOTIFICATIONS_PER_HOUR 60   // Limit to 60 notifications per hour
+#define MAX_NOTIFICATIONS_PER_HOUR 60   // Limit to 60 notifications per sliding hour
+#define NOTIFICATION_WINDOW_BUCKETS 60  // Buckets the hour is divided into
+#define NOTIFICATION_WINDOW_BUCKET_MS (3600000UL / NOTIFICATION_WINDOW_BUCKETS)
 #define ENABLE_MOTION_COUNTER true      // Count total motion events
 #define RESET_COUNTER_DAILY true        // Reset counters at midnight
 
+// Live Session Message
+#define LIVE_SESSION_ENABLED true       // Edit the session's alert as motion continues instead of staying silent
+#define LIVE_SESSION_EDIT_INTERVAL 15000 // Minimum time between edits of the live message (ms)
+#define LIVE_SESSION_MAX_CHATS 4        // Chats whose live message is kept up to date
+
+// Digest Mode (busy locations: summarize back-to-back sessions in one message)
+#define DIGEST_MODE_ENABLED false       // Batch sessions that follow closely on each other
+#define DIGEST_QUIET_PERIOD 1800000     // A session after this long without motion alerts immediately (ms)
+#define DIGEST_FLUSH_INTERVAL 900000    // Send the digest this long after its first session (ms)
+#define DIGEST_FLUSH_THRESHOLD 20       // ...or as soon as this many sessions are pending
+#define DIGEST_MIN_FLUSH_INTERVAL 60000 // Minimum time between digests (ms)
+
+// Motion History (per-minute, per-hour and per-day rollups shown by /history)
+#define HISTORY_ENABLED true            // Keep motion rollups for the last hour, week and year
+#define HISTORY_SAVE_INTERVAL 1800000   // Save them to flash this often while motion occurs (ms)
+
 // Motion Sensitivity & Timing
 #define MOTION_DETECTION_ENABLED true   // Master switch for motion detection
 #define QUIET_HOURS_ENABLED false       // Enable quiet hours (no notifications)
@@ -155,6 +322,12 @@ extern bool sensor_config_mode_active;
 #define LOOP_DELAY 100                  // Main loop delay (ms)
 #define STARTUP_DELAY 2000              // Delay after startup (ms)
 #define SENSOR_STABILIZATION_TIME 30000 // PIR sensor stabilization time (ms)
+#define WIFI_CONNECT_POLL_INTERVAL 50  // WiFi status poll interval while connecting (ms)
+
+// Fast Boot (warm resets skip the startup delay, LED test and PIR warm-up)
+#define FAST_BOOT_ENABLED true          // Reuse the PIR warm-up across software/watchdog resets
+#define BOOT_PROFILE_ENABLED true       // Print per-phase boot timing on Serial
+#define BOOT_PROFILE_MAX_PHASES 10      // Boot phases recorded
 
 // LED Patterns
 #define LED_BLINK_FAST 100             // Fast blink delay (ms)
@@ -205,7 +378,10 @@ extern bool sensor_config_mode_active;
 // ===================================================================
 
 // Network Security
-#define USE_SSL_VERIFICATION false     // SSL certificate verification (set true for production)
+#define USE_SSL_VERIFICATION true      // Verify api.telegram.org against the pinned root in data/certs/ca_cert.pem
+#define TLS_HANDSHAKE_TIMEOUT 10       // TLS handshake timeout (seconds)
+#define TLS_BENCHMARK_AT_BOOT false    // Compare handshake time and heap per TLS profile at boot
+#define TLS_BENCHMARK_ROUNDS 3         // Handshakes per profile in the benchmark
 #define ENABLE_ENCRYPTION false        // Enable message encryption (future feature)
 #define MAX_FAILED_ATTEMPTS 5          // Max failed connection attempts before lockout
 #define LOCKOUT_DURATION 300000        // Lockout duration (ms)
@@ -224,6 +400,13 @@ extern bool sensor_config_mode_active;
 #define CPU_FREQUENCY 240              // CPU frequency in MHz (80, 160, 240)
 #define ENABLE_LIGHT_SLEEP false       // Enable automatic light sleep
 
+// Frequency Scaling (full clock only for TLS handshakes and response parsing)
+#define CPU_SCALING_ENABLED true       // Scale between CPU_IDLE_FREQUENCY and CPU_FREQUENCY
+#define CPU_IDLE_FREQUENCY 80          // Idle sensing frequency in MHz (40 needs esp_pm DFS)
+#define CPU_ACTIVE_CURRENT_MA 50       // Estimated draw at CPU_FREQUENCY (energy report)
+#define CPU_IDLE_CURRENT_MA 22         // Estimated draw at CPU_IDLE_FREQUENCY (energy report)
+#define SUPPLY_VOLTAGE 3.3f            // Supply voltage for the energy estimate (V)
+
 // Battery Monitoring (if applicable)
 #define BATTERY_VOLTAGE_PIN -1         // Battery voltage monitoring pin (-1 to disable)
 #define LOW_BATTERY_THRESHOLD 3.3      // Low battery voltage threshold
@@ -240,7 +423,7 @@ extern bool sensor_config_mode_active;
 #define ENABLE_STATUS_LED true
 
 // Optional Features
-#define ENABLE_WEB_SERVER false        // Enable web configuration interface
+#define ENABLE_WEB_SERVER false        // Enable on-device webhook endpoint for bot updates
 #define ENABLE_OTA_UPDATES false       // Enable over-the-air updates
 #define ENABLE_NTP_TIME_SYNC true      // Sync time with NTP server
 #define ENABLE_TIMEZONE_SUPPORT true   // Support for timezone conversion
@@ -287,6 +470,10 @@ extern bool sensor_config_mode_active;
     #error "BOT_MTBS must be at least 500ms to avoid rate limiting"
 #endif
 
+#if TELEGRAM_LONG_POLL_TIMEOUT < 1 || TELEGRAM_LONG_POLL_TIMEOUT > 50
+    #error "TELEGRAM_LONG_POLL_TIMEOUT must be between 1 and 50 seconds"
+#endif
+
 #if WIFI_TIMEOUT < 5000
     #error "WIFI_TIMEOUT should be at least 5000ms"
 #endif
@@ -0,0 +1,275 @@
+#ifndef MOTION_EVENT_H
+#define MOTION_EVENT_H
+
+// ===================================================================
+// BINARY MOTION EVENT FORMAT
+// ===================================================================
+//
+// Compact encoding of motion events shared by the firmware (event journal,
+// UDP sink) and the host tools. A block is a header followed by records;
+// a record is typically 2-4 bytes.
+//
+// Header:  'M' 'E' <version> <header flags>
+//          varint deviceId, varint boot, varint firstSeq, varint baseUptime (ms)
+//          [varint wallClock (Unix s)]          if MOTION_HEADER_WALL_CLOCK
+//          [u8 length, name bytes]              if MOTION_HEADER_NAME
+// Record:  <u8 type | field bits>, varint delta (ms since the previous
+//          record, or since baseUptime for the first)
+//          [u8 zone] [varint duration (ms)] [u8 flags] [varint length, text]
+//
+// Varints are LEB128 (7 bits per byte, least significant first). Readers
+// reject a newer version; unknown record types are returned as they are.
+//
+// Has no Arduino dependencies so it can be compiled on the host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define MOTION_EVENT_VERSION 1
+#define MOTION_EVENT_NAME_LENGTH 24
+
+enum MotionEventType : uint8_t {
+    MOTION_EVENT_BOOT = 1,                      // duration = boot time
+    MOTION_EVENT_SESSION_START = 2,
+    MOTION_EVENT_TRIGGER = 3,                   // Further trigger within a session
+    MOTION_EVENT_SESSION_END = 4,               // duration = session length
+    MOTION_EVENT_STATUS = 5,
+    MOTION_EVENT_ERROR = 6
+};
+
+// Record flags
+#define MOTION_FLAG_NOTIFIED 0x01               // An alert was sent for it
+#define MOTION_FLAG_DIGESTED 0x02               // Reported in a digest instead
+#define MOTION_FLAG_QUIET_HOURS 0x04
+#define MOTION_FLAG_CLUSTER 0x08                // Alert merged by the cluster leader
+
+// Header flags
+#define MOTION_HEADER_WALL_CLOCK 0x01
+#define MOTION_HEADER_NAME 0x02
+
+// Record field bits (high nibble of the first byte)
+#define MOTION_RECORD_ZONE 0x10
+#define MOTION_RECORD_DURATION 0x20
+#define MOTION_RECORD_FLAGS 0x40
+#define MOTION_RECORD_TEXT 0x80
+
+struct MotionEventHeader {
+    uint32_t deviceId;
+    uint32_t boot;                              // Random per boot; tells restarts from replays
+    uint32_t firstSeq;                          // Sequence number of the first record
+    uint32_t baseUptime;
+    uint32_t wallClock;                         // 0 if unknown
+    char name[MOTION_EVENT_NAME_LENGTH];        // "" if absent
+};
+
+struct MotionEventRecord {
+    uint8_t type;
+    uint8_t zone;
+    uint8_t flags;
+    uint32_t uptime;                            // Absolute (ms), rebuilt from the deltas
+    uint32_t duration;
+    const char* text;                           // Not terminated; points into the block
+    uint16_t textLength;
+};
+
+inline size_t motionEventPutVarint(uint8_t* out, uint32_t value) {
+    size_t length = 0;
+    while (value >= 0x80) {
+        out[length++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[length++] = (uint8_t)value;
+    return length;
+}
+
+inline size_t motionEventVarintSize(uint32_t value) {
+    size_t length = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        length++;
+    }
+    return length;
+}
+
+class MotionEventWriter {
+public:
+    MotionEventWriter() {}
+    MotionEventWriter(uint8_t* buffer, size_t capacity) : buffer_(buffer), capacity_(capacity) {}
+
+    void attach(uint8_t* buffer, size_t capacity) {
+        buffer_ = buffer;
+        capacity_ = capacity;
+        length_ = 0;
+        count_ = 0;
+    }
+
+    // Starts a new block; false if the header does not fit
+    bool begin(const MotionEventHeader& header) {
+        length_ = 0;
+        count_ = 0;
+        size_t nameLength = strnlen(header.name, MOTION_EVENT_NAME_LENGTH);
+        uint8_t flags = (header.wallClock ? MOTION_HEADER_WALL_CLOCK : 0) | (nameLength ? MOTION_HEADER_NAME : 0);
+        size_t needed = 4 + motionEventVarintSize(header.deviceId) + motionEventVarintSize(header.boot) +
+                        motionEventVarintSize(header.firstSeq) + motionEventVarintSize(header.baseUptime) +
+                        (header.wallClock ? motionEventVarintSize(header.wallClock) : 0) +
+                        (nameLength ? 1 + nameLength : 0);
+        if (buffer_ == nullptr || needed > capacity_) {
+            return false;
+        }
+
+        uint8_t* p = buffer_;
+        *p++ = 'M';
+        *p++ = 'E';
+        *p++ = MOTION_EVENT_VERSION;
+        *p++ = flags;
+        p += motionEventPutVarint(p, header.deviceId);
+        p += motionEventPutVarint(p, header.boot);
+        p += motionEventPutVarint(p, header.firstSeq);
+        p += motionEventPutVarint(p, header.baseUptime);
+        if (header.wallClock) p += motionEventPutVarint(p, header.wallClock);
+        if (nameLength) {
+            *p++ = (uint8_t)nameLength;
+            memcpy(p, header.name, nameLength);
+            p += nameLength;
+        }
+        length_ = p - buffer_;
+        lastUptime_ = header.baseUptime;
+        return true;
+    }
+
+    // Appends a record; false (and nothing written) if the block is full
+    bool append(const MotionEventRecord& record) {
+        uint32_t delta = record.uptime - lastUptime_;   // Modular, so a millis() wrap stays a small step
+        uint8_t first = (record.type & 0x0F) | (record.zone ? MOTION_RECORD_ZONE : 0) |
+                        (record.duration ? MOTION_RECORD_DURATION : 0) | (record.flags ? MOTION_RECORD_FLAGS : 0) |
+                        (record.textLength ? MOTION_RECORD_TEXT : 0);
+        size_t needed = 1 + motionEventVarintSize(delta) + (record.zone ? 1 : 0) +
+                        (record.duration ? motionEventVarintSize(record.duration) : 0) + (record.flags ? 1 : 0) +
+                        (record.textLength ? motionEventVarintSize(record.textLength) + record.textLength : 0);
+        if (length_ == 0 || length_ + needed > capacity_) {
+            return false;
+        }
+
+        uint8_t* p = buffer_ + length_;
+        *p++ = first;
+        p += motionEventPutVarint(p, delta);
+        if (record.zone) *p++ = record.zone;
+        if (record.duration) p += motionEventPutVarint(p, record.duration);
+        if (record.flags) *p++ = record.flags;
+        if (record.textLength) {
+            p += motionEventPutVarint(p, record.textLength);
+            memcpy(p, record.text, record.textLength);
+            p += record.textLength;
+        }
+        length_ = p - buffer_;
+        lastUptime_ += delta;
+        count_++;
+        return true;
+    }
+
+    const uint8_t* data() const { return buffer_; }
+    size_t size() const { return length_; }
+    uint32_t count() const { return count_; }
+
+private:
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t length_ = 0;
+    uint32_t count_ = 0;
+    uint32_t lastUptime_ = 0;
+};
+
+class MotionEventReader {
+public:
+    MotionEventReader(const uint8_t* data, size_t length) : data_(data), length_(length) {}
+
+    bool readHeader(MotionEventHeader& header) {
+        pos_ = 0;
+        error_ = true;
+        if (length_ < 4 || data_[0] != 'M' || data_[1] != 'E' || data_[2] == 0 || data_[2] > MOTION_EVENT_VERSION) {
+            return false;
+        }
+        uint8_t flags = data_[3];
+        pos_ = 4;
+        header.wallClock = 0;
+        header.name[0] = '\0';
+        if (!readVarint(header.deviceId) || !readVarint(header.boot) || !readVarint(header.firstSeq) ||
+            !readVarint(header.baseUptime)) {
+            return false;
+        }
+        if ((flags & MOTION_HEADER_WALL_CLOCK) && !readVarint(header.wallClock)) {
+            return false;
+        }
+        if (flags & MOTION_HEADER_NAME) {
+            if (pos_ >= length_) return false;
+            size_t nameLength = data_[pos_++];
+            if (nameLength >= MOTION_EVENT_NAME_LENGTH || pos_ + nameLength > length_) return false;
+            memcpy(header.name, data_ + pos_, nameLength);
+            header.name[nameLength] = '\0';
+            pos_ += nameLength;
+        }
+        uptime_ = header.baseUptime;
+        error_ = false;
+        return true;
+    }
+
+    // Next record; false at the end of the block or on a malformed record
+    bool next(MotionEventRecord& record) {
+        if (error_ || pos_ >= length_) {
+            return false;
+        }
+        error_ = true;
+        uint8_t first = data_[pos_++];
+        uint32_t delta = 0;
+        if (!readVarint(delta)) return false;
+
+        record.type = first & 0x0F;
+        record.zone = 0;
+        record.duration = 0;
+        record.flags = 0;
+        record.text = nullptr;
+        record.textLength = 0;
+        if (first & MOTION_RECORD_ZONE) {
+            if (pos_ >= length_) return false;
+            record.zone = data_[pos_++];
+        }
+        if ((first & MOTION_RECORD_DURATION) && !readVarint(record.duration)) return false;
+        if (first & MOTION_RECORD_FLAGS) {
+            if (pos_ >= length_) return false;
+            record.flags = data_[pos_++];
+        }
+        if (first & MOTION_RECORD_TEXT) {
+            uint32_t textLength = 0;
+            if (!readVarint(textLength) || textLength > 0xFFFF || pos_ + textLength > length_) return false;
+            record.text = (const char*)data_ + pos_;
+            record.textLength = (uint16_t)textLength;
+            pos_ += textLength;
+        }
+        uptime_ += delta;
+        record.uptime = uptime_;
+        error_ = false;
+        return true;
+    }
+
+    bool error() const { return error_; }
+
+private:
+    bool readVarint(uint32_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 35 && pos_ < length_; shift += 7) {
+            uint8_t byte = data_[pos_++];
+            value |= (uint32_t)(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) return true;
+        }
+        return false;
+    }
+
+    const uint8_t* data_;
+    size_t length_;
+    size_t pos_ = 0;
+    uint32_t uptime_ = 0;
+    bool error_ = true;
+};
+
+#endif // MOTION_EVENT_H
@@ -0,0 +1,252 @@
+#ifndef MQTT_CLIENT_H
+#define MQTT_CLIENT_H
+
+// ===================================================================
+// MINIMAL MQTT 3.1.1 PUBLISHER
+// ===================================================================
+//
+// Publish-only MQTT client over any Arduino Client: CONNECT with a last
+// will, QoS 0/1 PUBLISH, PUBACK reporting and keep-alive pings. Which
+// messages still await a PUBACK is tracked by the caller, so they survive
+// a reconnect and can be re-sent with the same packet id.
+//
+// The packet buffer is sized by MQTT_MAX_PACKET_SIZE (set in platformio.ini).
+
+#include <Arduino.h>
+#include <Client.h>
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 1024
+#endif
+
+class MqttClient {
+public:
+    typedef void (*AckCallback)(uint16_t packetId);
+
+    explicit MqttClient(Client& transport) : transport_(transport) {}
+
+    void onAck(AckCallback callback) { ackCallback_ = callback; }
+
+    // Opens the connection and waits for CONNACK. A clean session is
+    // requested; the will (if any) is published with QoS 1.
+    bool connect(const char* host, uint16_t port, const char* clientId,
+                 const char* username, const char* password,
+                 const char* willTopic, const char* willMessage, bool willRetain,
+                 uint16_t keepAliveSeconds, unsigned long timeoutMs) {
+        connected_ = false;
+        if (!transport_.connect(host, port)) {
+            return false;
+        }
+
+        uint8_t flags = 0x02;                       // Clean session
+        size_t length = 10 + 2 + strlen(clientId);
+        if (willTopic && *willTopic) {
+            flags |= 0x04 | 0x08 | (willRetain ? 0x20 : 0);
+            length += 2 + strlen(willTopic) + 2 + strlen(willMessage);
+        }
+        if (username && *username) {
+            flags |= 0x80;
+            length += 2 + strlen(username);
+            if (password && *password) {
+                flags |= 0x40;
+                length += 2 + strlen(password);
+            }
+        }
+        if (length > MQTT_MAX_PACKET_SIZE - 5) {
+            transport_.stop();
+            return false;
+        }
+
+        uint8_t* p = buffer_ + writeFixedHeader(0x10, length);
+        p = writeString(p, "MQTT");
+        *p++ = 4;                                   // Protocol level 3.1.1
+        *p++ = flags;
+        *p++ = keepAliveSeconds >> 8;
+        *p++ = keepAliveSeconds & 0xFF;
+        p = writeString(p, clientId);
+        if (flags & 0x04) {
+            p = writeString(p, willTopic);
+            p = writeString(p, willMessage);
+        }
+        if (flags & 0x80) p = writeString(p, username);
+        if (flags & 0x40) p = writeString(p, password);
+        if (!send(p - buffer_)) {
+            transport_.stop();
+            return false;
+        }
+
+        // CONNACK: 0x20 0x02 <session present> <return code>
+        uint8_t ack[4];
+        for (int i = 0; i < 4; i++) {
+            int c = readByte(timeoutMs);
+            if (c < 0) {
+                transport_.stop();
+                return false;
+            }
+            ack[i] = (uint8_t)c;
+        }
+        if (ack[0] != 0x20 || ack[3] != 0) {
+            transport_.stop();
+            return false;
+        }
+
+        keepAlive_ = keepAliveSeconds;
+        pingOutstanding_ = false;
+        connected_ = true;
+        return true;
+    }
+
+    // packetId 0 publishes with QoS 0, anything else with QoS 1
+    bool publish(const char* topic, const uint8_t* payload, size_t length,
+                 bool retain, uint16_t packetId, bool duplicate) {
+        size_t remaining = 2 + strlen(topic) + (packetId ? 2 : 0) + length;
+        if (!connected_ || remaining > MQTT_MAX_PACKET_SIZE - 5) {
+            return false;
+        }
+
+        uint8_t type = 0x30 | (duplicate ? 0x08 : 0) | (packetId ? 0x02 : 0) | (retain ? 0x01 : 0);
+        uint8_t* p = buffer_ + writeFixedHeader(type, remaining);
+        p = writeString(p, topic);
+        if (packetId) {
+            *p++ = packetId >> 8;
+            *p++ = packetId & 0xFF;
+        }
+        memcpy(p, payload, length);
+        p += length;
+        return send(p - buffer_);
+    }
+
+    // Reads acknowledgements and keeps the connection alive. Returns false
+    // once the connection is gone.
+    bool loop() {
+        if (!connected_) {
+            return false;
+        }
+        if (!transport_.connected()) {
+            connected_ = false;
+            return false;
+        }
+
+        while (transport_.available() > 0) {
+            if (!readPacket()) {
+                dropConnection();
+                return false;
+            }
+        }
+
+        if (keepAlive_ > 0 && millis() - lastSent_ >= keepAlive_ * 1000UL) {
+            if (pingOutstanding_) {
+                dropConnection();                   // No PINGRESP for a whole keep-alive period
+                return false;
+            }
+            uint8_t ping[2] = {0xC0, 0x00};
+            memcpy(buffer_, ping, sizeof(ping));
+            if (!send(sizeof(ping))) {
+                return false;
+            }
+            pingOutstanding_ = true;
+        }
+        return true;
+    }
+
+    bool connected() const { return connected_; }
+
+    // Graceful DISCONNECT: the broker discards the last will
+    void disconnect() {
+        if (connected_) {
+            uint8_t packet[2] = {0xE0, 0x00};
+            transport_.write(packet, sizeof(packet));
+        }
+        dropConnection();
+    }
+
+private:
+    size_t writeFixedHeader(uint8_t type, size_t remaining) {
+        size_t pos = 0;
+        buffer_[pos++] = type;
+        do {
+            uint8_t digit = remaining % 128;
+            remaining /= 128;
+            buffer_[pos++] = digit | (remaining > 0 ? 0x80 : 0);
+        } while (remaining > 0);
+        return pos;
+    }
+
+    static uint8_t* writeString(uint8_t* p, const char* text) {
+        size_t length = strlen(text);
+        *p++ = length >> 8;
+        *p++ = length & 0xFF;
+        memcpy(p, text, length);
+        return p + length;
+    }
+
+    bool send(size_t length) {
+        if (transport_.write(buffer_, length) != length) {
+            dropConnection();
+            return false;
+        }
+        lastSent_ = millis();
+        return true;
+    }
+
+    int readByte(unsigned long timeoutMs) {
+        unsigned long start = millis();
+        while (transport_.available() <= 0) {
+            if (!transport_.connected() || millis() - start >= timeoutMs) {
+                return -1;
+            }
+            delay(1);
+        }
+        return transport_.read();
+    }
+
+    bool readPacket() {
+        int type = readByte(MQTT_READ_TIMEOUT);
+        if (type < 0) return false;
+
+        uint32_t remaining = 0;
+        for (int shift = 0; shift < 28; shift += 7) {
+            int digit = readByte(MQTT_READ_TIMEOUT);
+            if (digit < 0) return false;
+            remaining |= (uint32_t)(digit & 0x7F) << shift;
+            if ((digit & 0x80) == 0) break;
+        }
+
+        // Only PUBACK and PINGRESP are expected; anything else is skipped
+        uint8_t body[2] = {0, 0};
+        for (uint32_t i = 0; i < remaining; i++) {
+            int c = readByte(MQTT_READ_TIMEOUT);
+            if (c < 0) return false;
+            if (i < sizeof(body)) body[i] = (uint8_t)c;
+        }
+
+        switch (type & 0xF0) {
+            case 0x40:                              // PUBACK
+                if (remaining >= 2 && ackCallback_) {
+                    ackCallback_((uint16_t)((body[0] << 8) | body[1]));
+                }
+                break;
+            case 0xD0:                              // PINGRESP
+                pingOutstanding_ = false;
+                break;
+        }
+        return true;
+    }
+
+    void dropConnection() {
+        transport_.stop();
+        connected_ = false;
+    }
+
+    static const unsigned long MQTT_READ_TIMEOUT = 1000;
+
+    Client& transport_;
+    AckCallback ackCallback_ = nullptr;
+    uint8_t buffer_[MQTT_MAX_PACKET_SIZE];
+    uint16_t keepAlive_ = 0;
+    unsigned long lastSent_ = 0;
+    bool pingOutstanding_ = false;
+    bool connected_ = false;
+};
+
+#endif // MQTT_CLIENT_H
@@ -0,0 +1,196 @@
+#ifndef NOISE_CALIBRATION_H
+#define NOISE_CALIBRATION_H
+
+// ===================================================================
+// SENSOR NOISE MODEL
+// ===================================================================
+//
+// The model behind `/sensitivity auto`. A baseline recorded while the area
+// is empty is all noise. Pulse widths are fitted with a log-normal
+// distribution and the quiet gaps between pulses with a mixture of two
+// exponentials (short gaps inside a burst, long ones between bursts).
+//
+// - The cooldown is set to bridge the gaps inside a burst, so a burst stays
+//   one session. Noise then starts sessions at rate m = pulses per day x
+//   P(gap > cooldown), and after an alert the next one waits for the alert
+//   spacing plus the next session start: 1 / (spacing + 1/m) false alarms
+//   per day.
+// - If that is above the target the cooldown is raised, then the debounce:
+//   the pin has to stay active that long, so shorter pulses are ignored.
+//   Whatever is left over is reported, not muted.
+//
+// Has no Arduino dependencies so host/calibration_check.cpp can replay
+// noise against the same code and compare the predicted false alarms with
+// the ones counted.
+
+#include <math.h>
+#include <stdint.h>
+
+#define CALIBRATION_MIN_GAPS 8                  // Fewer gaps are fitted with a single exponential
+
+struct CalibrationFit {
+    unsigned long pulses;
+    float hours;
+    float widthMedian;                          // ms
+    float widthSpread;                          // Geometric standard deviation
+    float burstShare;                           // Share of the gaps that fall inside bursts
+    float burstGap;                             // Mean gap inside a burst (ms)
+    float quietGap;                             // Mean gap between bursts (ms)
+};
+
+struct CalibrationLimits {
+    float minCooldown;                          // ms
+    float maxCooldown;
+    float defaultCooldown;                      // Used when the gaps show no bursts
+    float maxDebounce;                          // ms
+    float debounceStep;                         // Resolution the pin is polled at (ms)
+    float spacing;                              // Shortest time between alerts (ms)
+    float target;                               // Accepted false alarms per day
+};
+
+struct CalibrationChoice {
+    float cooldown;                             // ms
+    float debounce;                             // ms
+    float falseAlarms;                          // Expected per day
+};
+
+// `widths` and `gaps` hold the first `stored` pulses (gaps[0] is not used);
+// `pulses` were counted over `length` ms in total
+inline CalibrationFit fitCalibration(const uint32_t* widths, const uint32_t* gaps, int stored,
+                                     unsigned long pulses, unsigned long length) {
+    CalibrationFit fit = {};
+    fit.pulses = pulses;
+    fit.hours = length / 3600000.0f;
+
+    // Log-normal pulse widths
+    if (stored > 0) {
+        float sum = 0, sumSquares = 0;
+        for (int i = 0; i < stored; i++) {
+            float w = logf(widths[i] > 1 ? (float)widths[i] : 1.0f);
+            sum += w;
+            sumSquares += w * w;
+        }
+        float mean = sum / stored;
+        fit.widthMedian = expf(mean);
+        fit.widthSpread = expf(sqrtf(fmaxf(sumSquares / stored - mean * mean, 0.0f)));
+    }
+
+    // Single exponential: one pulse every (length / pulses) on average
+    fit.quietGap = pulses ? length / (float)pulses : length;
+    int count = stored - 1;
+    if (count < CALIBRATION_MIN_GAPS) {
+        return fit;
+    }
+
+    // Two exponentials by EM, started from a split at the mean gap
+    float mean = 0;
+    for (int i = 1; i <= count; i++) mean += gaps[i];
+    mean /= count;
+    float share = 0, burst = 0, quiet = 0;
+    for (int i = 1; i <= count; i++) {
+        if (gaps[i] <= mean) {
+            share++;
+            burst += gaps[i];
+        } else {
+            quiet += gaps[i];
+        }
+    }
+    if (share == 0 || share == count) {
+        return fit;
+    }
+    burst = fmaxf(burst / share, 1.0f);
+    quiet /= count - share;
+    share /= count;
+
+    for (int iteration = 0; iteration < 50; iteration++) {
+        float weight = 0, burstSum = 0, quietSum = 0;
+        for (int i = 1; i <= count; i++) {
+            float x = gaps[i];
+            float a = share / burst * expf(-x / burst);
+            float b = (1 - share) / quiet * expf(-x / quiet);
+            float r = (a + b) > 0 ? a / (a + b) : (x < quiet ? 1.0f : 0.0f);
+            weight += r;
+            burstSum += r * x;
+            quietSum += (1 - r) * x;
+        }
+        if (weight < 1 || count - weight < 1) {
+            return fit;                         // Collapsed into one component
+        }
+        share = weight / count;
+        burst = fmaxf(burstSum / weight, 1.0f);
+        quiet = quietSum / (count - weight);
+    }
+
+    // Only a real mixture if the two scales are well apart
+    if (quiet >= 4 * burst) {
+        fit.burstShare = share;
+        fit.burstGap = burst;
+        fit.quietGap = quiet;
+    }
+    return fit;
+}
+
+// Share of the noise pulses at least `debounce` ms wide
+inline float pulseFilterKept(const CalibrationFit& fit, float debounce) {
+    if (debounce <= 0) {
+        return 1;
+    }
+    float sigma = logf(fit.widthSpread);
+    float kept = debounce <= fit.widthMedian ? 1.0f : 0.0f;
+    if (sigma > 0.01f) {
+        kept = 0.5f * erfcf(logf(debounce / fit.widthMedian) / (sigma * 1.41421356f));
+    }
+    return kept;
+}
+
+// Noise pulses longer than the debounce after at least `cooldown` ms of quiet.
+// A burst (geometric number of pulses, mean 1 / (1 - burstShare)) passes if
+// any of its pulses does. The dropped pulses leave longer gaps between the
+// rest: a geometric number of exponential gaps is exponential again, with
+// the mean divided by the share kept.
+inline float noiseSessionsPerDay(const CalibrationFit& fit, float cooldown, float debounce) {
+    if (fit.pulses == 0) {
+        return 0;
+    }
+    float kept = pulseFilterKept(fit, debounce);
+    float dropped = 1 - kept;
+    float burstKept = 1 - (1 - fit.burstShare) * dropped / (1 - fit.burstShare * dropped);
+    float survival = (1 - fit.burstShare) * burstKept * expf(-cooldown * burstKept / fit.quietGap);
+    if (fit.burstShare > 0) {
+        survival += fit.burstShare * kept * expf(-cooldown * kept / fit.burstGap);
+    }
+    return fit.pulses * 24.0f / fit.hours * survival;
+}
+
+inline float expectedFalseAlarms(const CalibrationFit& fit, float cooldown, float spacing, float debounce) {
+    float sessions = noiseSessionsPerDay(fit, cooldown, debounce);
+    return sessions > 0 ? 1 / (spacing / 86400000.0f + 1 / sessions) : 0;
+}
+
+// Shortest cooldown, then shortest debounce, that meet the target
+inline CalibrationChoice chooseCalibration(const CalibrationFit& fit, const CalibrationLimits& limits) {
+    // Bridge 95% of the gaps inside a burst (e^-3)
+    float cooldown = fit.burstShare > 0 ? 3 * fit.burstGap : limits.defaultCooldown;
+    cooldown = fminf(fmaxf(cooldown, limits.minCooldown), limits.maxCooldown);
+
+    // Too much noise: merge more of it into one session
+    while (cooldown < limits.maxCooldown &&
+           expectedFalseAlarms(fit, cooldown, limits.spacing, 0) > limits.target) {
+        cooldown = fminf(cooldown + 1000, limits.maxCooldown);
+    }
+
+    // Then debounce the pin to ignore the shortest pulses
+    float debounce = 0;
+    while (debounce < limits.maxDebounce &&
+           expectedFalseAlarms(fit, cooldown, limits.spacing, debounce) > limits.target) {
+        debounce = fminf(debounce + limits.debounceStep, limits.maxDebounce);
+    }
+
+    CalibrationChoice choice;
+    choice.cooldown = cooldown;
+    choice.debounce = debounce;
+    choice.falseAlarms = expectedFalseAlarms(fit, cooldown, limits.spacing, debounce);
+    return choice;
+}
+
+#endif // NOISE_CALIBRATION_H
@@ -0,0 +1,178 @@
+#ifndef PIR_TRACE_H
+#define PIR_TRACE_H
+
+// ===================================================================
+// PIR TRACE FORMAT
+// ===================================================================
+//
+// Raw PIR pin traces streamed by the firmware's capture mode and read by
+// host/trace_recorder. The pin is sampled at a fixed rate and sent as runs
+// (level + number of samples). Each packet is COBS encoded and framed by
+// 0x00 bytes, so the frames can share the serial port with the text log.
+//
+// Packet:  'P' 'T' <version> <type> <flags> <u16 seq>  payload  <u32 CRC-32>
+// START:   u32 sample rate (Hz), u8 pin, u8 active level, u32 boot, u32 uptime (ms)
+// RUNS:    varint first sample, u8 first level, varint run lengths...
+//          Levels alternate; a zero-length run keeps the alternation when a
+//          long run was split.
+// STOP:    varint samples taken, varint runs dropped
+//
+// Integers are little-endian, varints LEB128 (see motion_event.h), the CRC
+// is CRC-32/ISO-HDLC over everything before it.
+//
+// Has no Arduino dependencies so it can be compiled on the host.
+
+#include "motion_event.h"
+
+#define PIR_TRACE_VERSION 1
+#define PIR_TRACE_HEADER_SIZE 7
+#define PIR_TRACE_CRC_SIZE 4
+#define PIR_TRACE_MAX_PACKET 240
+
+// Worst case frame: two delimiters plus one COBS code byte per 254 bytes
+#define PIR_TRACE_MAX_FRAME (PIR_TRACE_MAX_PACKET + PIR_TRACE_MAX_PACKET / 254 + 3)
+
+enum PirTraceType : uint8_t {
+    PIR_TRACE_START = 1,
+    PIR_TRACE_RUNS = 2,
+    PIR_TRACE_STOP = 3
+};
+
+// Packet flags
+#define PIR_TRACE_FLAG_GAP 0x01                 // Runs were dropped before this packet
+
+inline uint32_t pirTraceCrc32(const uint8_t* data, size_t length) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc = table[(crc ^ data[i]) & 0x0F] ^ (crc >> 4);
+        crc = table[(crc ^ (data[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+// Encodes `length` bytes without any zero byte; `out` needs length + length / 254 + 1
+inline size_t pirTraceCobsEncode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t code = 0, pos = 1;
+    out[0] = 1;
+    for (size_t i = 0; i < length; i++) {
+        if (in[i] != 0) {
+            out[pos++] = in[i];
+            out[code]++;
+        }
+        if (in[i] == 0 || out[code] == 0xFF) {
+            code = pos++;
+            out[code] = 1;
+        }
+    }
+    return pos;
+}
+
+// Decodes one frame (without delimiters); 0 if it is not valid COBS
+inline size_t pirTraceCobsDecode(const uint8_t* in, size_t length, uint8_t* out) {
+    size_t pos = 0, written = 0;
+    while (pos < length) {
+        uint8_t code = in[pos++];
+        if (code == 0 || pos + code - 1 > length) {
+            return 0;
+        }
+        for (uint8_t i = 1; i < code; i++) {
+            out[written++] = in[pos++];
+        }
+        if (code != 0xFF && pos < length) {
+            out[written++] = 0;
+        }
+    }
+    return written;
+}
+
+inline void pirTracePutU32(uint8_t* out, uint32_t value) {
+    out[0] = (uint8_t)value;
+    out[1] = (uint8_t)(value >> 8);
+    out[2] = (uint8_t)(value >> 16);
+    out[3] = (uint8_t)(value >> 24);
+}
+
+inline uint32_t pirTraceGetU32(const uint8_t* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+class PirTracePacketWriter {
+public:
+    void begin(uint8_t type, uint16_t seq, uint8_t flags) {
+        buffer_[0] = 'P';
+        buffer_[1] = 'T';
+        buffer_[2] = PIR_TRACE_VERSION;
+        buffer_[3] = type;
+        buffer_[4] = flags;
+        buffer_[5] = (uint8_t)seq;
+        buffer_[6] = (uint8_t)(seq >> 8);
+        length_ = PIR_TRACE_HEADER_SIZE;
+    }
+
+    // Callers check remaining() first; a varint takes at most 5 bytes
+    void putByte(uint8_t value) { buffer_[length_++] = value; }
+    void putU32(uint32_t value) {
+        pirTracePutU32(buffer_ + length_, value);
+        length_ += 4;
+    }
+    void putVarint(uint32_t value) { length_ += motionEventPutVarint(buffer_ + length_, value); }
+
+    size_t remaining() const { return PIR_TRACE_MAX_PACKET - PIR_TRACE_CRC_SIZE - length_; }
+    size_t payloadSize() const { return length_ - PIR_TRACE_HEADER_SIZE; }
+
+    // Appends the CRC and writes the delimited frame to `out`
+    // (PIR_TRACE_MAX_FRAME bytes); returns the frame length
+    size_t frame(uint8_t* out) {
+        pirTracePutU32(buffer_ + length_, pirTraceCrc32(buffer_, length_));
+        out[0] = 0;
+        size_t encoded = pirTraceCobsEncode(buffer_, length_ + PIR_TRACE_CRC_SIZE, out + 1);
+        out[encoded + 1] = 0;
+        return encoded + 2;
+    }
+
+private:
+    uint8_t buffer_[PIR_TRACE_MAX_PACKET];
+    size_t length_ = 0;
+};
+
+struct PirTracePacket {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t seq;
+    const uint8_t* payload;
+    size_t payloadLength;
+};
+
+// Checks a decoded packet's header and CRC
+inline bool pirTraceParsePacket(const uint8_t* data, size_t length, PirTracePacket& packet) {
+    if (length < PIR_TRACE_HEADER_SIZE + PIR_TRACE_CRC_SIZE || data[0] != 'P' || data[1] != 'T' || data[2] == 0 ||
+        data[2] > PIR_TRACE_VERSION) {
+        return false;
+    }
+    size_t body = length - PIR_TRACE_CRC_SIZE;
+    if (pirTraceGetU32(data + body) != pirTraceCrc32(data, body)) {
+        return false;
+    }
+    packet.type = data[3];
+    packet.flags = data[4];
+    packet.seq = data[5] | (data[6] << 8);
+    packet.payload = data + PIR_TRACE_HEADER_SIZE;
+    packet.payloadLength = body - PIR_TRACE_HEADER_SIZE;
+    return true;
+}
+
+// Reads varints from a packet payload; false at the end or on a truncated one
+inline bool pirTraceReadVarint(const uint8_t* data, size_t length, size_t& pos, uint32_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 35 && pos < length; shift += 7) {
+        uint8_t byte = data[pos++];
+        value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+    }
+    return false;
+}
+
+#endif // PIR_TRACE_H
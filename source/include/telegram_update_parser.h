@@ -0,0 +1,411 @@
+#ifndef TELEGRAM_UPDATE_PARSER_H
+#define TELEGRAM_UPDATE_PARSER_H
+
+// ===================================================================
+// STREAMING TELEGRAM UPDATE PARSER
+// ===================================================================
+//
+// Incremental JSON scanner for getUpdates responses and webhook bodies.
+// Bytes are fed as they arrive from the socket; only update_id, chat.id,
+// from.first_name and text are kept, written straight into fixed-size
+// command slots (truncated if longer). Memory use is the parser object
+// plus the slots, independent of the response size.
+//
+// Has no Arduino dependencies so it can be compiled on the host.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifndef TELEGRAM_COMMAND_MAX_LENGTH
+#define TELEGRAM_COMMAND_MAX_LENGTH 128
+#endif
+
+// A command taken from a Telegram update
+struct TelegramInboundCommand {
+    char chatId[24];
+    char fromName[32];
+    char text[TELEGRAM_COMMAND_MAX_LENGTH];
+    int64_t updateId;
+    unsigned long receivedAt;
+};
+
+class TelegramUpdateParser {
+public:
+    enum Layout {
+        LAYOUT_UPDATES_RESPONSE,  // {"ok":true,"result":[{update}, ...]}
+        LAYOUT_SINGLE_UPDATE      // {update} as POSTed to a webhook
+    };
+
+    void begin(Layout layout, TelegramInboundCommand* slots, int capacity) {
+        layout_ = layout;
+        slots_ = slots;
+        capacity_ = capacity;
+        count_ = 0;
+        updates_ = 0;
+        maxUpdateId_ = -1;
+        ok_ = (layout == LAYOUT_SINGLE_UPDATE);
+        error_ = false;
+        depth_ = 0;
+        state_ = STATE_VALUE;
+        bytes_ = 0;
+        target_ = TARGET_NONE;
+        highSurrogate_ = 0;
+        current_ = &scratch_;
+        clearSlot();
+    }
+
+    // Feeds the next chunk of the body. Returns false once the input is malformed.
+    bool feed(const char* data, size_t length) {
+        for (size_t i = 0; i < length && !error_; i++) {
+            step(data[i]);
+        }
+        bytes_ += length;
+        return !error_;
+    }
+
+    bool ok() const { return ok_ && !error_ && depth_ == 0; }  // Complete and "ok":true
+    bool failed() const { return error_; }
+    int commandCount() const { return count_; }                // Slots filled
+    int updateCount() const { return updates_; }               // Updates seen, with or without text
+    int64_t maxUpdateId() const { return maxUpdateId_; }       // -1 if none
+    size_t bytesParsed() const { return bytes_; }
+
+private:
+    enum State : uint8_t {
+        STATE_VALUE,        // Expecting a value (or ']' of an empty array)
+        STATE_KEY,          // Expecting a key (or '}' of an empty object)
+        STATE_COLON,
+        STATE_AFTER_VALUE,  // Expecting ',' or a closing bracket
+        STATE_STRING,
+        STATE_STRING_ESCAPE,
+        STATE_STRING_UNICODE,
+        STATE_LITERAL       // Number, true, false or null
+    };
+
+    enum Key : uint8_t {
+        KEY_OTHER, KEY_OK, KEY_RESULT, KEY_UPDATE_ID, KEY_MESSAGE, KEY_CHANNEL_POST,
+        KEY_CHAT, KEY_ID, KEY_FROM, KEY_FIRST_NAME, KEY_TEXT
+    };
+
+    enum Target : uint8_t { TARGET_NONE, TARGET_KEY, TARGET_CHAT_ID, TARGET_FROM_NAME, TARGET_TEXT, TARGET_UPDATE_ID, TARGET_OK };
+
+    static const int MAX_DEPTH = 12;
+    static const int KEY_BUFFER = 16;
+
+    Layout layout_;
+    TelegramInboundCommand* slots_;
+    int capacity_;
+    int count_;
+    int updates_;
+    int64_t maxUpdateId_;
+    bool ok_;
+    bool error_;
+
+    State state_;
+    int depth_;
+    bool isObject_[MAX_DEPTH];
+    Key key_[MAX_DEPTH];
+
+    // String/literal capture
+    Target target_;
+    char* out_;
+    size_t outSize_;
+    size_t outLength_;
+    char keyBuffer_[KEY_BUFFER];
+    char literal_[24];
+    size_t literalLength_;
+    uint32_t unicode_;
+    uint8_t unicodeDigits_;
+    uint32_t highSurrogate_;
+
+    // Current update
+    TelegramInboundCommand* current_;
+    TelegramInboundCommand scratch_;
+    bool hasText_;
+    size_t bytes_;
+
+    int updateDepth() const { return layout_ == LAYOUT_UPDATES_RESPONSE ? 3 : 1; }
+
+    void clearSlot() {
+        current_ = (count_ < capacity_) ? &slots_[count_] : &scratch_;
+        current_->chatId[0] = '\0';
+        current_->fromName[0] = '\0';
+        current_->text[0] = '\0';
+        current_->updateId = -1;
+        current_->receivedAt = 0;
+        hasText_ = false;
+    }
+
+    static Key classifyKey(const char* key) {
+        switch (key[0]) {
+            case 'o': return strcmp(key, "ok") == 0 ? KEY_OK : KEY_OTHER;
+            case 'r': return strcmp(key, "result") == 0 ? KEY_RESULT : KEY_OTHER;
+            case 'u': return strcmp(key, "update_id") == 0 ? KEY_UPDATE_ID : KEY_OTHER;
+            case 'm': return strcmp(key, "message") == 0 ? KEY_MESSAGE : KEY_OTHER;
+            case 'c': return strcmp(key, "chat") == 0 ? KEY_CHAT :
+                             strcmp(key, "channel_post") == 0 ? KEY_CHANNEL_POST : KEY_OTHER;
+            case 'i': return strcmp(key, "id") == 0 ? KEY_ID : KEY_OTHER;
+            case 'f': return strcmp(key, "from") == 0 ? KEY_FROM :
+                             strcmp(key, "first_name") == 0 ? KEY_FIRST_NAME : KEY_OTHER;
+            case 't': return strcmp(key, "text") == 0 ? KEY_TEXT : KEY_OTHER;
+            default:  return KEY_OTHER;
+        }
+    }
+
+    // Decides where the value about to start at the current depth should go
+    Target valueTarget() const {
+        int u = updateDepth();
+        if (layout_ == LAYOUT_UPDATES_RESPONSE && depth_ == 1) {
+            return key_[1] == KEY_OK ? TARGET_OK : TARGET_NONE;
+        }
+        if (layout_ == LAYOUT_UPDATES_RESPONSE && (depth_ < 2 || key_[1] != KEY_RESULT)) {
+            return TARGET_NONE;
+        }
+        if (depth_ == u) {
+            return key_[u] == KEY_UPDATE_ID ? TARGET_UPDATE_ID : TARGET_NONE;
+        }
+        if (depth_ < u + 1 || (key_[u] != KEY_MESSAGE && key_[u] != KEY_CHANNEL_POST)) {
+            return TARGET_NONE;
+        }
+        if (depth_ == u + 1) {
+            return key_[u + 1] == KEY_TEXT ? TARGET_TEXT : TARGET_NONE;
+        }
+        if (depth_ == u + 2) {
+            if (key_[u + 1] == KEY_CHAT && key_[u + 2] == KEY_ID) return TARGET_CHAT_ID;
+            if (key_[u + 1] == KEY_FROM && key_[u + 2] == KEY_FIRST_NAME) return TARGET_FROM_NAME;
+        }
+        return TARGET_NONE;
+    }
+
+    void startCapture(Target target) {
+        target_ = target;
+        outLength_ = 0;
+        switch (target) {
+            case TARGET_KEY:       out_ = keyBuffer_;           outSize_ = sizeof(keyBuffer_); break;
+            case TARGET_CHAT_ID:   out_ = current_->chatId;     outSize_ = sizeof(current_->chatId); break;
+            case TARGET_FROM_NAME: out_ = current_->fromName;   outSize_ = sizeof(current_->fromName); break;
+            case TARGET_TEXT:      out_ = current_->text;       outSize_ = sizeof(current_->text); break;
+            default:               out_ = nullptr;              outSize_ = 0; break;
+        }
+    }
+
+    void put(char c) {
+        if (out_ && outLength_ + 1 < outSize_) {
+            out_[outLength_++] = c;
+        }
+    }
+
+    void putCodepoint(uint32_t cp) {
+        // Drop a multi-byte sequence that would not fit entirely
+        size_t room = (out_ && outSize_ > outLength_ + 1) ? outSize_ - outLength_ - 1 : 0;
+        if (cp < 0x80) {
+            put((char)cp);
+        } else if (cp < 0x800) {
+            if (room < 2) { outSize_ = outLength_ + 1; return; }
+            put((char)(0xC0 | (cp >> 6)));
+            put((char)(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            if (room < 3) { outSize_ = outLength_ + 1; return; }
+            put((char)(0xE0 | (cp >> 12)));
+            put((char)(0x80 | ((cp >> 6) & 0x3F)));
+            put((char)(0x80 | (cp & 0x3F)));
+        } else {
+            if (room < 4) { outSize_ = outLength_ + 1; return; }
+            put((char)(0xF0 | (cp >> 18)));
+            put((char)(0x80 | ((cp >> 12) & 0x3F)));
+            put((char)(0x80 | ((cp >> 6) & 0x3F)));
+            put((char)(0x80 | (cp & 0x3F)));
+        }
+    }
+
+    // Length without a UTF-8 sequence cut short by truncation
+    static size_t trimPartialUtf8(const char* s, size_t length) {
+        size_t i = length;
+        size_t continuation = 0;
+        while (i > 0 && ((uint8_t)s[i - 1] & 0xC0) == 0x80 && continuation < 3) {
+            i--;
+            continuation++;
+        }
+        if (i == 0) return length;
+        uint8_t lead = (uint8_t)s[i - 1];
+        size_t expected = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        return expected > continuation ? i - 1 : length;
+    }
+
+    void finishString() {
+        if (out_) {
+            if (outLength_ + 1 >= outSize_) outLength_ = trimPartialUtf8(out_, outLength_);
+            out_[outLength_] = '\0';
+        }
+        if (target_ == TARGET_KEY) {
+            key_[depth_] = classifyKey(keyBuffer_);
+            state_ = STATE_COLON;
+            return;
+        }
+        if (target_ == TARGET_TEXT) {
+            hasText_ = outLength_ > 0;
+        }
+        state_ = STATE_AFTER_VALUE;
+    }
+
+    void finishLiteral() {
+        literal_[literalLength_] = '\0';
+        if (target_ == TARGET_OK) {
+            ok_ = strcmp(literal_, "true") == 0;
+        } else if (target_ == TARGET_UPDATE_ID) {
+            int64_t id = 0;
+            for (const char* p = literal_; *p >= '0' && *p <= '9'; p++) id = id * 10 + (*p - '0');
+            if (id > maxUpdateId_) maxUpdateId_ = id;
+            current_->updateId = id;
+        } else if (target_ == TARGET_CHAT_ID) {
+            size_t length = literalLength_ < sizeof(current_->chatId) ? literalLength_ : sizeof(current_->chatId) - 1;
+            memcpy(current_->chatId, literal_, length);
+            current_->chatId[length] = '\0';
+        }
+        state_ = STATE_AFTER_VALUE;
+    }
+
+    void openContainer(bool isObject) {
+        if (depth_ + 1 >= MAX_DEPTH) {
+            error_ = true;
+            return;
+        }
+        depth_++;
+        isObject_[depth_] = isObject;
+        key_[depth_] = KEY_OTHER;
+        if (isObject && depth_ == updateDepth() &&
+            (layout_ == LAYOUT_SINGLE_UPDATE || key_[1] == KEY_RESULT)) {
+            clearSlot();
+        }
+        state_ = isObject ? STATE_KEY : STATE_VALUE;
+    }
+
+    void closeContainer(bool isObject) {
+        if (depth_ == 0 || isObject_[depth_] != isObject) {
+            error_ = true;
+            return;
+        }
+        if (isObject && depth_ == updateDepth() &&
+            (layout_ == LAYOUT_SINGLE_UPDATE || key_[1] == KEY_RESULT)) {
+            updates_++;
+            if (hasText_ && current_ != &scratch_) {
+                count_++;
+            }
+        }
+        depth_--;
+        state_ = STATE_AFTER_VALUE;
+    }
+
+    static bool isBlank(char c) { return c == ' ' || c == '\n' || c == '\r' || c == '\t'; }
+
+    void step(char c) {
+        switch (state_) {
+            case STATE_STRING:
+                if (c == '"') finishString();
+                else if (c == '\\') state_ = STATE_STRING_ESCAPE;
+                else put(c);
+                return;
+
+            case STATE_STRING_ESCAPE:
+                state_ = STATE_STRING;
+                switch (c) {
+                    case 'n': put('\n'); break;
+                    case 't': put('\t'); break;
+                    case 'r': put('\r'); break;
+                    case 'b': put('\b'); break;
+                    case 'f': put('\f'); break;
+                    case 'u': state_ = STATE_STRING_UNICODE; unicode_ = 0; unicodeDigits_ = 0; break;
+                    default:  put(c); break;  // \" \\ \/
+                }
+                return;
+
+            case STATE_STRING_UNICODE: {
+                uint32_t digit;
+                if (c >= '0' && c <= '9') digit = c - '0';
+                else if (c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                else if (c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                else { error_ = true; return; }
+                unicode_ = (unicode_ << 4) | digit;
+                if (++unicodeDigits_ < 4) return;
+
+                state_ = STATE_STRING;
+                if (unicode_ >= 0xD800 && unicode_ <= 0xDBFF) {
+                    highSurrogate_ = unicode_;  // Wait for the low half
+                } else if (unicode_ >= 0xDC00 && unicode_ <= 0xDFFF && highSurrogate_) {
+                    putCodepoint(0x10000 + ((highSurrogate_ - 0xD800) << 10) + (unicode_ - 0xDC00));
+                    highSurrogate_ = 0;
+                } else {
+                    putCodepoint(unicode_);
+                    highSurrogate_ = 0;
+                }
+                return;
+            }
+
+            case STATE_LITERAL:
+                if ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || c == '-' || c == '+' || c == '.' || c == 'E') {
+                    if (literalLength_ + 1 < sizeof(literal_)) literal_[literalLength_++] = c;
+                    return;
+                }
+                finishLiteral();
+                break;  // Re-examine c as the token after the literal
+
+            default:
+                break;
+        }
+
+        if (isBlank(c)) {
+            return;
+        }
+
+        switch (state_) {
+            case STATE_VALUE:
+                if (c == '{') openContainer(true);
+                else if (c == '[') openContainer(false);
+                else if (c == ']' && depth_ > 0 && !isObject_[depth_]) closeContainer(false);
+                else if (c == '"') {
+                    startCapture(valueTarget());
+                    highSurrogate_ = 0;
+                    state_ = STATE_STRING;
+                } else if (c == '-' || (c >= '0' && c <= '9') || c == 't' || c == 'f' || c == 'n') {
+                    target_ = valueTarget();
+                    literalLength_ = 0;
+                    literal_[literalLength_++] = c;
+                    state_ = STATE_LITERAL;
+                } else {
+                    error_ = true;
+                }
+                break;
+
+            case STATE_KEY:
+                if (c == '"') {
+                    startCapture(TARGET_KEY);
+                    highSurrogate_ = 0;
+                    state_ = STATE_STRING;
+                } else if (c == '}') {
+                    closeContainer(true);
+                } else {
+                    error_ = true;
+                }
+                break;
+
+            case STATE_COLON:
+                if (c == ':') state_ = STATE_VALUE;
+                else error_ = true;
+                break;
+
+            case STATE_AFTER_VALUE:
+                if (c == ',' && depth_ > 0) state_ = isObject_[depth_] ? STATE_KEY : STATE_VALUE;
+                else if (c == '}') closeContainer(true);
+                else if (c == ']') closeContainer(false);
+                else error_ = true;
+                break;
+
+            default:
+                error_ = true;
+                break;
+        }
+    }
+};
+
+#endif // TELEGRAM_UPDATE_PARSER_H
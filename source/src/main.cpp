@@ -6,15 +6,35 @@
 
 #include <WiFi.h>
 #include <WiFiClientSecure.h>
+#include <WiFiUdp.h>
+#include <HTTPClient.h>
 #include <UniversalTelegramBot.h>
 #include <ArduinoJson.h>
-#include <NTPClient.h>
-#include <WiFiUdp.h>
 #include <esp_system.h>
 #include <esp_wifi.h>
 #include <esp_task_wdt.h>
+#include <esp_pm.h>
+#include <Preferences.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+#include <time.h>
 
 #include "config.h"
+#include "telegram_update_parser.h"
+#include "mqtt_client.h"
+#include "cluster_protocol.h"
+#include "motion_event.h"
+#include "pir_trace.h"
+#include "noise_calibration.h"
+
+#if TELEGRAM_WEBHOOK_ENABLED
+#include <esp_https_server.h>
+#endif
+
+#if TRACE_CAPTURE_ENABLED
+#include <esp_intr_alloc.h>
+#include <soc/gpio_reg.h>
+#endif
 
 // Include secrets file if it exists, otherwise use config.h defaults
 #ifdef __has_include
@@ -30,8 +50,6 @@
 
 WiFiClientSecure client;
 UniversalTelegramBot* bot = nullptr;
-WiFiUDP ntpUDP;
-NTPClient timeClient(ntpUDP, NTP_SERVER, TIMEZONE_OFFSET * 3600, TIME_SYNC_INTERVAL);
 
 // ===================================================================
 // STATE VARIABLES
@@ -49,6 +67,22 @@ unsigned long lastMotionTime = 0;
 unsigned long sensorStabilizationStart = 0;
 unsigned long motionSessionStart = 0;
 unsigned long lastMotionEnd = 0;
+int sessionTriggerCount = 0;            // Motion triggers in the current session
+bool sessionDigested = false;           // Current session goes into the digest instead of alerting
+
+// Sessions accumulated for the next digest message
+struct MotionDigest {
+    int sessions;
+    int triggers;
+    unsigned long openedAt;             // When the first session was added
+    unsigned long longestSession;       // ms
+    char firstTime[16];
+    char lastTime[16];
+};
+MotionDigest motionDigest = {};
+unsigned long lastDigestFlush = 0;
+unsigned long digestsSent = 0;
+unsigned long digestedSessions = 0;
 
 // Sensor Configuration Mode Variables
 int current_sensitivity_level = DEFAULT_SENSITIVITY;
@@ -60,6 +94,18 @@ unsigned long config_button_press_start = 0;
 bool config_button_held = false;
 int config_step = 0; // 0=sensitivity, 1=range, 2=test, 3=save
 
+// Auto-calibration result; while set it replaces the sensitivity/range tables
+#if AUTO_CALIBRATION_ENABLED
+bool sensorCalibrated = false;
+unsigned long calibratedDebounce = 0;   // Shorter pulses are ignored (ms)
+unsigned long calibratedCooldown = 0;
+float calibratedFalseAlarms = 0;        // Expected per day
+#endif
+
+// Display names indexed by sensitivity level / range setting
+static const char* const SENSITIVITY_LEVEL_NAMES[] = {"Very Low", "Low", "Medium", "High", "Very High"};
+static const char* const RANGE_SETTING_NAMES[] = {"Short", "Medium", "Long"};
+
 // Status flags
 bool motionDetected = false;
 bool motionSessionActive = false;
@@ -73,12 +119,156 @@ int consecutiveFailures = 0;
 int dailyNotificationCount = 0;
 int totalMotionEvents = 0;
 
+// Wall-clock state (see TIME FUNCTIONS)
+enum TimeSource { TIME_SOURCE_NONE, TIME_SOURCE_HTTP, TIME_SOURCE_SNTP };
+volatile TimeSource timeSource = TIME_SOURCE_NONE;
+volatile unsigned long timeSyncCount = 0;
+volatile bool timeCacheStale = true;
+struct TimeCache {
+    struct tm local;
+    char formatted[12];                 // HH:MM:SS
+    char logStamp[24];                  // LOG_TIMESTAMP_FORMAT
+    time_t epoch;
+    unsigned long refreshedAt;          // millis() of the last refresh
+};
+TimeCache timeCache = {};
+portMUX_TYPE timeCacheMux = portMUX_INITIALIZER_UNLOCKED; // Guards timeCache; tasks work on copies
+static const time_t MIN_VALID_EPOCH = 1577836800; // 2020-01-01 - anything earlier means "not set"
+
 // Performance monitoring
 unsigned long loopStartTime = 0;
 unsigned long maxLoopTime = 0;
 unsigned long avgLoopTime = 0;
 unsigned long loopCount = 0;
 
+// Telegram update handling
+Preferences telegramPrefs;
+int64_t telegramUpdateOffset = 0;       // Next update_id to request (persisted in NVS)
+
+// Command replies merged per chat while a batch is processed
+struct PendingReply {
+    char chatId[24];
+    String text;
+};
+PendingReply pendingReplies[TELEGRAM_REPLY_SLOTS];
+int pendingReplyCount = 0;
+bool replyBatchActive = false;
+
+// Telegram polling statistics
+volatile unsigned long telegramPollRequests = 0;
+volatile unsigned long deferredCommands = 0;
+volatile unsigned long updatesFetched = 0;
+volatile int lastUpdateBatchSize = 0;
+volatile int maxUpdateBatchSize = 0;
+unsigned long commandsHandled = 0;
+unsigned long mergedReplies = 0;
+unsigned long lastCommandLatency = 0;
+unsigned long maxCommandLatency = 0;
+unsigned long totalCommandLatency = 0;
+unsigned long lastDrainCount = 0;
+unsigned long lastDrainMillis = 0;
+volatile unsigned long lastResponseBytes = 0;
+volatile unsigned long maxResponseBytes = 0;
+volatile unsigned long lastParseMicros = 0;
+
+// Rate limiter statistics
+unsigned long rateLimitDeferred = 0;        // Sends postponed for a token or a retry_after
+unsigned long rateLimitDropped = 0;         // Sends abandoned because the wait was too long
+unsigned long rateLimitWindowSuppressed = 0; // Motion alerts over the hourly limit
+unsigned long rateLimit429Count = 0;
+unsigned long lastRetryAfterSeconds = 0;
+
+// Notification routing: every message carries one class bit and is sent only
+// to the chats whose mask (built from the TelegramChat flags) includes it
+enum MessageClass : uint8_t {
+    MESSAGE_CLASS_MOTION = 1 << 0,      // Motion alerts (motion_alerts)
+    MESSAGE_CLASS_STATUS = 1 << 1,      // Startup, heartbeat, config and daily reports (status_updates)
+    MESSAGE_CLASS_ERROR  = 1 << 2       // System errors (error_alerts)
+};
+
+// Outbound priority classes, highest first; each has its own queue
+enum OutboundPriority {
+    PRIORITY_ALERT,                     // Motion alerts
+    PRIORITY_ERROR,                     // System errors
+    PRIORITY_REPLY,                     // Bot command replies
+    PRIORITY_STATUS,                    // Startup, heartbeat, config and daily notices
+    OUTBOUND_PRIORITY_COUNT
+};
+#ifdef USE_SECRETS_FILE
+uint8_t chatRoutes[TELEGRAM_CHAT_COUNT];
+uint8_t routedMessageClasses = 0;       // Classes accepted by at least one chat
+#endif
+
+// Boot profile: the uptime at which each init phase finished
+struct BootPhase {
+    const char* name;
+    unsigned long finishedAt;
+};
+BootPhase bootPhases[BOOT_PROFILE_MAX_PHASES];
+int bootPhaseCount = 0;
+unsigned long bootDuration = 0;
+
+// Warm-reset state, kept in RTC memory that survives software restarts,
+// panics and watchdog resets but not power loss
+#define RTC_BOOT_STATE_MAGIC 0x5049520Bu
+struct RtcBootState {
+    uint32_t magic;
+    uint32_t bootCount;                 // Boots since the last cold start
+    bool sensorStabilized;              // PIR finished its warm-up before the reset
+};
+RTC_NOINIT_ATTR RtcBootState rtcBootState;
+esp_reset_reason_t resetReason = ESP_RST_UNKNOWN;
+bool fastBoot = false;                  // Warm reset: skip the startup delay, LED test and warm-up
+int wifiPendingNetwork = -1;            // Network WiFi.begin() was already issued for during boot
+
+// CPU frequency scaling: the clock idles at CPU_IDLE_FREQUENCY and runs at
+// CPU_FREQUENCY only while a CpuBoost is held (TLS handshakes, parsing)
+#if CPU_SCALING_ENABLED
+esp_pm_lock_handle_t cpuBoostLock = nullptr;
+SemaphoreHandle_t cpuBoostMutex = nullptr;
+#endif
+bool cpuScalingAutomatic = false;       // esp_pm DFS active (otherwise setCpuFrequencyMhz)
+int cpuBoostDepth = 0;
+unsigned long cpuBoostStartedAt = 0;
+unsigned long cpuBoostedMillis = 0;     // Time spent at CPU_FREQUENCY
+unsigned long cpuBoostCount = 0;
+unsigned long powerAccountingStart = 0;
+
+// DNS cache statistics (Bot API host)
+unsigned long dnsLookups = 0;           // Addresses requested for a connect
+unsigned long dnsHits = 0;              // ...served from a fresh entry
+unsigned long dnsStaleHits = 0;         // ...served past TTL because refreshes failed
+unsigned long dnsQueries = 0;
+unsigned long dnsFailures = 0;          // Queries that timed out or were rejected
+unsigned long lastResolveMillis = 0;
+unsigned long maxResolveMillis = 0;
+
+// Task that makes every Bot API write (see OUTBOUND QUEUE); null until started
+TaskHandle_t telegramSendTaskHandle = nullptr;
+
+// TLS handshake statistics (Bot API connections)
+unsigned long tlsHandshakes = 0;
+unsigned long tlsHandshakeFailures = 0;
+unsigned long tlsTotalHandshakeMillis = 0;
+unsigned long tlsLastHandshakeMillis = 0;
+unsigned long tlsMaxHandshakeMillis = 0;
+long tlsLastHeapBytes = 0;              // Heap held by the last connection's TLS context
+
+// MQTT statistics
+unsigned long mqttPublished = 0;        // Messages queued for the broker
+unsigned long mqttAcked = 0;
+unsigned long mqttDropped = 0;          // Oldest messages pushed out of a full queue
+unsigned long mqttRetransmits = 0;
+unsigned long mqttConnects = 0;
+unsigned long lastMqttAckMillis = 0;    // Publish to PUBACK of the last message
+
+// Speculative pre-warm statistics
+unsigned long prewarmOpened = 0;        // Connections opened on a raw PIR edge
+unsigned long prewarmHits = 0;          // ...used by a send before the timeout
+unsigned long prewarmMisses = 0;        // ...closed unused
+unsigned long prewarmAlreadyOpen = 0;   // Edges that found the connection open
+unsigned long prewarmFailed = 0;
+
 // Error tracking
 int wifiFailureCount = 0;
 int telegramFailureCount = 0;
@@ -91,11 +281,109 @@ unsigned long lastErrorTime = 0;
 
 // Core system functions
 void initializeSystem();
+void detectBootProfile();
+void markBootPhase(const char* name);
+void printBootProfile();
+const char* resetReasonName(esp_reset_reason_t reason);
 void systemLoop();
 void performSystemChecks();
 void handleWatchdog();
 
+// Power management functions
+void initializePowerManagement();
+void cpuBoostAcquire();
+void cpuBoostRelease();
+unsigned long cpuBoostedTime();
+String getPowerSummary();
+
+// Holds the CPU at full clock for the lifetime of the guard
+struct CpuBoost {
+    CpuBoost() { cpuBoostAcquire(); }
+    ~CpuBoost() { cpuBoostRelease(); }
+};
+
+// Event journal functions
+void initializeEventJournal();
+void fillEventHeader(MotionEventHeader& header, uint32_t firstSeq);
+#if EVENT_JOURNAL_ENABLED
+void startJournalBlock();
+void sealJournalBlock();
+void journalEvent(uint8_t type, uint32_t duration, uint8_t flags);
+void printEventJournal();
+String formatJournalStats();
+#endif
+
+// Notifier pipeline functions
+void initializeNotifiers();
+void sendNotification(const String& message, uint8_t messageClass);
+String formatNotifierStats();
+
+// Cluster functions
+#if CLUSTER_ENABLED
+void initializeCluster();
+void clusterTask(void* parameter);
+void serviceCluster();
+void clusterReportMotion();
+void clusterSend(const uint8_t* data, size_t length, void* context);
+uint32_t clusterWallClock();
+void queueClusterAlert(const ClusterAlert& alert, void* context);
+void onClusterAlert(const ClusterAlert& alert, void* context);
+String formatClusterStats();
+#endif
+
+// TLS functions
+void configureTelegramTls(WiFiClientSecure& connection, bool verified);
+bool openTelegramConnection(WiFiClientSecure& connection, bool verified);
+bool connectTelegramClient(WiFiClientSecure& connection);
+#if TLS_BENCHMARK_AT_BOOT
+void runTlsBenchmark();
+#endif
+
+// DNS cache functions
+#if DNS_CACHE_ENABLED
+size_t buildDnsQuery(uint8_t* buffer, size_t size, const char* host, uint16_t id);
+size_t skipDnsName(const uint8_t* packet, size_t length, size_t pos);
+bool parseDnsResponse(const uint8_t* packet, size_t length, uint16_t id, uint32_t& address, uint32_t& ttlSeconds);
+bool sendDnsQuery();
+int pollDnsResponse();
+void resolveTelegramHostNow();
+void serviceDnsCache();
+bool telegramHostAddress(IPAddress& address);
+#endif
+
+// MQTT functions
+#if MQTT_ENABLED
+bool connectMqtt();
+void serviceMqtt();
+void mqttEnqueue(const char* subtopic, const char* payload, bool retain);
+void mqttFlush();
+void onMqttAck(uint16_t packetId);
+void mqttPublishMotion();
+void mqttPublishSession(bool started, unsigned long durationSeconds);
+void mqttPublishTelemetry();
+#endif
+
+// Pre-warm functions
+void createTelegramClientMutex();
+void telegramClientAcquire();
+void telegramClientRelease();
+void notePrewarmUse();
+#if TELEGRAM_PREWARM_ENABLED
+void startPrewarmTask();
+void prewarmTask(void* parameter);
+void servicePrewarm();
+#endif
+
+// Exclusive use of `client`, shared by the sender task, the pre-warm task
+// and command replies
+struct TelegramClientLock {
+    TelegramClientLock() { telegramClientAcquire(); }
+    ~TelegramClientLock() { telegramClientRelease(); }
+};
+
 // Network functions
+void configureWiFi();
+void startWiFiConnection();
 void initializeWiFi();
 bool connectToWiFi();
 void checkWiFiConnection();
@@ -105,12 +393,104 @@ void printNetworkInfo();
 
 // Telegram functions
 void initializeTelegram();
-bool sendTelegramMessage(const char* chatId, const String& message);
-void sendTelegramNotification(const String& message);
+bool sendTelegramMessage(const char* chatId, const String& message, long* messageId = nullptr);
+bool sendTelegramNotification(const String& message, uint8_t messageClass, unsigned long createdAt);
+bool deliverTelegramNotification(const String& message, uint8_t messageClass);
+void buildChatRoutes();
 void handleTelegramCommands();
+void dispatchTelegramMessage(const String& chatId, const String& text, const String& fromName);
+void loadTelegramUpdateOffset();
+int fetchTelegramUpdates(WiFiClientSecure& connection, int timeoutSeconds, TelegramInboundCommand* batch, int capacity,
+                         int64_t& nextOffset);
+void commitTelegramUpdateOffset(int64_t nextOffset);
+void processInboundCommands(const TelegramInboundCommand* commands, int count);
+void saveTelegramUpdateOffset();
+void beginCommandReplyBatch();
+void queueCommandReply(const String& chatId, const String& response);
+void flushCommandReplies();
+#if TELEGRAM_LONG_POLL_ENABLED || TELEGRAM_WEBHOOK_ENABLED
+bool initializeTelegramCommandQueue();
+void drainTelegramCommandQueue();
+#endif
+#if TELEGRAM_LONG_POLL_ENABLED
+void startTelegramPollTask();
+void telegramPollTask(void* parameter);
+#endif
+#if TELEGRAM_WEBHOOK_ENABLED
+void startWebhookServer();
+bool registerTelegramWebhook();
+String percentEncode(const char* text);
+#endif
+bool waitForTelegramData(WiFiClientSecure& connection, unsigned long deadline);
+bool readTelegramResponseHead(WiFiClientSecure& connection, unsigned long deadline, int& status, long& contentLength);
+bool readResponseBody(WiFiClientSecure& connection, long contentLength, unsigned long deadline,
+                      char* keep = nullptr, size_t keepSize = 0);
+bool postTelegramMessage(const char* chatId, const String& message, unsigned long& retryAfter, long* messageId);
+long parseMessageId(const char* body);
+OutboundPriority outboundPriorityFor(uint8_t messageClass);
+void enqueueOutbound(OutboundPriority priority, const char* chatId, uint8_t messageClass, const String& text,
+                     unsigned long createdAt = 0);
+bool sendOutboundMessage(OutboundPriority priority);
+bool serviceOutboundQueue();
+void drainOutboundQueue();
+void wakeTelegramSender();
+void startTelegramSendTask();
+void telegramSendTask(void* parameter);
+bool serviceTelegramSender();
+#if TELEGRAM_FANOUT_ENABLED
+struct FanOutDelivery;
+bool fanOutTelegramNotification(const String& message, uint8_t messageClass);
+int serviceTelegramFanOut();
+void writeFanOutRequest(const FanOutDelivery& delivery);
+void scheduleFanOutRetry(FanOutDelivery& delivery);
+void finishFanOutDelivery(FanOutDelivery& delivery, bool delivered);
+#endif
+#if LIVE_SESSION_ENABLED
+void beginLiveSession();
+void recordLiveSessionMessage(const char* chatId, long messageId);
+void noteLiveSessionTrigger();
+void updateLiveSession();
+void closeLiveSession();
+String formatLiveSessionText(bool closed);
+struct LiveSessionMessage;
+void editLiveSessionMessages(const LiveSessionMessage* entries, int count, const String& text, bool closed);
+#endif
 void processCommand(const String& chatId, const String& command, const String& fromName);
+void initializeBotCommands();
+int parseCommandIntArg(const char* args);
 String formatMessage(const char* templateStr, const char* param1 = "", const char* param2 = "", const char* param3 = "");
 
+// Rate limiting functions
+struct TokenBucket;
+struct ChatRateLimit;
+unsigned long bucketWait(TokenBucket& bucket, long perMinute, long burst);
+ChatRateLimit& chatRateLimit(const char* chatId);
+unsigned long rateLimitWait(const char* chatId);
+void rateLimitConsume(const char* chatId);
+void rateLimitRetryAfter(const char* chatId, unsigned long retryAfterSeconds);
+unsigned long parseRetryAfter(const char* body);
+void advanceNotificationWindow();
+int notificationsInLastHour();
+void recordNotificationInWindow();
+
+// Bot command handlers (registered in BOT_COMMAND_LIST)
+void cmdStatus(const String& chatId, const char* args, String& response);
+void cmdTest(const String& chatId, const char* args, String& response);
+void cmdHelp(const String& chatId, const char* args, String& response);
+void cmdStats(const String& chatId, const char* args, String& response);
+void cmdCommandStats(const String& chatId, const char* args, String& response);
+void cmdBotStats(const String& chatId, const char* args, String& response);
+void cmdInfo(const String& chatId, const char* args, String& response);
+void cmdReset(const String& chatId, const char* args, String& response);
+void cmdReboot(const String& chatId, const char* args, String& response);
+void cmdSensorConfig(const String& chatId, const char* args, String& response);
+void cmdSensitivity(const String& chatId, const char* args, String& response);
+void cmdRange(const String& chatId, const char* args, String& response);
+void cmdTestSensor(const String& chatId, const char* args, String& response);
+void cmdShowSettings(const String& chatId, const char* args, String& response);
+void cmdHistory(const String& chatId, const char* args, String& response);
+void cmdTrace(const String& chatId, const char* args, String& response);
+
 // Motion detection functions
 void initializeMotionSensor();
 void handleMotionDetection();
@@ -119,6 +499,39 @@ void processMotionEvent();
 bool shouldSendNotification();
 void updateMotionStatistics();
 
+// Motion digest functions
+#if DIGEST_MODE_ENABLED
+bool shouldDigestSession(unsigned long currentTime);
+void addSessionToDigest(unsigned long sessionStart, unsigned long sessionEnd, int triggers);
+void serviceMotionDigest();
+void flushMotionDigest();
+#endif
+
+// Motion history functions
+#if HISTORY_ENABLED
+struct HistoryBucket;
+struct HistoryRing;
+uint32_t historyClock();
+HistoryBucket& historyBucket(HistoryRing& ring, uint32_t now);
+void historyRecordTrigger(bool sessionStart);
+void historyRecordSessionEnd(unsigned long durationSeconds);
+void loadHistory();
+void saveHistory();
+void serviceHistory();
+String formatHistory(const char* args);
+#endif
+
+// Trace capture functions
+#if TRACE_CAPTURE_ENABLED
+void onTraceSample();
+void traceTask(void* parameter);
+void writeTraceFrame(PirTracePacketWriter& packet);
+bool startTraceCapture(unsigned long seconds);
+void stopTraceCapture();
+bool traceCaptureActive();
+String formatTraceStatus();
+#endif
+
 // Sensor configuration functions
 void initializeConfigButton();
 void handleSensorConfigMode();
@@ -135,10 +548,27 @@ void showCurrentSettings();
 void applySensorSettings();
 unsigned long getSensorDebounceDelay();
 unsigned long getMotionCooldownPeriod();
+unsigned long getMotionPinDebounce();
 void configModeLEDPattern(int pattern_type, int count = 1);
 
+// Auto-calibration functions
+#if AUTO_CALIBRATION_ENABLED
+bool startCalibration(unsigned long length);
+void serviceCalibration();
+void recordCalibrationPulse(unsigned long end);
+void finishCalibration();
+void clearCalibration();
+void saveCalibration();
+void loadCalibration();
+String formatCalibrationStatus();
+#endif
+
 // Time functions
 void initializeTime();
+void onTimeSync(struct timeval* tv);
+void seedClockFromHttpDate(const char* value);
+TimeCache timeCacheSnapshot();
+struct tm currentLocalTime();
 String getCurrentTimeString();
 String getUptimeString();
 bool isQuietHours();
@@ -159,6 +589,7 @@ void resetDailyCounters();
 void printSystemInfo();
 void logMessage(int level, const String& message);
 void handleSystemError(const String& error);
+String jsonEscape(const String& text);
 bool validateConfiguration();
 void saveSystemState();
 void loadSystemState();
@@ -183,6 +614,9 @@ void initializeConfigButton() {
     
     // Load saved sensor settings
     loadSensorSettings();
+    #if AUTO_CALIBRATION_ENABLED
+    loadCalibration();
+    #endif
     applySensorSettings();
 }
 
@@ -234,7 +668,7 @@ void enterSensorConfigMode() {
     configModeLEDPattern(LED_CONFIG_ENTER, 5);
     
     if (wifiConnected) {
-        sendTelegramNotification("🔧 *Sensor Config Mode*\nPress button to cycle through settings.\nHold button to save and exit.");
+        sendNotification("🔧 *Sensor Config Mode*\nPress button to cycle through settings.\nHold button to save and exit.", MESSAGE_CLASS_STATUS);
     }
     
     showCurrentSettings();
@@ -254,7 +688,7 @@ void exitSensorConfigMode() {
         String message = "✅ *Config Saved*\n";
         message += "Sensitivity: " + String(current_sensitivity_level) + "/4\n";
         message += "Range: " + String(current_range_setting) + "/2";
-        sendTelegramNotification(message);
+        sendNotification(message, MESSAGE_CLASS_STATUS);
     }
     
     delay(CONFIG_EXIT_DELAY);
@@ -316,11 +750,14 @@ void adjustSensitivity(int direction) {
     if (current_sensitivity_level < 0) current_sensitivity_level = SENSITIVITY_VERY_HIGH;
     if (current_sensitivity_level > SENSITIVITY_VERY_HIGH) current_sensitivity_level = SENSITIVITY_VERY_LOW;
     
+    #if AUTO_CALIBRATION_ENABLED
+    clearCalibration(); // Set by hand from now on
+    #endif
+    
     if (old_sensitivity != current_sensitivity_level) {
         Serial.println("🎚️ Sensitivity: " + String(current_sensitivity_level) + "/4");
         
-        String levels[] = {"Very Low", "Low", "Medium", "High", "Very High"};
-        Serial.println("   Level: " + levels[current_sensitivity_level]);
+        Serial.println("   Level: " + String(SENSITIVITY_LEVEL_NAMES[current_sensitivity_level]));
         
         // Apply new settings immediately for testing
         applySensorSettings();
@@ -338,11 +775,14 @@ void adjustRange(int direction) {
     if (current_range_setting < 0) current_range_setting = RANGE_LONG;
     if (current_range_setting > RANGE_LONG) current_range_setting = RANGE_SHORT;
     
+    #if AUTO_CALIBRATION_ENABLED
+    clearCalibration(); // Set by hand from now on
+    #endif
+    
     if (old_range != current_range_setting) {
         Serial.println("📏 Range: " + String(current_range_setting) + "/2");
         
-        String ranges[] = {"Short", "Medium", "Long"};
-        Serial.println("   Range: " + ranges[current_range_setting]);
+        Serial.println("   Range: " + String(RANGE_SETTING_NAMES[current_range_setting]));
         
         // Apply new settings immediately for testing
         applySensorSettings();
@@ -389,7 +829,7 @@ void testSensorSettings() {
         message += "Sensitivity: " + String(current_sensitivity_level) + "/4\n";
         message += "Range: " + String(current_range_setting) + "/2\n"; 
         message += "Detections in 10s: " + String(detectionCount);
-        sendTelegramNotification(message);
+        sendNotification(message, MESSAGE_CLASS_STATUS);
     }
 }
 
@@ -417,13 +857,15 @@ void loadSensorSettings() {
 void showCurrentSettings() {
     Serial.println("\n📊 Current Sensor Settings:");
     
-    String levels[] = {"Very Low", "Low", "Medium", "High", "Very High"};
-    String ranges[] = {"Short", "Medium", "Long"};
-    
-    Serial.println("   Sensitivity: " + String(current_sensitivity_level) + "/4 (" + levels[current_sensitivity_level] + ")");
-    Serial.println("   Range: " + String(current_range_setting) + "/2 (" + ranges[current_range_setting] + ")");
+    Serial.println("   Sensitivity: " + String(current_sensitivity_level) + "/4 (" + SENSITIVITY_LEVEL_NAMES[current_sensitivity_level] + ")");
+    Serial.println("   Range: " + String(current_range_setting) + "/2 (" + RANGE_SETTING_NAMES[current_range_setting] + ")");
     Serial.println("   Debounce: " + String(getSensorDebounceDelay()) + "ms");
     Serial.println("   Cooldown: " + String(getMotionCooldownPeriod()) + "ms");
+    #if AUTO_CALIBRATION_ENABLED
+    if (sensorCalibrated) {
+        Serial.println("   Auto-calibrated: " + String(calibratedFalseAlarms, 2) + " false alarms/day expected");
+    }
+    #endif
 }
 
 void applySensorSettings() {
@@ -435,6 +877,12 @@ void applySensorSettings() {
 }
 
 unsigned long getSensorDebounceDelay() {
+    #if AUTO_CALIBRATION_ENABLED
+    if (sensorCalibrated) {
+        return calibratedDebounce;
+    }
+    #endif
+    
     // Adjust debounce delay based on sensitivity
     // Higher sensitivity = shorter debounce (more responsive)
     switch(current_sensitivity_level) {
@@ -448,6 +896,12 @@ unsigned long getSensorDebounceDelay() {
 }
 
 unsigned long getMotionCooldownPeriod() {
+    #if AUTO_CALIBRATION_ENABLED
+    if (sensorCalibrated) {
+        return calibratedCooldown;
+    }
+    #endif
+    
     // Adjust cooldown based on range setting
     // Longer range = longer cooldown period
     switch(current_range_setting) {
@@ -458,6 +912,17 @@ unsigned long getMotionCooldownPeriod() {
     }
 }
 
+// Time the pin must stay active before it counts as motion. Only the learned
+// debounce is applied at the pin; the table's values space the alerts instead
+unsigned long getMotionPinDebounce() {
+    #if AUTO_CALIBRATION_ENABLED
+    if (sensorCalibrated) {
+        return calibratedDebounce;
+    }
+    #endif
+    return 0;
+}
+
 void configModeLEDPattern(int pattern_type, int count) {
     static unsigned long lastBlink = 0;
     static bool ledState = false;
@@ -480,6 +945,160 @@ void configModeLEDPattern(int pattern_type, int count) {
     }
 }
 
+#if AUTO_CALIBRATION_ENABLED
+// ===================================================================
+// SENSOR AUTO-CALIBRATION
+// ===================================================================
+
+// `/sensitivity auto` watches the sensor while the area is empty, so every
+// pulse is noise, and picks the cooldown and debounce from the noise model
+// in noise_calibration.h. The alert spacing it assumes is NOTIFICATION_INTERVAL
+// (see shouldSendNotification()).
+
+bool calibrationActive = false;
+unsigned long calibrationStart = 0;
+unsigned long calibrationLength = 0;
+bool calibrationPinActive = false;
+unsigned long calibrationPulseStart = 0;
+unsigned long calibrationLastPulseEnd = 0;
+unsigned long calibrationPulses = 0;
+uint16_t calibrationStored = 0;
+uint32_t calibrationWidths[CALIBRATION_MAX_PULSES];
+uint32_t calibrationGaps[CALIBRATION_MAX_PULSES]; // Quiet time before each pulse (0 for the first)
+Preferences calibrationPrefs;
+
+bool startCalibration(unsigned long length) {
+    if (!sensorStabilized) {
+        return false;
+    }
+    
+    calibrationActive = true;
+    calibrationStart = millis();
+    calibrationLength = length;
+    calibrationPinActive = isMotionDetected();
+    calibrationPulseStart = calibrationStart;
+    calibrationPulses = 0;
+    calibrationStored = 0;
+    logMessage(2, "Sensor calibration started (" + String(length / 60000) + " min)");
+    return true;
+}
+
+void recordCalibrationPulse(unsigned long end) {
+    if (calibrationStored < CALIBRATION_MAX_PULSES) {
+        calibrationWidths[calibrationStored] = end - calibrationPulseStart;
+        calibrationGaps[calibrationStored] = calibrationPulses ? calibrationPulseStart - calibrationLastPulseEnd : 0;
+        calibrationStored++;
+    }
+    calibrationPulses++;
+    calibrationLastPulseEnd = end;
+}
+
+// Polled from the main loop; pulses are resolved to LOOP_DELAY
+void serviceCalibration() {
+    if (!calibrationActive) {
+        return;
+    }
+    
+    unsigned long currentTime = millis();
+    bool active = isMotionDetected();
+    if (active && !calibrationPinActive) {
+        calibrationPulseStart = currentTime;
+    } else if (!active && calibrationPinActive && calibrationPulseStart != calibrationStart) {
+        recordCalibrationPulse(currentTime); // (A pulse already running at the start is skipped)
+    }
+    calibrationPinActive = active;
+    
+    if (currentTime - calibrationStart >= calibrationLength) {
+        finishCalibration();
+    }
+}
+
+void finishCalibration() {
+    calibrationActive = false;
+    CalibrationFit fit = fitCalibration(calibrationWidths, calibrationGaps, calibrationStored,
+                                        calibrationPulses, calibrationLength);
+    
+    // The pin is polled every LOOP_DELAY, so the debounce moves in those steps
+    CalibrationLimits limits = {CALIBRATION_MIN_COOLDOWN, CALIBRATION_MAX_COOLDOWN, MOTION_COOLDOWN_PERIOD,
+                                CALIBRATION_MAX_DEBOUNCE, LOOP_DELAY, NOTIFICATION_INTERVAL,
+                                CALIBRATION_TARGET_FALSE_ALARMS};
+    CalibrationChoice choice = chooseCalibration(fit, limits);
+    
+    sensorCalibrated = true;
+    calibratedCooldown = (unsigned long)choice.cooldown;
+    calibratedDebounce = (unsigned long)choice.debounce;
+    calibratedFalseAlarms = choice.falseAlarms;
+    saveCalibration();
+    
+    String report = "🎯 *Sensor Calibration Complete*\n";
+    report += "Baseline: " + String(calibrationLength / 60000) + " min, " + String(fit.pulses) + " noise pulses\n";
+    if (fit.pulses > 0) {
+        report += "Pulse width: median " + String(fit.widthMedian, 0) + "ms (spread x" + String(fit.widthSpread, 1) + ")\n";
+    }
+    if (fit.burstShare > 0) {
+        report += "Gaps: " + String(fit.burstShare * 100, 0) + "% in bursts (mean " + String(fit.burstGap / 1000, 1) +
+                  "s), " + String(fit.quietGap / 60000, 1) + " min between bursts\n";
+    } else if (fit.pulses > 0) {
+        report += "Gaps: mean " + String(fit.quietGap / 60000, 1) + " min\n";
+    }
+    report += "Debounce: " + String(calibratedDebounce) + "ms" +
+              (calibratedDebounce > 0 ? " (shorter pulses ignored, alerts wait as long)\n" : "\n");
+    report += "Cooldown: " + String(calibratedCooldown) + "ms\n";
+    if (fit.pulses == 0) {
+        // No pulse seen: 95% upper bound (rule of three)
+        report += "Expected false alarms: under " + String(3 * 24 / fit.hours, 2) + "/day";
+    } else {
+        report += "Expected false alarms: " + String(calibratedFalseAlarms, 2) + "/day";
+        if (calibratedFalseAlarms > CALIBRATION_TARGET_FALSE_ALARMS) {
+            report += " (target " + String(CALIBRATION_TARGET_FALSE_ALARMS, 1) + " not reachable within the " +
+                      String(CALIBRATION_MAX_COOLDOWN / 1000) + "s cooldown and " + String(CALIBRATION_MAX_DEBOUNCE) +
+                      "ms debounce limits, check the sensor)";
+        }
+    }
+    logMessage(2, report);
+    sendNotification(report, MESSAGE_CLASS_STATUS);
+}
+
+void clearCalibration() {
+    calibrationActive = false;
+    if (sensorCalibrated) {
+        sensorCalibrated = false;
+        saveCalibration();
+    }
+}
+
+void saveCalibration() {
+    calibrationPrefs.begin("calibration", false);
+    calibrationPrefs.putBool("active", sensorCalibrated);
+    calibrationPrefs.putULong("pindebounce", calibratedDebounce);
+    calibrationPrefs.putULong("cooldown", calibratedCooldown);
+    calibrationPrefs.putFloat("alarms", calibratedFalseAlarms);
+    calibrationPrefs.end();
+}
+
+void loadCalibration() {
+    calibrationPrefs.begin("calibration", true);
+    sensorCalibrated = calibrationPrefs.getBool("active", false);
+    calibratedDebounce = calibrationPrefs.getULong("pindebounce", 0); // ("debounce" held an alert spacing)
+    calibratedDebounce = min(calibratedDebounce, (unsigned long)CALIBRATION_MAX_DEBOUNCE);
+    calibratedCooldown = calibrationPrefs.getULong("cooldown", MOTION_COOLDOWN_PERIOD);
+    calibratedFalseAlarms = calibrationPrefs.getFloat("alarms", 0);
+    calibrationPrefs.end();
+}
+
+String formatCalibrationStatus() {
+    if (calibrationActive) {
+        return "🎯 Calibrating: " + String((millis() - calibrationStart) / 60000) + "/" +
+               String(calibrationLength / 60000) + " min, " + String(calibrationPulses) + " pulses so far";
+    }
+    if (sensorCalibrated) {
+        return "🎯 Auto-calibrated: " + String(calibratedFalseAlarms, 2) + " false alarms/day expected" +
+               (calibratedDebounce > 0 ? ", pulses under " + String(calibratedDebounce) + "ms ignored" : "");
+    }
+    return "";
+}
+#endif
+
 // ===================================================================
 // ARDUINO SETUP FUNCTION
 // ===================================================================
@@ -490,7 +1109,10 @@ void setup() {
     
     // Initialize Serial communication
     Serial.begin(SERIAL_BAUD_RATE);
-    delay(STARTUP_DELAY);
+    detectBootProfile();
+    if (!fastBoot) {
+        delay(STARTUP_DELAY);
+    }
     
     // Print startup banner
     Serial.println();
@@ -500,11 +1122,21 @@ void setup() {
     Serial.println("Device: " + String(DEVICE_NAME));
     Serial.println("Location: " + String(DEVICE_LOCATION));
     Serial.println("Build Date: " __DATE__ " " __TIME__);
+    Serial.println("Reset: " + String(resetReasonName(resetReason)) + (fastBoot ? " (fast boot)" : ""));
     Serial.println("================================================================");
+    markBootPhase("serial");
     
     // Initialize all subsystems
     initializeSystem();
     
+    bootDuration = millis();
+    #if BOOT_PROFILE_ENABLED
+    printBootProfile();
+    #endif
+    #if EVENT_JOURNAL_ENABLED
+    journalEvent(MOTION_EVENT_BOOT, bootDuration, 0);
+    #endif
+    
     Serial.println("\n🚀 System initialization completed!");
     Serial.println("� Monitoring for motion events...");
     Serial.println("================================================================\n");
@@ -551,13 +1183,20 @@ void initializeSystem() {
         while(1) delay(1000); // Halt system
     }
     
+    // Start associating now; the WiFi task connects while local init runs
+    startWiFiConnection();
+    markBootPhase("wifi start");
+    
     // Initialize hardware
     initializeLED();
     initializeMotionSensor();
     initializeConfigButton();
+    initializeBotCommands();
+    markBootPhase("hardware");
     
-    // Initialize network
+    // Initialize network (waits for the association started above)
     initializeWiFi();
+    markBootPhase("wifi");
     
     // Initialize time
     if (ENABLE_NTP_TIME_SYNC && wifiConnected) {
@@ -568,6 +1207,22 @@ void initializeSystem() {
     if (ENABLE_TELEGRAM_NOTIFICATIONS && wifiConnected) {
         initializeTelegram();
     }
+    initializeEventJournal();
+    #if HISTORY_ENABLED
+    loadHistory();
+    #endif
+    initializeNotifiers();
+    #if CLUSTER_ENABLED
+    initializeCluster();
+    #endif
+    markBootPhase("telegram");
+    
+    #if TLS_BENCHMARK_AT_BOOT
+    if (wifiConnected) {
+        runTlsBenchmark();
+        markBootPhase("tls bench");
+    }
+    #endif
     
     // Initialize watchdog
     #if ENABLE_WATCHDOG
@@ -587,17 +1242,82 @@ void initializeSystem() {
         startupMsg += "📍 " + String(DEVICE_LOCATION) + "\n";
         #endif
         startupMsg += "🌐 IP: " + WiFi.localIP().toString() + "\n";
-        startupMsg += "⚡ Firmware: v" + String(FIRMWARE_VERSION);
-        sendTelegramNotification(startupMsg);
+        startupMsg += "⚡ Firmware: v" + String(FIRMWARE_VERSION) + "\n";
+        startupMsg += "🔁 Reset: " + String(resetReasonName(resetReason));
+        sendNotification(startupMsg, MESSAGE_CLASS_STATUS);
     }
+    markBootPhase("startup msg");
+    
+    // Boot ran at full clock; drop to the idle frequency from here on
+    initializePowerManagement();
     
-    // Start sensor stabilization period
+    // Start sensor stabilization period; a warm reset keeps the PIR powered,
+    // so its earlier warm-up still holds
     sensorStabilizationStart = millis();
+    if (fastBoot) {
+        sensorStabilized = true;
+        logMessage(2, "Warm reset - motion sensor already stabilized");
+    }
     systemInitialized = true;
     
     logMessage(1, "System initialization completed successfully");
 }
 
+// Reads the reset reason and the RTC state to pick the boot profile
+void detectBootProfile() {
+    resetReason = esp_reset_reason();
+    bool warmReset = resetReason == ESP_RST_SW || resetReason == ESP_RST_PANIC ||
+                     resetReason == ESP_RST_INT_WDT || resetReason == ESP_RST_TASK_WDT ||
+                     resetReason == ESP_RST_WDT || resetReason == ESP_RST_EXT;
+    
+    if (!warmReset || rtcBootState.magic != RTC_BOOT_STATE_MAGIC) {
+        rtcBootState.magic = RTC_BOOT_STATE_MAGIC;
+        rtcBootState.bootCount = 0;
+        rtcBootState.sensorStabilized = false;
+    }
+    rtcBootState.bootCount++;
+    
+    #if FAST_BOOT_ENABLED
+    fastBoot = warmReset && rtcBootState.sensorStabilized;
+    #endif
+}
+
+void markBootPhase(const char* name) {
+    if (bootPhaseCount < BOOT_PROFILE_MAX_PHASES) {
+        bootPhases[bootPhaseCount].name = name;
+        bootPhases[bootPhaseCount].finishedAt = millis();
+        bootPhaseCount++;
+    }
+}
+
+void printBootProfile() {
+    Serial.println("⏱️ Boot profile (" + String(fastBoot ? "fast" : "normal") + "):");
+    unsigned long previous = 0;
+    for (int i = 0; i < bootPhaseCount; i++) {
+        char line[64];
+        snprintf(line, sizeof(line), "   %-12s %6lu ms  (+%lu ms)", bootPhases[i].name,
+                 bootPhases[i].finishedAt, bootPhases[i].finishedAt - previous);
+        Serial.println(line);
+        previous = bootPhases[i].finishedAt;
+    }
+    Serial.println("   Total: " + String(bootDuration) + " ms");
+}
+
+const char* resetReasonName(esp_reset_reason_t reason) {
+    switch (reason) {
+        case ESP_RST_POWERON:   return "power-on";
+        case ESP_RST_EXT:       return "external pin";
+        case ESP_RST_SW:        return "software";
+        case ESP_RST_PANIC:     return "panic";
+        case ESP_RST_INT_WDT:   return "interrupt watchdog";
+        case ESP_RST_TASK_WDT:  return "task watchdog";
+        case ESP_RST_WDT:       return "watchdog";
+        case ESP_RST_DEEPSLEEP: return "deep sleep";
+        case ESP_RST_BROWNOUT:  return "brownout";
+        default:                return "unknown";
+    }
+}
+
 void systemLoop() {
     unsigned long currentTime = millis();
     
@@ -609,6 +1329,7 @@ void systemLoop() {
     // Check if sensor stabilization period is complete
     if (!sensorStabilized && (currentTime - sensorStabilizationStart) >= SENSOR_STABILIZATION_TIME) {
         sensorStabilized = true;
+        rtcBootState.sensorStabilized = true;
         logMessage(2, "Motion sensor stabilization completed");
         blinkLED(2, LED_BLINK_FAST);
     }
@@ -641,7 +1362,48 @@ void systemLoop() {
         handleMotionDetection();
     }
     
+    // Collect the noise baseline of a running calibration
+    #if AUTO_CALIBRATION_ENABLED
+    serviceCalibration();
+    #endif
+    
+    // Bot API writes (queued messages, fan-out retries, live session edits)
+    // run on the sender task; this is the fallback if it could not start
+    if (telegramSendTaskHandle == nullptr) {
+        serviceTelegramSender();
+    }
+    
+    // Keep the MQTT broker connection up and deliver queued events
+    #if MQTT_ENABLED
+    serviceMqtt();
+    #endif
+    
+    // Exchange motion reports with the other detectors on the LAN
+    #if CLUSTER_ENABLED
+    serviceCluster();
+    #endif
+    
+    // Refresh the cached Bot API address before its TTL runs out
+    #if DNS_CACHE_ENABLED
+    serviceDnsCache();
+    #endif
+    
+    // Send the motion digest when due
+    #if DIGEST_MODE_ENABLED
+    serviceMotionDigest();
+    #endif
+    
+    // Save the motion history rollups when due
+    #if HISTORY_ENABLED
+    serviceHistory();
+    #endif
+    
     // Handle Telegram bot commands
+    #if TELEGRAM_LONG_POLL_ENABLED || TELEGRAM_WEBHOOK_ENABLED
+    if (ENABLE_BOT_COMMANDS) {
+        drainTelegramCommandQueue();
+    }
+    #else
     if (wifiConnected && ENABLE_BOT_COMMANDS && (currentTime - lastTimeBotRan) >= BOT_MTBS) {
         #if ENABLE_WATCHDOG
         esp_task_wdt_reset(); // Reset before potentially long operation
@@ -652,11 +1414,12 @@ void systemLoop() {
         esp_task_wdt_reset(); // Reset after potentially long operation
         #endif
     }
+    #endif
     
     // Send heartbeat message
     if (HEARTBEAT_MESSAGE_ENABLED && wifiConnected && 
         (currentTime - lastHeartbeat) >= HEARTBEAT_INTERVAL) {
-        sendTelegramNotification("💓 System heartbeat - " + getUptimeString());
+        sendNotification("💓 System heartbeat - " + getUptimeString(), MESSAGE_CLASS_STATUS);
         lastHeartbeat = currentTime;
     }
     
@@ -672,8 +1435,9 @@ void systemLoop() {
     
     // Reset daily counters at midnight
     static int lastDay = -1;
+    struct tm localTime = currentLocalTime();
     if (timeInitialized) {
-        int currentDay = timeClient.getDay();
+        int currentDay = localTime.tm_yday;
         if (currentDay != lastDay && RESET_COUNTER_DAILY) {
             resetDailyCounters();
             lastDay = currentDay;
@@ -695,9 +1459,7 @@ void performSystemChecks() {
 // NETWORK FUNCTIONS
 // ===================================================================
 
-void initializeWiFi() {
-    Serial.println("🌐 Initializing WiFi...");
-    
+void configureWiFi() {
     WiFi.mode(WIFI_STA);
     WiFi.setAutoReconnect(true);
     WiFi.persistent(true);
@@ -720,12 +1482,43 @@ void initializeWiFi() {
         }
     }
     #endif
+}
+
+// Issues WiFi.begin() for the first usable network without waiting for it
+void startWiFiConnection() {
+    Serial.println("🌐 Initializing WiFi...");
+    configureWiFi();
+    
+    #ifdef USE_SECRETS_FILE
+    for (int i = 0; i < WIFI_NETWORK_COUNT; i++) {
+        if (WIFI_NETWORKS[i].enabled && strlen(WIFI_NETWORKS[i].ssid) > 0) {
+            WiFi.begin(WIFI_NETWORKS[i].ssid, WIFI_NETWORKS[i].password);
+            wifiPendingNetwork = i;
+            break;
+        }
+    }
+    #else
+    if (strlen(WIFI_SSID) > 0) {
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+        wifiPendingNetwork = 0;
+    }
+    #endif
+}
+
+void initializeWiFi() {
+    if (wifiPendingNetwork < 0) {
+        Serial.println("🌐 Initializing WiFi...");
+        configureWiFi();
+    }
     
     // Attempt to connect to WiFi
     wifiConnected = connectToWiFi();
     
     if (wifiConnected) {
         printNetworkInfo();
+        #if DNS_CACHE_ENABLED
+        resolveTelegramHostNow();
+        #endif
     } else {
         handleNetworkFailure();
     }
@@ -770,14 +1563,24 @@ bool tryConnectToNetwork(int networkIndex) {
     
     Serial.println("📡 Connecting to: " + String(ssid));
     
-    WiFi.begin(ssid, password);
+    // Reuse an association started during boot instead of restarting it
+    if (networkIndex != wifiPendingNetwork) {
+        WiFi.begin(ssid, password);
+    }
+    wifiPendingNetwork = -1;
     
+    // Poll often so boot continues as soon as the link is up
     unsigned long startTime = millis();
+    unsigned long lastProgress = startTime;
     while (WiFi.status() != WL_CONNECTED && (millis() - startTime) < WIFI_TIMEOUT) {
-        delay(500);
-        Serial.print(".");
-        blinkLED(1, LED_BLINK_FAST);
+        delay(WIFI_CONNECT_POLL_INTERVAL);
+        if (millis() - lastProgress >= LED_BLINK_SLOW) {
+            Serial.print(".");
+            digitalWrite(LED_PIN, !digitalRead(LED_PIN));
+            lastProgress = millis();
+        }
     }
+    digitalWrite(LED_PIN, LOW);
     
     if (WiFi.status() == WL_CONNECTED) {
         Serial.println("\n✅ WiFi connected successfully!");
@@ -798,7 +1601,10 @@ void checkWiFiConnection() {
         
         if (connectToWiFi()) {
             Serial.println("✅ WiFi reconnected successfully");
-            sendTelegramNotification("🔄 WiFi reconnected - " + WiFi.localIP().toString());
+            #if DNS_CACHE_ENABLED
+            resolveTelegramHostNow(); // The new network may use a different resolver
+            #endif
+            sendNotification("🔄 WiFi reconnected - " + WiFi.localIP().toString(), MESSAGE_CLASS_STATUS);
         } else {
             handleNetworkFailure();
         }
@@ -839,342 +1645,3558 @@ void printNetworkInfo() {
 }
 
 // ===================================================================
-// TELEGRAM FUNCTIONS
+// DNS CACHE
 // ===================================================================
 
-void initializeTelegram() {
-    Serial.println("📱 Initializing Telegram Bot...");
-    
-    // Configure SSL client
-    client.setInsecure(); // For simplicity, not verifying SSL certificate
-    // In production, you should use: client.setCACert(TELEGRAM_CERTIFICATE_ROOT);
-    
-    // Initialize bot
-    #ifdef USE_SECRETS_FILE
-    bot = new UniversalTelegramBot(BOT_TOKEN_SECRET, client);
-    #else
-    bot = new UniversalTelegramBot(BOT_TOKEN, client);
-    #endif
+// The Bot API host is resolved with a plain A query of our own so the
+// record's TTL is known. Connections go to the cached address (the hostname
+// is still sent for SNI), the main loop refreshes the entry before it
+// expires, and the last known address stays in use while the resolver
+// fails.
+
+#if DNS_CACHE_ENABLED
+struct DnsCacheEntry {
+    uint32_t address;                   // 0 = never resolved
+    unsigned long expiresAt;
+    unsigned long refreshAt;
+};
+DnsCacheEntry telegramHostCache = {0, 0, 0};
+WiFiUDP dnsSocket;
+bool dnsQueryInFlight = false;
+uint16_t dnsQueryId = 0;
+unsigned long dnsQuerySentAt = 0;
+
+size_t buildDnsQuery(uint8_t* buffer, size_t size, const char* host, uint16_t id) {
+    if (12 + strlen(host) + 2 + 4 > size) {
+        return 0;
+    }
     
-    if (bot) {
-        Serial.println("✅ Telegram Bot initialized successfully");
-        
-        // Configure HTTP timeout for bot
-        bot->longPoll = 0;  // Disable long polling to prevent timeouts
-        
-        // Test bot connection with a simple API call
-        Serial.println("🤖 Bot initialized with token");
-        logMessage(2, "Telegram bot connection ready");
-    } else {
-        Serial.println("❌ Failed to initialize Telegram Bot");
-        telegramFailureCount++;
+    memset(buffer, 0, 12);
+    buffer[0] = id >> 8;
+    buffer[1] = id & 0xFF;
+    buffer[2] = 0x01;                   // Recursion desired
+    buffer[5] = 1;                      // One question
+    
+    size_t pos = 12;
+    const char* label = host;
+    while (*label) {
+        const char* dot = strchr(label, '.');
+        size_t labelLength = dot ? (size_t)(dot - label) : strlen(label);
+        buffer[pos++] = labelLength;
+        memcpy(buffer + pos, label, labelLength);
+        pos += labelLength;
+        label += labelLength + (dot ? 1 : 0);
     }
+    buffer[pos++] = 0;
+    buffer[pos++] = 0; buffer[pos++] = 1; // QTYPE A
+    buffer[pos++] = 0; buffer[pos++] = 1; // QCLASS IN
+    return pos;
 }
 
-bool sendTelegramMessage(const char* chatId, const String& message) {
-    if (!wifiConnected || !bot || strlen(chatId) == 0) {
-        return false;
+// Returns the offset after a (possibly compressed) name, or 0 if truncated
+size_t skipDnsName(const uint8_t* packet, size_t length, size_t pos) {
+    while (pos < length) {
+        uint8_t label = packet[pos];
+        if (label == 0) return pos + 1;
+        if ((label & 0xC0) == 0xC0) return (pos + 2 <= length) ? pos + 2 : 0;
+        pos += label + 1;
+    }
+    return 0;
+}
+
+// Finds the first A record; the TTL is the lowest along any CNAME chain
+bool parseDnsResponse(const uint8_t* packet, size_t length, uint16_t id, uint32_t& address, uint32_t& ttlSeconds) {
+    if (length < 12 || ((packet[0] << 8) | packet[1]) != id) return false;
+    if ((packet[2] & 0x80) == 0 || (packet[3] & 0x0F) != 0) return false; // Not a response, or an error code
+    
+    int questions = (packet[4] << 8) | packet[5];
+    int answers = (packet[6] << 8) | packet[7];
+    size_t pos = 12;
+    for (int i = 0; i < questions; i++) {
+        pos = skipDnsName(packet, length, pos);
+        if (pos == 0 || pos + 4 > length) return false;
+        pos += 4;
     }
     
-    #if LOG_TELEGRAM_MESSAGES
-    logMessage(3, "Sending Telegram message to " + String(chatId));
-    #endif
-    
-    for (int attempt = 0; attempt < BOT_RETRY_ATTEMPTS; attempt++) {
-        #if MONITOR_NETWORK_PERFORMANCE
-        unsigned long startTime = millis();
-        #endif
+    uint32_t lowestTtl = 0xFFFFFFFFu;
+    for (int i = 0; i < answers; i++) {
+        pos = skipDnsName(packet, length, pos);
+        if (pos == 0 || pos + 10 > length) return false;
+        uint16_t type = (packet[pos] << 8) | packet[pos + 1];
+        uint32_t ttl = ((uint32_t)packet[pos + 4] << 24) | ((uint32_t)packet[pos + 5] << 16) |
+                       ((uint32_t)packet[pos + 6] << 8) | packet[pos + 7];
+        uint16_t dataLength = (packet[pos + 8] << 8) | packet[pos + 9];
+        pos += 10;
+        if (pos + dataLength > length) return false;
+        if (ttl < lowestTtl) lowestTtl = ttl;
         
-        // Reset watchdog before potentially blocking HTTP call
-        #if ENABLE_WATCHDOG
-        esp_task_wdt_reset();
-        #endif
-        
-        bool result = bot->sendMessage(String(chatId), message, MESSAGE_PARSE_MODE);
-        
-        // Reset watchdog after HTTP call
-        #if ENABLE_WATCHDOG
-        esp_task_wdt_reset();
-        #endif
-        
-        #if MONITOR_NETWORK_PERFORMANCE
-        unsigned long duration = millis() - startTime;
-        if (duration > HTTP_TIMEOUT / 2) {
-            logMessage(2, "Slow Telegram response: " + String(duration) + "ms");
-        }
-        #endif
-        
-        if (result) {
-            telegramFailureCount = 0;
+        if (type == 1 && dataLength == 4) {
+            // IPAddress keeps the octets in network order in memory
+            address = packet[pos] | ((uint32_t)packet[pos + 1] << 8) |
+                      ((uint32_t)packet[pos + 2] << 16) | ((uint32_t)packet[pos + 3] << 24);
+            ttlSeconds = lowestTtl;
             return true;
-        } else {
-            telegramFailureCount++;
-            logMessage(2, "Telegram send attempt " + String(attempt + 1) + " failed");
-            
-            if (attempt < BOT_RETRY_ATTEMPTS - 1) {
-                delay(BOT_RETRY_DELAY);
-            }
         }
+        pos += dataLength;
     }
-    
-    logMessage(1, "Failed to send Telegram message after " + String(BOT_RETRY_ATTEMPTS) + " attempts");
     return false;
 }
 
-void sendTelegramNotification(const String& message) {
-    if (!ENABLE_TELEGRAM_NOTIFICATIONS || !wifiConnected) {
-        return;
+bool sendDnsQuery() {
+    IPAddress server = WiFi.dnsIP();
+    if ((uint32_t)server == 0) {
+        return false;
     }
     
-    String finalMessage = message;
-    
-    // Add timestamp if enabled
-    #if ENABLE_TIMESTAMP_IN_MESSAGES
-    if (timeInitialized) {
-        finalMessage = "🕐 " + getCurrentTimeString() + "\n" + finalMessage;
-    } else {
-        finalMessage = "⏱️ " + String(millis() / 1000) + "s | " + finalMessage;
+    // Discard answers to an earlier query that arrived after its timeout
+    while (dnsSocket.parsePacket() > 0) {
+        dnsSocket.flush();
     }
-    #endif
     
-    // Add device info if enabled
-    #if ENABLE_DEVICE_INFO_IN_MESSAGES
-    finalMessage += "\n📱 " + String(DEVICE_NAME);
-    #endif
+    uint8_t query[64];
+    dnsQueryId = (uint16_t)esp_random();
+    size_t length = buildDnsQuery(query, sizeof(query), TELEGRAM_API_HOST, dnsQueryId);
+    if (length == 0 || !dnsSocket.beginPacket(server, 53)) {
+        return false;
+    }
+    dnsSocket.write(query, length);
+    if (!dnsSocket.endPacket()) {
+        return false;
+    }
     
-    #ifdef USE_SECRETS_FILE
-    // Send to multiple chats based on configuration
-    bool sentToAny = false;
-    for (int i = 0; i < TELEGRAM_CHAT_COUNT; i++) {
-        if (TELEGRAM_CHATS[i].enabled && TELEGRAM_CHATS[i].motion_alerts) {
-            if (sendTelegramMessage(TELEGRAM_CHATS[i].chat_id, finalMessage)) {
-                sentToAny = true;
-                logMessage(3, "Notification sent to " + String(TELEGRAM_CHATS[i].name));
-            }
+    dnsQueryInFlight = true;
+    dnsQuerySentAt = millis();
+    dnsQueries++;
+    return true;
+}
+
+// Returns 1 once the cache was updated, 0 while waiting, -1 on timeout
+int pollDnsResponse() {
+    if (dnsSocket.parsePacket() > 0) {
+        uint8_t packet[512];
+        int length = dnsSocket.read(packet, sizeof(packet));
+        uint32_t address, ttlSeconds;
+        if (length > 0 && parseDnsResponse(packet, length, dnsQueryId, address, ttlSeconds)) {
+            unsigned long now = millis();
+            unsigned long ttl = constrain(ttlSeconds, (uint32_t)DNS_MIN_TTL, (uint32_t)DNS_MAX_TTL) * 1000UL;
+            telegramHostCache.address = address;
+            telegramHostCache.expiresAt = now + ttl;
+            telegramHostCache.refreshAt = now + ttl / 100 * DNS_REFRESH_PERCENT;
+            
+            dnsQueryInFlight = false;
+            lastResolveMillis = now - dnsQuerySentAt;
+            if (lastResolveMillis > maxResolveMillis) maxResolveMillis = lastResolveMillis;
+            return 1;
         }
     }
     
-    if (sentToAny) {
-        Serial.println("✅ Notification sent successfully");
-    } else {
-        Serial.println("❌ Failed to send notification to any chat");
+    if (millis() - dnsQuerySentAt >= DNS_QUERY_TIMEOUT) {
+        dnsQueryInFlight = false;
+        dnsFailures++;
+        return -1;
     }
-    #else
-    // Single chat mode
-    #ifdef USE_SECRETS_FILE
-    if (sendTelegramMessage(CHAT_ID_SECRET, finalMessage)) {
-    #else
-    if (sendTelegramMessage(CHAT_ID, finalMessage)) {
-    #endif
-        Serial.println("✅ Notification sent successfully");
+    return 0;
+}
+
+// Blocking resolve used at boot and after a reconnect
+void resolveTelegramHostNow() {
+    dnsSocket.stop(); // The interface was (re)started
+    dnsQueryInFlight = false;
+    
+    int result = sendDnsQuery() ? 0 : -1;
+    while (result == 0) {
+        delay(5);
+        result = pollDnsResponse();
+    }
+    
+    if (result > 0) {
+        logMessage(3, String(TELEGRAM_API_HOST) + " resolved to " + IPAddress(telegramHostCache.address).toString() +
+                      " in " + String(lastResolveMillis) + "ms");
     } else {
-        Serial.println("❌ Failed to send notification");
+        telegramHostCache.refreshAt = millis() + DNS_RETRY_INTERVAL;
+        logMessage(2, "Could not resolve " + String(TELEGRAM_API_HOST) +
+                      (telegramHostCache.address ? ", keeping last known address" : ""));
     }
-    #endif
 }
 
-void handleTelegramCommands() {
-    if (!bot || !wifiConnected || !ENABLE_BOT_COMMANDS) {
+void serviceDnsCache() {
+    if (!wifiConnected) {
         return;
     }
     
-    // Reset watchdog before potentially blocking HTTP call
-    #if ENABLE_WATCHDOG
-    esp_task_wdt_reset();
-    #endif
+    if (dnsQueryInFlight) {
+        if (pollDnsResponse() < 0) {
+            telegramHostCache.refreshAt = millis() + DNS_RETRY_INTERVAL;
+        }
+        return;
+    }
     
-    int numNewMessages = bot->getUpdates(bot->last_message_received + 1);
+    if ((long)(millis() - telegramHostCache.refreshAt) >= 0 && !sendDnsQuery()) {
+        telegramHostCache.refreshAt = millis() + DNS_RETRY_INTERVAL;
+    }
+}
+
+// Address to connect to; a stale entry is still returned as the fallback
+bool telegramHostAddress(IPAddress& address) {
+    dnsLookups++;
+    if (telegramHostCache.address == 0) {
+        return false;
+    }
     
-    // Reset watchdog after HTTP call
-    #if ENABLE_WATCHDOG
-    esp_task_wdt_reset();
+    if ((long)(millis() - telegramHostCache.expiresAt) < 0) {
+        dnsHits++;
+    } else {
+        dnsStaleHits++;
+    }
+    address = IPAddress(telegramHostCache.address);
+    return true;
+}
+#endif
+
+// ===================================================================
+// TLS PROFILE
+// ===================================================================
+
+// Bot API connections verify the chain against one pinned root CA,
+// data/certs/ca_cert.pem (embedded by platformio.ini), rather than a bundle.
+// Telegram can renew its certificate under that root without a firmware
+// update; moving to another root needs the file replaced. The ESP32 mbedTLS build already offloads SHA, AES and the RSA/ECC big-number
+// maths to the hardware accelerators, so the verified handshake mostly
+// costs the extra signature checks; runTlsBenchmark() measures it.
+
+// NUL-terminated by board_build.embed_txtfiles
+extern const char telegramCaCert[] asm("_binary_data_certs_ca_cert_pem_start");
+
+void configureTelegramTls(WiFiClientSecure& connection, bool verified) {
+    if (verified) {
+        connection.setCACert(telegramCaCert);
+    } else {
+        connection.setInsecure();
+    }
+    connection.setHandshakeTimeout(TLS_HANDSHAKE_TIMEOUT);
+}
+
+// Opens a TLS connection to the Bot API, skipping the lwIP lookup when the
+// address is cached
+bool openTelegramConnection(WiFiClientSecure& connection, bool verified) {
+    bool connected;
+    #if DNS_CACHE_ENABLED
+    IPAddress address;
+    if (telegramHostAddress(address)) {
+        // The CA has to be passed again: this overload ignores setCACert()
+        connected = connection.connect(address, 443, TELEGRAM_API_HOST,
+                                       verified ? telegramCaCert : nullptr, nullptr, nullptr);
+    } else
     #endif
+    {
+        connected = connection.connect(TELEGRAM_API_HOST, 443);
+    }
+    return connected;
+}
+
+bool connectTelegramClient(WiFiClientSecure& connection) {
+    uint32_t heapBefore = ESP.getFreeHeap();
+    unsigned long start = millis();
+    bool connected = openTelegramConnection(connection, USE_SSL_VERIFICATION);
+    unsigned long elapsed = millis() - start;
+    
+    if (!connected) {
+        tlsHandshakeFailures++;
+        char error[96];
+        if (connection.lastError(error, sizeof(error)) != 0) {
+            logMessage(1, "TLS connect failed: " + String(error));
+        }
+        return false;
+    }
     
-    for (int i = 0; i < numNewMessages; i++) {
-        String chatId = String(bot->messages[i].chat_id);
-        String text = bot->messages[i].text;
-        String fromName = bot->messages[i].from_name;
-        
-        #if LOG_TELEGRAM_MESSAGES
-        logMessage(3, "Command from " + fromName + " (" + chatId + "): " + text);
-        #endif
-        
-        // Check authorization if enabled
-        #ifdef USE_SECRETS_FILE
-        bool authorized = false;
-        for (int j = 0; j < AUTHORIZED_USER_COUNT; j++) {
-            if (chatId == String(AUTHORIZED_USERS[j]) && strlen(AUTHORIZED_USERS[j]) > 0) {
-                authorized = true;
-                break;
-            }
+    tlsHandshakes++;
+    tlsTotalHandshakeMillis += elapsed;
+    tlsLastHandshakeMillis = elapsed;
+    if (elapsed > tlsMaxHandshakeMillis) tlsMaxHandshakeMillis = elapsed;
+    tlsLastHeapBytes = (long)heapBefore - (long)ESP.getFreeHeap();
+    return true;
+}
+
+#if TLS_BENCHMARK_AT_BOOT
+// Handshakes TLS_BENCHMARK_ROUNDS times per profile and prints time and heap
+void runTlsBenchmark() {
+    struct BenchmarkProfile {
+        const char* name;
+        bool verified;
+    };
+    static const BenchmarkProfile profiles[] = {
+        {"insecure", false},
+        {"CA verified", true}
+    };
+    
+    Serial.println("🔐 TLS handshake benchmark (" + String(TLS_BENCHMARK_ROUNDS) + " rounds):");
+    for (const BenchmarkProfile& profile : profiles) {
+        unsigned long total = 0;
+        unsigned long fastest = 0xFFFFFFFFUL;
+        unsigned long slowest = 0;
+        long heapPeak = 0;
+        int succeeded = 0;
+        for (int round = 0; round < TLS_BENCHMARK_ROUNDS; round++) {
+            #if ENABLE_WATCHDOG
+            esp_task_wdt_reset();
+            #endif
+            
+            WiFiClientSecure probe;
+            configureTelegramTls(probe, profile.verified);
+            uint32_t heapBefore = ESP.getFreeHeap();
+            unsigned long start = millis();
+            bool connected = openTelegramConnection(probe, profile.verified);
+            unsigned long elapsed = millis() - start;
+            long heapUsed = (long)heapBefore - (long)ESP.getFreeHeap();
+            probe.stop();
+            
+            if (!connected) continue;
+            succeeded++;
+            total += elapsed;
+            if (elapsed < fastest) fastest = elapsed;
+            if (elapsed > slowest) slowest = elapsed;
+            if (heapUsed > heapPeak) heapPeak = heapUsed;
         }
         
-        if (strlen(AUTHORIZED_USERS[0]) > 0 && !authorized) {
-            bot->sendMessage(chatId, "❌ Unauthorized access denied", "");
-            logMessage(2, "Unauthorized command attempt from " + fromName);
+        char line[96];
+        if (succeeded > 0) {
+            snprintf(line, sizeof(line), "   %-12s avg %4lu ms  min %4lu  max %4lu  heap %6ld B  (%d/%d ok)",
+                     profile.name, total / succeeded, fastest, slowest, heapPeak, succeeded, TLS_BENCHMARK_ROUNDS);
+        } else {
+            snprintf(line, sizeof(line), "   %-12s failed", profile.name);
+        }
+        Serial.println(line);
+    }
+}
+#endif
+
+// ===================================================================
+// EVENT JOURNAL
+// ===================================================================
+
+// Motion events are recorded in the binary format of motion_event.h (a few
+// bytes per event) into a ring of EVENT_JOURNAL_BLOCKS blocks. A full block
+// is sealed and saved to flash, overwriting the oldest one; the ring is
+// restored at boot so the journal spans restarts. The open block is lost
+// on power loss. The UDP sink reuses the same header for its binary mode.
+
+uint32_t eventBootId = 0;               // Random per boot; tells a restart from a replay
+
+void fillEventHeader(MotionEventHeader& header, uint32_t firstSeq) {
+    header.deviceId = (uint32_t)(ESP.getEfuseMac() >> 16);
+    header.boot = eventBootId;
+    header.firstSeq = firstSeq;
+    header.baseUptime = millis();
+    header.wallClock = timeInitialized ? (uint32_t)time(nullptr) : 0;
+    strlcpy(header.name, DEVICE_LOCATION, sizeof(header.name)); // Readable label; deviceId identifies the unit
+}
+
+#if EVENT_JOURNAL_ENABLED
+uint8_t journalBlocks[EVENT_JOURNAL_BLOCKS][EVENT_JOURNAL_BLOCK_SIZE];
+size_t journalBlockLength[EVENT_JOURNAL_BLOCKS];
+int journalCurrent = 0;                 // Block being written
+MotionEventWriter journalWriter;
+Preferences journalPrefs;
+uint32_t journalSeq = 0;
+unsigned long journalRecords = 0;
+unsigned long journalBlocksSealed = 0;
+
+void startJournalBlock() {
+    MotionEventHeader header;
+    fillEventHeader(header, journalSeq);
+    journalWriter.attach(journalBlocks[journalCurrent], EVENT_JOURNAL_BLOCK_SIZE);
+    journalWriter.begin(header);
+    journalBlockLength[journalCurrent] = journalWriter.size();
+}
+
+void sealJournalBlock() {
+    char key[8];
+    snprintf(key, sizeof(key), "b%d", journalCurrent);
+    journalCurrent = (journalCurrent + 1) % EVENT_JOURNAL_BLOCKS;
+    
+    journalPrefs.begin("journal", false);
+    journalPrefs.putBytes(key, journalWriter.data(), journalWriter.size());
+    journalPrefs.putUChar("next", journalCurrent);
+    journalPrefs.end();
+    journalBlocksSealed++;
+    
+    startJournalBlock();
+}
+
+void journalEvent(uint8_t type, uint32_t duration, uint8_t flags) {
+    MotionEventRecord record = {};
+    record.type = type;
+    record.zone = EVENT_ZONE;
+    record.flags = flags;
+    record.uptime = millis();
+    record.duration = duration;
+    
+    if (!journalWriter.append(record)) {
+        sealJournalBlock();
+        if (!journalWriter.append(record)) {
+            return;
+        }
+    }
+    journalBlockLength[journalCurrent] = journalWriter.size();
+    journalSeq++;
+    journalRecords++;
+}
+
+// One "JOURNAL <hex>" line per saved block, oldest first (printed at boot,
+// before the oldest one is reused); host/event_dump --hex decodes them
+void printEventJournal() {
+    for (int n = 0; n < EVENT_JOURNAL_BLOCKS; n++) {
+        int i = (journalCurrent + n) % EVENT_JOURNAL_BLOCKS;
+        if (journalBlockLength[i] == 0) {
             continue;
         }
-        #endif
-        
-        processCommand(chatId, text, fromName);
+        Serial.print("JOURNAL ");
+        for (size_t b = 0; b < journalBlockLength[i]; b++) {
+            Serial.printf("%02x", journalBlocks[i][b]);
+        }
+        Serial.println();
     }
 }
 
-void processCommand(const String& chatId, const String& command, const String& fromName) {
-    String response = "";
+String formatJournalStats() {
+    size_t bytes = 0;
+    for (int i = 0; i < EVENT_JOURNAL_BLOCKS; i++) {
+        bytes += journalBlockLength[i];
+    }
+    return "\nJournal: " + String(journalRecords) + " events since boot, " + String(journalBlocksSealed) +
+           " blocks sealed, " + String(bytes) + "/" + String(EVENT_JOURNAL_BLOCKS * EVENT_JOURNAL_BLOCK_SIZE) + " bytes";
+}
+#endif
+
+void initializeEventJournal() {
+    eventBootId = esp_random() | 1;
+    
+    #if EVENT_JOURNAL_ENABLED
+    journalPrefs.begin("journal", true);
+    journalCurrent = journalPrefs.getUChar("next", 0) % EVENT_JOURNAL_BLOCKS;
+    for (int i = 0; i < EVENT_JOURNAL_BLOCKS; i++) {
+        char key[8];
+        snprintf(key, sizeof(key), "b%d", i);
+        journalBlockLength[i] = journalPrefs.getBytes(key, journalBlocks[i], EVENT_JOURNAL_BLOCK_SIZE);
+    }
+    journalPrefs.end();
     
-    if (command == "/status" || command.startsWith("/status@")) {
-        response = "📊 *System Status*\n";
-        #ifdef USE_SECRETS_FILE
-        response += "📍 " + String(DEVICE_LOCATION_SECRET) + "\n";
-        #else
-        response += "📍 " + String(DEVICE_LOCATION) + "\n";
-        #endif
-        response += "🔋 Uptime: " + getUptimeString() + "\n";
-        response += "💾 Memory: " + String(ESP.getFreeHeap()) + " bytes\n";
-        response += "📶 WiFi: " + String(WiFi.RSSI()) + " dBm";
-        
-        response += "\n🔢 Motion Events: " + String(totalMotionEvents);
-        response += "\n📊 Daily Notifications: " + String(dailyNotificationCount);
-        #ifdef SOC_TEMP_SENSOR_SUPPORTED
-        response += "\n🌡️ CPU Temp: " + String(temperatureRead()) + "°C";
-        #endif
-        
-    } else if (command == "/test" || command.startsWith("/test@")) {
-        response = "🧪 *Test Message*\n";
-        response += "Device: " + String(DEVICE_NAME) + "\n";
-        response += "Location: " + String(DEVICE_LOCATION) + "\n";
-        response += "Time: " + getCurrentTimeString();
-        
-    } else if (command == "/help" || command.startsWith("/help@")) {
-        response = "🤖 *Available Commands:*\n";
-        response += "/status - Show system status\n";
-        response += "/test - Send test message\n";
-        response += "/stats - Show statistics\n";
-        response += "/reset - Reset counters\n";
-        response += "/reboot - Restart device\n";
-        response += "/sensor_config - Enter sensor config mode\n";
-        response += "/sensitivity [0-4] - Set sensor sensitivity\n";
-        response += "/range [0-2] - Set sensor range\n";
-        response += "/test_sensor - Test current sensor settings\n";
-        response += "/show_settings - Show current sensor settings\n";
-        response += "/help - Show this help\n";
-        
-    } else if (command == "/stats" || command.startsWith("/stats@")) {
-        response = "📈 *System Statistics:*\n";
-        response += "Total Motion Events: " + String(totalMotionEvents) + "\n";
-        response += "Daily Notifications: " + String(dailyNotificationCount) + "\n";
-        response += "WiFi Failures: " + String(wifiFailureCount) + "\n";
-        response += "Telegram Failures: " + String(telegramFailureCount) + "\n";
-        response += "Free Memory: " + String(ESP.getFreeHeap()) + " bytes\n";
-        response += "Max Loop Time: " + String(maxLoopTime) + " μs\n";
-        response += "Avg Loop Time: " + String(avgLoopTime) + " μs";
-        
-    } else if (command == "/reset" || command.startsWith("/reset@")) {
-        resetDailyCounters();
-        response = "🔄 *Counters Reset*\nDaily statistics have been reset.";
-        
-    } else if (command == "/reboot" || command.startsWith("/reboot@")) {
-        response = "🔄 *Rebooting System*\nDevice will restart in 5 seconds...";
-        bot->sendMessage(chatId, response, MESSAGE_PARSE_MODE);
-        delay(5000);
-        ESP.restart();
-        
-    } else if (command == "/info" || command.startsWith("/info@")) {
-        response = "ℹ️ *Device Information:*\n";
-        response += "Model: " + String(ESP.getChipModel()) + "\n";
-        response += "Revision: " + String(ESP.getChipRevision()) + "\n";
-        response += "CPU Freq: " + String(ESP.getCpuFreqMHz()) + " MHz\n";
-        response += "Flash: " + String(ESP.getFlashChipSize() / 1024 / 1024) + " MB\n";
-        response += "SDK: " + String(ESP.getSdkVersion()) + "\n";
-        response += "MAC: " + WiFi.macAddress();
-        
-    } else if (command == "/sensor_config" || command.startsWith("/sensor_config@")) {
-        if (!sensor_config_mode_active) {
-            enterSensorConfigMode();
-            response = "🔧 *Sensor Config Mode Activated*\nUse physical button or /sensitivity and /range commands to adjust settings.";
+    #if DEBUG_SERIAL
+    printEventJournal();
+    #endif
+    startJournalBlock();
+    #endif
+}
+
+// ===================================================================
+// NOTIFIER PIPELINE
+// ===================================================================
+
+// sendNotification() hands each event to every enabled sink. Telegram keeps
+// its own main-loop worker (the outbound queue with its rate limits and
+// retries); the webhook, UDP and loopback sinks each run a FreeRTOS task
+// with a private queue and retry policy, so a slow backend only delays its
+// own queue. Telegram is handed the event last, because an alert may be
+// delivered inside its submit(). Latency is measured from the event to a
+// confirmed delivery.
+
+struct NotifierEvent {
+    uint8_t messageClass;
+    unsigned long createdAt;            // micros() when the event was raised
+};
+
+struct NotifierStats {
+    unsigned long queued;
+    unsigned long delivered;
+    unsigned long failed;
+    unsigned long retries;
+    unsigned long dropped;              // Queue full
+    uint64_t totalLatency;              // µs (64-bit: a 32-bit sum wraps after ~72 min of latency)
+    unsigned long maxLatency;
+    unsigned long lastLatency;
+};
+
+class Notifier {
+public:
+    virtual ~Notifier() {}
+    virtual const char* name() const = 0;
+    
+    // Accepts an event without blocking the caller
+    virtual bool submit(const NotifierEvent& event, const String& text) = 0;
+    
+    void recordDelivery(bool delivered, unsigned long latency) {
+        portENTER_CRITICAL(&statsMux_);
+        if (!delivered) {
+            stats_.failed++;
         } else {
-            response = "⚠️ Sensor config mode already active.";
+            stats_.delivered++;
+            stats_.totalLatency += latency;
+            stats_.lastLatency = latency;
+            if (latency > stats_.maxLatency) stats_.maxLatency = latency;
         }
-        
-    } else if (command.startsWith("/sensitivity") && !command.startsWith("/sensitivity@")) {
-        String paramStr = command.substring(12);
-        paramStr.trim();
-        
-        if (paramStr.length() > 0) {
-            int newSensitivity = paramStr.toInt();
-            if (newSensitivity >= SENSITIVITY_VERY_LOW && newSensitivity <= SENSITIVITY_VERY_HIGH) {
-                current_sensitivity_level = newSensitivity;
-                applySensorSettings();
-                saveSensorSettings();
-                
-                String levels[] = {"Very Low", "Low", "Medium", "High", "Very High"};
-                response = "🎚️ *Sensitivity Updated*\n";
-                response += "Level: " + String(newSensitivity) + "/4 (" + levels[newSensitivity] + ")\n";
-                response += "Debounce: " + String(getSensorDebounceDelay()) + "ms";
-            } else {
-                response = "❌ Invalid sensitivity level. Use 0-4.";
+        portEXIT_CRITICAL(&statsMux_);
+    }
+    
+    // Adds `delta` to one counter; the stats are written by the sink's task
+    // and read on the main loop
+    void count(unsigned long NotifierStats::*counter, long delta = 1) {
+        portENTER_CRITICAL(&statsMux_);
+        stats_.*counter += delta;
+        portEXIT_CRITICAL(&statsMux_);
+    }
+    
+    NotifierStats stats() {
+        portENTER_CRITICAL(&statsMux_);
+        NotifierStats copy = stats_;
+        portEXIT_CRITICAL(&statsMux_);
+        return copy;
+    }
+    
+private:
+    NotifierStats stats_ = {};
+    portMUX_TYPE statsMux_ = portMUX_INITIALIZER_UNLOCKED;
+};
+
+// A sink that delivers from its own task: up to `maxAttempts` tries per
+// event with a delay doubling from `retryDelay`
+class WorkerNotifier : public Notifier {
+public:
+    WorkerNotifier(uint8_t maxAttempts, unsigned long retryDelay)
+        : maxAttempts_(maxAttempts), retryDelay_(retryDelay) {}
+    
+    bool start(const char* taskName) {
+        queue_ = xQueueCreate(NOTIFIER_QUEUE_LENGTH, sizeof(QueuedEvent));
+        return queue_ != nullptr &&
+               xTaskCreatePinnedToCore(taskEntry, taskName, NOTIFIER_TASK_STACK, this, 1, nullptr, TELEGRAM_POLL_TASK_CORE) == pdPASS;
+    }
+    
+    bool submit(const NotifierEvent& event, const String& text) override {
+        QueuedEvent queued;
+        queued.event = event;
+        strlcpy(queued.text, text.c_str(), sizeof(queued.text));
+        if (queue_ == nullptr || xQueueSend(queue_, &queued, 0) != pdTRUE) {
+            count(&NotifierStats::dropped);
+            return false;
+        }
+        count(&NotifierStats::queued);
+        return true;
+    }
+    
+protected:
+    virtual bool deliver(const NotifierEvent& event, const char* text) = 0;
+    
+private:
+    struct QueuedEvent {
+        NotifierEvent event;
+        char text[NOTIFIER_TEXT_MAX_LENGTH];
+    };
+    
+    static void taskEntry(void* self) {
+        static_cast<WorkerNotifier*>(self)->run();
+    }
+    
+    void run() {
+        for (;;) {
+            if (xQueueReceive(queue_, &current_, portMAX_DELAY) != pdTRUE) {
+                continue;
             }
-        } else {
-            String levels[] = {"Very Low", "Low", "Medium", "High", "Very High"};
-            response = "🎚️ *Current Sensitivity*\n";
-            response += "Level: " + String(current_sensitivity_level) + "/4 (" + levels[current_sensitivity_level] + ")\n";
-            response += "Use `/sensitivity [0-4]` to change.";
-        }
-        
-    } else if (command.startsWith("/range") && !command.startsWith("/range@")) {
-        String paramStr = command.substring(6);
-        paramStr.trim();
-        
-        if (paramStr.length() > 0) {
-            int newRange = paramStr.toInt();
-            if (newRange >= RANGE_SHORT && newRange <= RANGE_LONG) {
-                current_range_setting = newRange;
-                applySensorSettings();
-                saveSensorSettings();
-                
-                String ranges[] = {"Short", "Medium", "Long"};
-                response = "📏 *Range Updated*\n";
-                response += "Setting: " + String(newRange) + "/2 (" + ranges[newRange] + ")\n";
-                response += "Cooldown: " + String(getMotionCooldownPeriod()) + "ms";
-            } else {
-                response = "❌ Invalid range setting. Use 0-2.";
+            
+            bool delivered = false;
+            for (uint8_t attempt = 0; attempt < maxAttempts_ && !delivered; attempt++) {
+                if (attempt > 0) {
+                    count(&NotifierStats::retries);
+                    vTaskDelay(pdMS_TO_TICKS(retryDelay_ << (attempt - 1)));
+                }
+                delivered = wifiConnected && deliver(current_.event, current_.text);
             }
+            recordDelivery(delivered, micros() - current_.event.createdAt);
+        }
+    }
+    
+    QueueHandle_t queue_ = nullptr;
+    QueuedEvent current_;               // Event being delivered (kept off the task stack)
+    uint8_t maxAttempts_;
+    unsigned long retryDelay_;
+};
+
+// Telegram: formats the message and queues it on the outbound queue; the
+// sender task delivers it and records the delivery
+class TelegramNotifier : public Notifier {
+public:
+    const char* name() const override { return "Telegram"; }
+    
+    bool submit(const NotifierEvent& event, const String& text) override {
+        count(&NotifierStats::queued); // Counted first: the sender task may deliver before the call returns
+        if (!sendTelegramNotification(text, event.messageClass, event.createdAt)) {
+            count(&NotifierStats::queued, -1);
+            return false;
+        }
+        return true;
+    }
+};
+
+const char* messageClassName(uint8_t messageClass) {
+    if (messageClass & MESSAGE_CLASS_MOTION) return "motion";
+    if (messageClass & MESSAGE_CLASS_ERROR) return "error";
+    return "status";
+}
+
+// Fields every JSON event starts with, up to the class value. DEVICE_NAME is
+// usually the same across a fleet; receivers tell devices apart by "id" (the
+// same id as in motion_event.h blocks) and show "location".
+String notifierJsonPrefix(const NotifierEvent& event) {
+    char id[12];
+    snprintf(id, sizeof(id), "%08x", (uint32_t)(ESP.getEfuseMac() >> 16));
+    return "{\"device\":\"" + jsonEscape(DEVICE_NAME) + "\",\"id\":\"" + String(id) + "\",\"location\":\"" +
+           jsonEscape(DEVICE_LOCATION) + "\",\"class\":\"" + messageClassName(event.messageClass);
+}
+
+// Generic HTTP webhook: POSTs {"device","id","location","class","text","uptime"}
+// as JSON and treats any 2xx answer as delivered
+class WebhookNotifier : public WorkerNotifier {
+public:
+    WebhookNotifier() : WorkerNotifier(NOTIFIER_MAX_ATTEMPTS, NOTIFIER_RETRY_DELAY) {}
+    const char* name() const override { return "Webhook"; }
+    
+protected:
+    bool deliver(const NotifierEvent& event, const char* text) override {
+        String body = notifierJsonPrefix(event) + "\",\"text\":\"" + jsonEscape(text) +
+                      "\",\"uptime\":" + String(millis() / 1000) + "}";
+        
+        HTTPClient http;
+        http.setConnectTimeout(HTTP_TIMEOUT);
+        http.setTimeout(HTTP_TIMEOUT);
+        if (!http.begin(NOTIFY_WEBHOOK_URL)) {
+            return false;
+        }
+        http.addHeader("Content-Type", "application/json");
+        int status = http.POST(body);
+        http.end();
+        return status >= 200 && status < 300;
+    }
+};
+
+// UDP datagram with the same JSON body plus a boot id and sequence number,
+// or a binary event block with NOTIFY_UDP_BINARY.
+// There is no acknowledgement to retry on; instead each event can be sent
+// NOTIFY_UDP_REPEAT times and the receiver (host/event_relay.cpp) drops
+// the copies. With NOTIFY_UDP_KEY set, each datagram ends in a SipHash MAC
+// (cluster_protocol.h) that the relay checks.
+class UdpNotifier : public WorkerNotifier {
+public:
+    UdpNotifier() : WorkerNotifier(1, 0), key_(clusterDeriveKey(NOTIFY_UDP_KEY)) {}
+    const char* name() const override { return "UDP"; }
+    
+protected:
+    bool deliver(const NotifierEvent& event, const char* text) override {
+        #if NOTIFY_UDP_BINARY
+        // One-record block in the motion_event.h format
+        uint8_t body[NOTIFIER_TEXT_MAX_LENGTH + 64];
+        MotionEventHeader header;
+        fillEventHeader(header, ++seq_);
+        MotionEventRecord record = {};
+        record.uptime = header.baseUptime;
+        record.zone = EVENT_ZONE;
+        if (event.messageClass & MESSAGE_CLASS_MOTION) {
+            record.type = MOTION_EVENT_SESSION_START;
+            record.flags = MOTION_FLAG_NOTIFIED;
         } else {
-            String ranges[] = {"Short", "Medium", "Long"};
-            response = "📏 *Current Range*\n";
-            response += "Setting: " + String(current_range_setting) + "/2 (" + ranges[current_range_setting] + ")\n";
-            response += "Use `/range [0-2]` to change.";
+            record.type = (event.messageClass & MESSAGE_CLASS_ERROR) ? MOTION_EVENT_ERROR : MOTION_EVENT_STATUS;
+        }
+        if (strcmp(text, ".") != 0) {
+            record.text = text;             // Motion alerts carry no text unless it is a digest
+            record.textLength = strlen(text);
         }
+        MotionEventWriter writer(body, sizeof(body));
+        writer.begin(header);
+        writer.append(record);
+        size_t length = writer.size();
+        #else
+        String json = notifierJsonPrefix(event) + "\",\"text\":\"" + jsonEscape(text) +
+                      "\",\"boot\":" + String(eventBootId) + ",\"seq\":" + String(++seq_) + "}";
+        const uint8_t* body = (const uint8_t*)json.c_str();
+        size_t length = json.length();
+        #endif
         
-    } else if (command == "/test_sensor" || command.startsWith("/test_sensor@")) {
-        response = "🧪 *Starting Sensor Test*\nMove in front of sensor for 10 seconds...";
-        bot->sendMessage(chatId, response, MESSAGE_PARSE_MODE);
+        uint8_t mac[CLUSTER_MAC_SIZE];
+        bool sign = strlen(NOTIFY_UDP_KEY) > 0;
+        if (sign) {
+            clusterPutMac(key_, body, length, mac);
+        }
         
-        // Run the sensor test
-        testSensorSettings();
-        return; // Test function sends its own results
+        bool sent = false;
+        for (int copy = 0; copy < NOTIFY_UDP_REPEAT; copy++) {
+            if (socket_.beginPacket(NOTIFY_UDP_HOST, NOTIFY_UDP_PORT)) {
+                socket_.write(body, length);
+                if (sign) {
+                    socket_.write(mac, sizeof(mac));
+                }
+                sent = socket_.endPacket() || sent;
+            }
+        }
+        return sent;
+    }
+    
+private:
+    WiFiUDP socket_;
+    ClusterKey key_;
+    uint32_t seq_ = 0;
+};
+
+// Accepts every event after NOTIFY_LOOPBACK_DELAY ms; its latency is the
+// pipeline's own overhead, for benchmarks and for checking that a slow sink
+// does not hold up the others
+class LoopbackNotifier : public WorkerNotifier {
+public:
+    LoopbackNotifier() : WorkerNotifier(1, 0) {}
+    const char* name() const override { return "Loopback"; }
+    
+protected:
+    bool deliver(const NotifierEvent& event, const char* text) override {
+        if (NOTIFY_LOOPBACK_DELAY > 0) {
+            vTaskDelay(pdMS_TO_TICKS(NOTIFY_LOOPBACK_DELAY));
+        }
+        return true;
+    }
+};
+
+TelegramNotifier telegramNotifier;
+#if NOTIFY_WEBHOOK_ENABLED
+WebhookNotifier webhookNotifier;
+#endif
+#if NOTIFY_UDP_ENABLED
+UdpNotifier udpNotifier;
+#endif
+#if NOTIFY_LOOPBACK_ENABLED
+LoopbackNotifier loopbackNotifier;
+#endif
+
+Notifier* notifiers[4];
+int notifierCount = 0;
+
+void initializeNotifiers() {
+    if (notifierCount > 0) {
+        return;
+    }
+    
+    #if NOTIFY_WEBHOOK_ENABLED
+    if (webhookNotifier.start("notify_http")) {
+        notifiers[notifierCount++] = &webhookNotifier;
+    }
+    #endif
+    #if NOTIFY_UDP_ENABLED
+    if (udpNotifier.start("notify_udp")) {
+        notifiers[notifierCount++] = &udpNotifier;
+    }
+    #endif
+    #if NOTIFY_LOOPBACK_ENABLED
+    if (loopbackNotifier.start("notify_loop")) {
+        notifiers[notifierCount++] = &loopbackNotifier;
+    }
+    #endif
+    if (ENABLE_TELEGRAM_NOTIFICATIONS) {
+        notifiers[notifierCount++] = &telegramNotifier;
+    }
+    
+    logMessage(2, "Notifier pipeline: " + String(notifierCount) + " sink(s)");
+}
+
+void sendNotification(const String& message, uint8_t messageClass) {
+    NotifierEvent event;
+    event.messageClass = messageClass;
+    event.createdAt = micros();
+    
+    for (int i = 0; i < notifierCount; i++) {
+        notifiers[i]->submit(event, message);
+    }
+}
+
+String formatNotifierStats() {
+    String text = "";
+    for (int i = 0; i < notifierCount; i++) {
+        NotifierStats stats = notifiers[i]->stats();
+        text += "\n" + String(notifiers[i]->name()) + ": " + String(stats.delivered) + "/" + String(stats.queued) +
+                " delivered, " + String(stats.failed) + " failed, " + String(stats.retries) + " retries, " +
+                String(stats.dropped) + " dropped";
+        if (stats.delivered > 0) {
+            text += ", latency avg " + String(stats.totalLatency / stats.delivered / 1000.0f, 2) + "ms max " +
+                    String(stats.maxLatency / 1000.0f, 2) + "ms";
+        }
+    }
+    return text;
+}
+
+#if CLUSTER_ENABLED
+// ===================================================================
+// LAN CLUSTER
+// ===================================================================
+
+// Wires the cluster coordinator (cluster_protocol.h) to a multicast socket.
+// A detector that would alert reports the motion instead; the leader's
+// merged alert (or a follower's own one during failover) goes out through
+// the notifier pipeline.
+//
+// The socket and the coordinator are serviced by their own task, so ACKs and
+// heartbeats keep flowing while the main loop is busy (a calibration fit,
+// a command reply). Alerts are handed back to the main loop through a
+// queue. An alert is never dropped: if the queue is full it is merged into
+// one overflow alert the main loop picks up next; only session-end notices,
+// which are just logged, can be lost. clusterMutex guards the coordinator,
+// the socket and the overflow alert.
+
+// An alert with the names resolved while the peers were known
+struct ClusterAlertNote {
+    ClusterAlert alert;
+    char names[CLUSTER_MAX_PEERS + 1][CLUSTER_NAME_LENGTH];
+};
+
+WiFiUDP clusterSocket;
+ClusterCoordinator cluster;
+bool clusterListening = false;
+SemaphoreHandle_t clusterMutex = nullptr;
+QueueHandle_t clusterAlertQueue = nullptr;
+ClusterAlertNote clusterOverflow;       // Alerts the queue had no room for, merged
+bool clusterOverflowPending = false;
+uint32_t reportedLeader = 0;
+Preferences clusterPrefs;
+
+struct ClusterLock {
+    ClusterLock() { xSemaphoreTake(clusterMutex, portMAX_DELAY); }
+    ~ClusterLock() { xSemaphoreGive(clusterMutex); }
+};
+
+void initializeCluster() {
+    if (strlen(CLUSTER_KEY) == 0) {
+        logMessage(1, "Cluster disabled: set CLUSTER_KEY to the passphrase shared by the detectors");
+        return;
+    }
+    
+    // Lowest id leads; by default the last four bytes of the MAC
+    uint32_t nodeId = CLUSTER_NODE_ID ? CLUSTER_NODE_ID : (uint32_t)(ESP.getEfuseMac() >> 16);
+    ClusterTiming timing = {CLUSTER_HEARTBEAT_INTERVAL, CLUSTER_PEER_TIMEOUT, CLUSTER_MERGE_WINDOW,
+                            CLUSTER_ACK_TIMEOUT, CLUSTER_SESSION_COOLDOWN, CLUSTER_MAX_CLOCK_SKEW};
+    
+    // Peers drop packets from an older boot, so the number must survive restarts
+    clusterPrefs.begin("cluster", false);
+    uint32_t boot = clusterPrefs.getULong("boot", 0) + 1;
+    clusterPrefs.putULong("boot", boot);
+    clusterPrefs.end();
+    
+    cluster.begin(nodeId, DEVICE_LOCATION, timing, clusterDeriveKey(CLUSTER_KEY), boot);
+    cluster.setCallbacks(clusterSend, queueClusterAlert, nullptr);
+    reportedLeader = nodeId;
+    
+    clusterMutex = xSemaphoreCreateMutex();
+    clusterAlertQueue = xQueueCreate(CLUSTER_ALERT_QUEUE_LENGTH, sizeof(ClusterAlertNote));
+    if (clusterMutex == nullptr || clusterAlertQueue == nullptr ||
+        xTaskCreatePinnedToCore(clusterTask, "cluster", CLUSTER_TASK_STACK, nullptr, 1, nullptr,
+                                TELEGRAM_POLL_TASK_CORE) != pdPASS) {
+        logMessage(1, "Failed to start cluster task");
+        clusterAlertQueue = nullptr;
+        return;
+    }
+    logMessage(2, "Cluster node " + String(nodeId) + " (boot " + String(boot) + ") on " + String(CLUSTER_MULTICAST_GROUP) + ":" + String(CLUSTER_PORT));
+}
+
+void clusterTask(void* parameter) {
+    uint8_t packet[CLUSTER_PACKET_SIZE];
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(CLUSTER_TASK_INTERVAL));
+        ClusterLock lock;
         
-    } else if (command == "/show_settings" || command.startsWith("/show_settings@")) {
-        String levels[] = {"Very Low", "Low", "Medium", "High", "Very High"};
-        String ranges[] = {"Short", "Medium", "Long"};
+        if (!wifiConnected) {
+            if (clusterListening) {
+                clusterSocket.stop();
+                clusterListening = false;
+            }
+            continue;
+        }
+        if (!clusterListening) {
+            IPAddress group;
+            group.fromString(CLUSTER_MULTICAST_GROUP);
+            clusterListening = clusterSocket.beginMulticast(group, CLUSTER_PORT);
+            if (!clusterListening) {
+                continue;
+            }
+        }
         
-        response = "⚙️ *Current Sensor Settings*\n";
-        response += "🎚️ Sensitivity: " + String(current_sensitivity_level) + "/4 (" + levels[current_sensitivity_level] + ")\n";
-        response += "📏 Range: " + String(current_range_setting) + "/2 (" + ranges[current_range_setting] + ")\n";
-        response += "⏱️ Debounce: " + String(getSensorDebounceDelay()) + "ms\n";
-        response += "🕐 Cooldown: " + String(getMotionCooldownPeriod()) + "ms\n";
+        while (clusterSocket.parsePacket() > 0) {
+            int length = clusterSocket.read(packet, sizeof(packet));
+            if (length > 0) {
+                cluster.receive(packet, length, millis(), clusterWallClock());
+            }
+        }
+        cluster.tick(millis(), clusterWallClock());
+    }
+}
+
+// Main loop: sends the alerts the cluster task raised
+void serviceCluster() {
+    if (clusterAlertQueue == nullptr) {
+        return;
+    }
+    
+    ClusterAlertNote note;
+    while (xQueueReceive(clusterAlertQueue, &note, 0) == pdTRUE) {
+        onClusterAlert(note.alert, &note);
+    }
+    
+    uint32_t leader;
+    bool leading;
+    bool overflow;
+    {
+        ClusterLock lock;
+        leader = cluster.leaderId();
+        leading = cluster.isLeader();
+        overflow = clusterOverflowPending;
+        if (overflow) {
+            note = clusterOverflow;
+            clusterOverflowPending = false;
+        }
+    }
+    if (overflow) {
+        onClusterAlert(note.alert, &note);
+    }
+    if (leader != reportedLeader) {
+        reportedLeader = leader;
+        logMessage(2, "🏢 Cluster leader is now " + String(leader) + (leading ? " (this node)" : ""));
+    }
+}
+
+void clusterReportMotion() {
+    if (clusterAlertQueue == nullptr) {
+        sendNotification(".", MESSAGE_CLASS_MOTION); // No cluster: alert as a lone detector
+        return;
+    }
+    ClusterLock lock;
+    cluster.localMotion(millis(), clusterWallClock());
+}
+
+// Unix time for the replay checks, 0 until NTP has synced
+uint32_t clusterWallClock() {
+    return timeInitialized ? (uint32_t)time(nullptr) : 0;
+}
+
+// Runs with clusterMutex held
+void clusterSend(const uint8_t* data, size_t length, void* context) {
+    if (!clusterListening) {
+        return;
+    }
+    clusterSocket.beginMulticastPacket();
+    clusterSocket.write(data, length);
+    clusterSocket.endPacket();
+}
+
+// Runs with clusterMutex held, on the cluster task or in clusterReportMotion()
+void queueClusterAlert(const ClusterAlert& alert, void* context) {
+    ClusterAlertNote note;
+    note.alert = alert;
+    for (int i = 0; i < alert.nodeCount; i++) {
+        const char* name = cluster.nodeName(alert.nodes[i]);
+        strlcpy(note.names[i], name ? name : "?", CLUSTER_NAME_LENGTH);
+    }
+    if (xQueueSend(clusterAlertQueue, &note, 0) == pdTRUE) {
+        return;
+    }
+    if (alert.sessionEnd) {
+        cluster.noteDropped();
+        return;
+    }
+    if (!clusterOverflowPending) {
+        clusterOverflow = note;
+        clusterOverflowPending = true;
+        return;
+    }
+    
+    // Merge into the alert already waiting
+    ClusterAlert& merged = clusterOverflow.alert;
+    merged.failover = merged.failover && alert.failover;
+    merged.events += alert.events;
+    for (int i = 0; i < alert.nodeCount; i++) {
+        bool known = false;
+        for (int j = 0; j < merged.nodeCount && !known; j++) {
+            known = merged.nodes[j] == alert.nodes[i];
+        }
+        if (!known && merged.nodeCount < CLUSTER_MAX_PEERS + 1) {
+            strlcpy(clusterOverflow.names[merged.nodeCount], note.names[i], CLUSTER_NAME_LENGTH);
+            merged.nodes[merged.nodeCount++] = alert.nodes[i];
+        }
+    }
+}
+
+// `context` is the ClusterAlertNote holding the node names
+void onClusterAlert(const ClusterAlert& alert, void* context) {
+    const ClusterAlertNote* note = static_cast<const ClusterAlertNote*>(context);
+    if (alert.sessionEnd) {
+        logMessage(2, "🏢 Building session ended (" + String(alert.events) + " reports, " +
+                      String(alert.duration / 1000) + "s)");
+        return;
+    }
+    
+    if (alert.nodeCount == 1 && alert.nodes[0] == cluster.nodeId()) {
+        // Only this detector fired: same minimal payload as without a cluster
+        sendNotification(".", MESSAGE_CLASS_MOTION);
+        return;
+    }
+    
+    String message = "🏢 Motion:";
+    for (int i = 0; i < alert.nodeCount; i++) {
+        message += (i > 0 ? ", " : " ") + String(note->names[i]);
+    }
+    if (alert.events > alert.nodeCount) {
+        message += " (" + String(alert.events) + " reports)";
+    }
+    sendNotification(message, MESSAGE_CLASS_MOTION);
+}
+
+String formatClusterStats() {
+    if (clusterAlertQueue == nullptr) {
+        return "\nCluster: not running";
+    }
+    
+    ClusterLock lock;
+    const ClusterStats& stats = cluster.stats();
+    return "\nCluster: leader " + String(cluster.leaderId()) + (cluster.isLeader() ? " (this node)" : "") + ", " +
+           String(cluster.peerCount()) + " peers, " + String(stats.reportsSent) + " reported, " +
+           String(stats.reportsReceived) + " received, " + String(stats.alertsRaised) + " alerts, " +
+           String(stats.eventsMerged) + " merged, " + String(stats.failovers) + " failovers, " +
+           String(stats.buildingSessions) + " building sessions, " + String(stats.rejected) + " rejected, " +
+           String(stats.replayed) + " replayed, " +
+           String(stats.notesDropped) + " session ends dropped";
+}
+#endif
+
+// ===================================================================
+// TELEGRAM FUNCTIONS
+// ===================================================================
+
+void initializeTelegram() {
+    Serial.println("📱 Initializing Telegram Bot...");
+    
+    buildChatRoutes();
+    
+    // Configure SSL client
+    configureTelegramTls(client, USE_SSL_VERIFICATION);
+    
+    // Initialize bot
+    #ifdef USE_SECRETS_FILE
+    bot = new UniversalTelegramBot(BOT_TOKEN_SECRET, client);
+    #else
+    bot = new UniversalTelegramBot(BOT_TOKEN, client);
+    #endif
+    
+    if (bot) {
+        Serial.println("✅ Telegram Bot initialized successfully");
+        
+        // Sends use short requests; getUpdates long polling runs on its own client
+        bot->longPoll = 0;
+        
+        startTelegramSendTask();
+        #if TELEGRAM_PREWARM_ENABLED
+        startPrewarmTask();
+        #endif
+        
+        static bool offsetLoaded = false;
+        if (!offsetLoaded) {
+            loadTelegramUpdateOffset();
+            offsetLoaded = true;
+        }
+        
+        #if TELEGRAM_WEBHOOK_ENABLED
+        if (ENABLE_BOT_COMMANDS) {
+            startWebhookServer();
+        }
+        #elif TELEGRAM_LONG_POLL_ENABLED
+        if (ENABLE_BOT_COMMANDS) {
+            startTelegramPollTask();
+        }
+        #endif
+        
+        // Test bot connection with a simple API call
+        Serial.println("🤖 Bot initialized with token");
+        logMessage(2, "Telegram bot connection ready");
+    } else {
+        Serial.println("❌ Failed to initialize Telegram Bot");
+        telegramFailureCount++;
+    }
+}
+
+bool sendTelegramMessage(const char* chatId, const String& message, long* messageId) {
+    if (!wifiConnected || !bot || strlen(chatId) == 0) {
+        return false;
+    }
+    
+    #if LOG_TELEGRAM_MESSAGES
+    logMessage(3, "Sending Telegram message to " + String(chatId));
+    #endif
+    
+    for (int attempt = 0; attempt < BOT_RETRY_ATTEMPTS; attempt++) {
+        // Wait for the rate limiter, but only briefly - this call holds up the sender task
+        unsigned long wait = rateLimitWait(chatId);
+        if (wait > RATE_MAX_BLOCKING_WAIT) {
+            rateLimitDropped++;
+            logMessage(1, "Rate limited, message to " + String(chatId) + " dropped (wait " + String(wait) + "ms)");
+            return false;
+        }
+        if (wait > 0) {
+            rateLimitDeferred++;
+            delay(wait);
+        }
+        rateLimitConsume(chatId);
+        
+        #if MONITOR_NETWORK_PERFORMANCE
+        unsigned long startTime = millis();
+        #endif
+        
+        // Reset watchdog before potentially blocking HTTP call
+        #if ENABLE_WATCHDOG
+        esp_task_wdt_reset();
+        #endif
+        
+        unsigned long retryAfter = 0;
+        bool result = postTelegramMessage(chatId, message, retryAfter, messageId);
+        
+        // Reset watchdog after HTTP call
+        #if ENABLE_WATCHDOG
+        esp_task_wdt_reset();
+        #endif
+        
+        #if MONITOR_NETWORK_PERFORMANCE
+        unsigned long duration = millis() - startTime;
+        if (duration > HTTP_TIMEOUT / 2) {
+            logMessage(2, "Slow Telegram response: " + String(duration) + "ms");
+        }
+        #endif
+        
+        if (result) {
+            telegramFailureCount = 0;
+            return true;
+        } else {
+            telegramFailureCount++;
+            logMessage(2, "Telegram send attempt " + String(attempt + 1) + " failed");
+            
+            if (retryAfter > 0) {
+                rateLimitRetryAfter(chatId, retryAfter); // Next attempt waits for it (or gives up)
+            } else if (attempt < BOT_RETRY_ATTEMPTS - 1) {
+                delay(BOT_RETRY_DELAY);
+            }
+        }
+    }
+    
+    logMessage(1, "Failed to send Telegram message after " + String(BOT_RETRY_ATTEMPTS) + " attempts");
+    return false;
+}
+
+// Sends one message through the bot's connection. On failure, retryAfter is
+// set from a 429 response (0 for any other error). On success the new
+// message's id is stored in messageId when given.
+bool postTelegramMessage(const char* chatId, const String& message, unsigned long& retryAfter, long* messageId) {
+    TelegramClientLock lock;
+    notePrewarmUse();
+    CpuBoost boost;
+    if (!client.connected()) {
+        connectTelegramClient(client); // Through the DNS cache; the bot connects itself if this fails
+    }
+    DynamicJsonDocument payload(JSON_OBJECT_SIZE(3) + message.length() + 64);
+    payload["chat_id"] = chatId;
+    payload["text"] = message;
+    if (strlen(MESSAGE_PARSE_MODE) > 0) {
+        payload["parse_mode"] = MESSAGE_PARSE_MODE;
+    }
+    
+    String response = bot->sendPostToTelegram("sendMessage", payload.as<JsonObject>());
+    retryAfter = parseRetryAfter(response.c_str());
+    if (messageId) {
+        *messageId = parseMessageId(response.c_str());
+    }
+    return response.indexOf("\"ok\":true") >= 0;
+}
+
+// Extracts result.message_id from a sendMessage response (0 if absent)
+long parseMessageId(const char* body) {
+    const char* field = strstr(body, "\"message_id\":");
+    return field ? atol(field + 13) : 0;
+}
+
+// Precomputes which message classes each configured chat accepts
+void buildChatRoutes() {
+    #ifdef USE_SECRETS_FILE
+    routedMessageClasses = 0;
+    for (int i = 0; i < TELEGRAM_CHAT_COUNT; i++) {
+        const TelegramChat& chat = TELEGRAM_CHATS[i];
+        uint8_t mask = 0;
+        if (chat.enabled && strlen(chat.chat_id) > 0) {
+            if (chat.motion_alerts) mask |= MESSAGE_CLASS_MOTION;
+            if (chat.status_updates) mask |= MESSAGE_CLASS_STATUS;
+            if (chat.error_alerts) mask |= MESSAGE_CLASS_ERROR;
+        }
+        chatRoutes[i] = mask;
+        routedMessageClasses |= mask;
+    }
+    #endif
+}
+
+// Formats and queues a notification; false if no chat will receive it
+bool sendTelegramNotification(const String& message, uint8_t messageClass, unsigned long createdAt) {
+    if (!ENABLE_TELEGRAM_NOTIFICATIONS || !wifiConnected) {
+        return false;
+    }
+    
+    #ifdef USE_SECRETS_FILE
+    if (!(routedMessageClasses & messageClass)) {
+        return false; // No chat takes this class of message
+    }
+    #endif
+    
+    String finalMessage = message;
+    
+    // Add timestamp if enabled
+    #if ENABLE_TIMESTAMP_IN_MESSAGES
+    if (timeInitialized) {
+        finalMessage = "🕐 " + getCurrentTimeString() + "\n" + finalMessage;
+    } else {
+        finalMessage = "⏱️ " + String(millis() / 1000) + "s | " + finalMessage;
+    }
+    #endif
+    
+    // Add device info if enabled
+    #if ENABLE_DEVICE_INFO_IN_MESSAGES
+    finalMessage += "\n📱 " + String(DEVICE_NAME);
+    #endif
+    
+    // The sender task is woken and sends alerts ahead of anything already queued
+    enqueueOutbound(outboundPriorityFor(messageClass), "", messageClass, finalMessage, createdAt);
+    return true;
+}
+
+// Sends a formatted notification to every chat routed for its class.
+// Returns true if at least one chat received it.
+bool deliverTelegramNotification(const String& finalMessage, uint8_t messageClass) {
+    #ifdef USE_SECRETS_FILE
+    // Send to multiple chats based on configuration
+    #if TELEGRAM_FANOUT_ENABLED
+    bool sentToAny = fanOutTelegramNotification(finalMessage, messageClass);
+    #else
+    bool sentToAny = false;
+    for (int i = 0; i < TELEGRAM_CHAT_COUNT; i++) {
+        if (chatRoutes[i] & messageClass) {
+            long messageId = 0;
+            if (sendTelegramMessage(TELEGRAM_CHATS[i].chat_id, finalMessage, &messageId)) {
+                #if LIVE_SESSION_ENABLED
+                if (messageClass & MESSAGE_CLASS_MOTION) recordLiveSessionMessage(TELEGRAM_CHATS[i].chat_id, messageId);
+                #endif
+                sentToAny = true;
+                logMessage(3, "Notification sent to " + String(TELEGRAM_CHATS[i].name));
+            }
+        }
+    }
+    #endif
+    
+    if (sentToAny) {
+        Serial.println("✅ Notification sent successfully");
+    } else {
+        Serial.println("❌ Failed to send notification to any chat");
+    }
+    return sentToAny;
+    #else
+    // Single chat mode
+    #ifdef USE_SECRETS_FILE
+    const char* chatId = CHAT_ID_SECRET;
+    #else
+    const char* chatId = CHAT_ID;
+    #endif
+    long messageId = 0;
+    if (sendTelegramMessage(chatId, finalMessage, &messageId)) {
+        #if LIVE_SESSION_ENABLED
+        if (messageClass & MESSAGE_CLASS_MOTION) recordLiveSessionMessage(chatId, messageId);
+        #endif
+        Serial.println("✅ Notification sent successfully");
+        return true;
+    }
+    Serial.println("❌ Failed to send notification");
+    return false;
+    #endif
+}
+
+void handleTelegramCommands() {
+    if (!bot || !wifiConnected || !ENABLE_BOT_COMMANDS) {
+        return;
+    }
+    
+    // Reset watchdog before potentially blocking HTTP call
+    #if ENABLE_WATCHDOG
+    esp_task_wdt_reset();
+    #endif
+    
+    static TelegramInboundCommand batch[TELEGRAM_UPDATE_BATCH_SIZE];
+    int count;
+    {
+        TelegramClientLock lock;
+        int64_t nextOffset;
+        count = fetchTelegramUpdates(client, 0, batch, TELEGRAM_UPDATE_BATCH_SIZE, nextOffset);
+        if (count >= 0) {
+            commitTelegramUpdateOffset(nextOffset); // Everything fetched runs right below
+        }
+    }
+    
+    // Reset watchdog after HTTP call
+    #if ENABLE_WATCHDOG
+    esp_task_wdt_reset();
+    #endif
+    
+    if (count > 0) {
+        processInboundCommands(batch, count);
+    }
+}
+
+// Loads the next update_id to request. Persisting it means updates that were
+// already fetched (including a queued /reboot) are not executed again after a restart.
+void loadTelegramUpdateOffset() {
+    telegramPrefs.begin("telegram", true);
+    telegramUpdateOffset = telegramPrefs.getLong64("offset", 0);
+    telegramPrefs.end();
+    
+    logMessage(3, "Telegram update offset: " + String((long)telegramUpdateOffset));
+}
+
+void saveTelegramUpdateOffset() {
+    telegramPrefs.begin("telegram", false);
+    telegramPrefs.putLong64("offset", telegramUpdateOffset);
+    telegramPrefs.end();
+}
+
+// Moves the offset past updates that are about to execute. Called before they
+// run, so a /reboot among them is not fetched again after the restart.
+void commitTelegramUpdateOffset(int64_t nextOffset) {
+    if (nextOffset > telegramUpdateOffset) {
+        telegramUpdateOffset = nextOffset;
+        saveTelegramUpdateOffset();
+    }
+}
+
+// Requests up to `capacity` updates in one getUpdates call and copies the
+// commands into `batch`. The response is parsed as it streams off the socket,
+// so no part of it is buffered. `nextOffset` is the offset past every fetched
+// update; the caller commits it (or less) once it knows what will run.
+// Returns the number of commands, or -1 if the request failed.
+int fetchTelegramUpdates(WiFiClientSecure& connection, int timeoutSeconds, TelegramInboundCommand* batch, int capacity,
+                         int64_t& nextOffset) {
+    nextOffset = telegramUpdateOffset;
+    if (!connection.connected()) {
+        CpuBoost boost;
+        if (!connectTelegramClient(connection)) {
+            return -1;
+        }
+    }
+    
+    char query[96];
+    snprintf(query, sizeof(query), "/getUpdates?offset=%lld&limit=%d&timeout=%d",
+             (long long)telegramUpdateOffset, capacity, timeoutSeconds);
+    
+    connection.print("GET /bot");
+    #ifdef USE_SECRETS_FILE
+    connection.print(BOT_TOKEN_SECRET);
+    #else
+    connection.print(BOT_TOKEN);
+    #endif
+    connection.print(query);
+    connection.print(" HTTP/1.1\r\nHost: " TELEGRAM_API_HOST "\r\nConnection: keep-alive\r\n\r\n");
+    telegramPollRequests++;
+    
+    // The server holds the request for up to timeoutSeconds before answering
+    unsigned long deadline = millis() + timeoutSeconds * 1000UL + HTTP_TIMEOUT;
+    
+    int status = 0;
+    long contentLength = -1;
+    if (!readTelegramResponseHead(connection, deadline, status, contentLength)) {
+        connection.stop();
+        return -1;
+    }
+    bool statusOk = (status == 200);
+    
+    // Body: fed to the parser in small chunks straight from the socket. The
+    // long-poll wait above ran at idle clock; decrypting and parsing does not.
+    CpuBoost boost;
+    TelegramUpdateParser parser;
+    parser.begin(TelegramUpdateParser::LAYOUT_UPDATES_RESPONSE, batch, capacity);
+    char chunk[256];
+    long remaining = contentLength;
+    unsigned long parseMicros = 0;
+    while (remaining != 0 && (long)(deadline - millis()) > 0) {
+        size_t wanted = sizeof(chunk);
+        if (remaining > 0 && remaining < (long)wanted) wanted = remaining;
+        
+        int received = connection.read((uint8_t*)chunk, wanted);
+        if (received <= 0) {
+            if (!waitForTelegramData(connection, deadline)) break;
+            continue;
+        }
+        
+        unsigned long parseStart = micros();
+        bool valid = parser.feed(chunk, received);
+        parseMicros += micros() - parseStart;
+        if (!valid) break;
+        if (remaining > 0) remaining -= received;
+    }
+    
+    // A body that was not read to the end leaves the connection unusable
+    if (remaining != 0) {
+        connection.stop();
+    }
+    
+    lastResponseBytes = parser.bytesParsed();
+    if (lastResponseBytes > maxResponseBytes) maxResponseBytes = lastResponseBytes;
+    lastParseMicros = parseMicros;
+    
+    if (!statusOk || !parser.ok()) {
+        logMessage(2, "getUpdates response rejected");
+        return -1;
+    }
+    
+    if (parser.maxUpdateId() >= telegramUpdateOffset) {
+        nextOffset = parser.maxUpdateId() + 1;
+    }
+    
+    unsigned long receivedAt = millis();
+    int count = parser.commandCount();
+    for (int i = 0; i < count; i++) {
+        batch[i].receivedAt = receivedAt;
+    }
+    
+    int updates = parser.updateCount();
+    lastUpdateBatchSize = updates;
+    if (updates > maxUpdateBatchSize) maxUpdateBatchSize = updates;
+    updatesFetched += updates;
+    
+    return count;
+}
+
+// Sleeps until the connection has data, closes or the deadline passes. The
+// sleep doubles up to TELEGRAM_READ_WAIT_MAX while nothing arrives, so a
+// long poll wakes about fifty times a second instead of every millisecond.
+bool waitForTelegramData(WiFiClientSecure& connection, unsigned long deadline) {
+    TickType_t wait = 1;
+    while (connection.available() <= 0) {
+        if (!connection.connected() || (long)(deadline - millis()) <= 0) {
+            return false;
+        }
+        vTaskDelay(wait);
+        wait = min(wait * 2, (TickType_t)pdMS_TO_TICKS(TELEGRAM_READ_WAIT_MAX));
+    }
+    return true;
+}
+
+// Reads the status line and headers of a Bot API response. Returns false if
+// the connection dropped or the deadline passed first.
+bool readTelegramResponseHead(WiFiClientSecure& connection, unsigned long deadline, int& status, long& contentLength) {
+    char line[64];
+    size_t lineLength = 0;
+    bool statusLine = true;
+    status = 0;
+    contentLength = -1;
+    
+    while ((long)(deadline - millis()) > 0) {
+        int c = connection.read();
+        if (c < 0) {
+            if (!waitForTelegramData(connection, deadline)) return false;
+            continue;
+        }
+        if (c != '\n') {
+            if (c != '\r' && lineLength + 1 < sizeof(line)) line[lineLength++] = (char)c;
+            continue;
+        }
+        line[lineLength] = '\0';
+        if (lineLength == 0) {
+            return true;
+        }
+        if (statusLine) {
+            status = (strncmp(line, "HTTP/1.", 7) == 0 && lineLength >= 12) ? atoi(line + 9) : 0;
+            statusLine = false;
+        } else if (strncasecmp(line, "Content-Length:", 15) == 0) {
+            contentLength = atol(line + 15);
+        } else if (timeSource == TIME_SOURCE_NONE && strncasecmp(line, "Date:", 5) == 0) {
+            seedClockFromHttpDate(line + 5);
+        }
+        lineLength = 0;
+    }
+    return false;
+}
+
+// Reads a response body to its end so the next pipelined response can be
+// read. The first keepSize - 1 bytes are kept in `keep` (NUL-terminated).
+bool readResponseBody(WiFiClientSecure& connection, long contentLength, unsigned long deadline,
+                      char* keep, size_t keepSize) {
+    if (contentLength < 0) {
+        return false; // No length - cannot find where the next response starts
+    }
+    
+    size_t kept = 0;
+    uint8_t chunk[128];
+    while (contentLength > 0 && (long)(deadline - millis()) > 0) {
+        int received = connection.read(chunk, contentLength < (long)sizeof(chunk) ? contentLength : sizeof(chunk));
+        if (received <= 0) {
+            if (!waitForTelegramData(connection, deadline)) return false;
+            continue;
+        }
+        if (keep && kept + 1 < keepSize) {
+            size_t copy = min((size_t)received, keepSize - 1 - kept);
+            memcpy(keep + kept, chunk, copy);
+            kept += copy;
+        }
+        contentLength -= received;
+    }
+    
+    if (keep && keepSize > 0) keep[kept] = '\0';
+    return contentLength == 0;
+}
+
+// Executes a batch in one pass. Replies to the same chat are merged and sent
+// once the whole batch has run.
+void processInboundCommands(const TelegramInboundCommand* commands, int count) {
+    unsigned long drainStart = millis();
+    
+    beginCommandReplyBatch();
+    for (int i = 0; i < count; i++) {
+        #if ENABLE_WATCHDOG
+        esp_task_wdt_reset();
+        #endif
+        dispatchTelegramMessage(String(commands[i].chatId), String(commands[i].text), String(commands[i].fromName));
+    }
+    flushCommandReplies();
+    
+    // Command-to-response latency: from getUpdates returning to the reply being queued
+    unsigned long now = millis();
+    for (int i = 0; i < count; i++) {
+        unsigned long latency = now - commands[i].receivedAt;
+        lastCommandLatency = latency;
+        totalCommandLatency += latency;
+        if (latency > maxCommandLatency) maxCommandLatency = latency;
+    }
+    commandsHandled += count;
+    
+    lastDrainCount = count;
+    lastDrainMillis = now - drainStart;
+}
+
+void dispatchTelegramMessage(const String& chatId, const String& text, const String& fromName) {
+    #if LOG_TELEGRAM_MESSAGES
+    logMessage(3, "Command from " + fromName + " (" + chatId + "): " + text);
+    #endif
+    
+    // Check authorization if enabled
+    #ifdef USE_SECRETS_FILE
+    bool authorized = false;
+    for (int j = 0; j < AUTHORIZED_USER_COUNT; j++) {
+        if (chatId == String(AUTHORIZED_USERS[j]) && strlen(AUTHORIZED_USERS[j]) > 0) {
+            authorized = true;
+            break;
+        }
+    }
+    
+    if (strlen(AUTHORIZED_USERS[0]) > 0 && !authorized) {
+        TelegramClientLock lock;
+        bot->sendMessage(chatId, "❌ Unauthorized access denied", "");
+        logMessage(2, "Unauthorized command attempt from " + fromName);
+        return;
+    }
+    #endif
+    
+    processCommand(chatId, text, fromName);
+}
+
+void beginCommandReplyBatch() {
+    pendingReplyCount = 0;
+    replyBatchActive = true;
+}
+
+// Sends a command reply, or merges it into the pending reply for that chat
+// while a batch is being processed.
+void queueCommandReply(const String& chatId, const String& response) {
+    if (!replyBatchActive) {
+        enqueueOutbound(PRIORITY_REPLY, chatId.c_str(), 0, response);
+        return;
+    }
+    
+    for (int i = 0; i < pendingReplyCount; i++) {
+        PendingReply& pending = pendingReplies[i];
+        if (chatId == pending.chatId &&
+            pending.text.length() + response.length() + 2 <= BOT_MAX_MESSAGE_LENGTH) {
+            pending.text += "\n\n";
+            pending.text += response;
+            mergedReplies++;
+            return;
+        }
+    }
+    
+    if (pendingReplyCount >= TELEGRAM_REPLY_SLOTS) {
+        enqueueOutbound(PRIORITY_REPLY, chatId.c_str(), 0, response);
+        return;
+    }
+    
+    PendingReply& pending = pendingReplies[pendingReplyCount++];
+    strlcpy(pending.chatId, chatId.c_str(), sizeof(pending.chatId));
+    pending.text = response;
+}
+
+void flushCommandReplies() {
+    for (int i = 0; i < pendingReplyCount; i++) {
+        enqueueOutbound(PRIORITY_REPLY, pendingReplies[i].chatId, 0, pendingReplies[i].text);
+        pendingReplies[i].text = "";
+    }
+    pendingReplyCount = 0;
+    replyBatchActive = false;
+}
+
+#if TELEGRAM_LONG_POLL_ENABLED || TELEGRAM_WEBHOOK_ENABLED
+// Commands received off the main loop (poll task or webhook server) wait here
+QueueHandle_t telegramCommandQueue = nullptr;
+
+bool initializeTelegramCommandQueue() {
+    if (!telegramCommandQueue) {
+        telegramCommandQueue = xQueueCreate(TELEGRAM_COMMAND_QUEUE_LENGTH, sizeof(TelegramInboundCommand));
+    }
+    return telegramCommandQueue != nullptr;
+}
+
+void drainTelegramCommandQueue() {
+    if (!telegramCommandQueue) {
+        return;
+    }
+    
+    static TelegramInboundCommand batch[TELEGRAM_COMMAND_QUEUE_LENGTH];
+    int count = 0;
+    while (count < TELEGRAM_COMMAND_QUEUE_LENGTH &&
+           xQueueReceive(telegramCommandQueue, &batch[count], 0) == pdTRUE) {
+        count++;
+    }
+    
+    if (count > 0) {
+        processInboundCommands(batch, count);
+    }
+}
+#endif
+
+#if TELEGRAM_LONG_POLL_ENABLED
+WiFiClientSecure pollClient;               // Dedicated keep-alive connection for getUpdates
+TaskHandle_t telegramPollTaskHandle = nullptr;
+
+void startTelegramPollTask() {
+    if (telegramPollTaskHandle != nullptr) {
+        return; // Already running (initializeTelegram() is re-run on failures)
+    }
+    
+    configureTelegramTls(pollClient, USE_SSL_VERIFICATION);
+    
+    if (!initializeTelegramCommandQueue() ||
+        xTaskCreatePinnedToCore(telegramPollTask, "tg_poll", TELEGRAM_POLL_TASK_STACK, nullptr, 1,
+                                &telegramPollTaskHandle, TELEGRAM_POLL_TASK_CORE) != pdPASS) {
+        logMessage(1, "Failed to start Telegram long-poll task");
+        telegramPollTaskHandle = nullptr;
+        return;
+    }
+    
+    logMessage(2, "Telegram long polling started (timeout " + String(TELEGRAM_LONG_POLL_TIMEOUT) + "s)");
+}
+
+void telegramPollTask(void* parameter) {
+    static TelegramInboundCommand batch[TELEGRAM_UPDATE_BATCH_SIZE];
+    
+    for (;;) {
+        if (!wifiConnected) {
+            vTaskDelay(pdMS_TO_TICKS(BOT_MTBS));
+            continue;
+        }
+        
+        // Blocks server-side until an update arrives or the timeout expires
+        int64_t nextOffset;
+        int count = fetchTelegramUpdates(pollClient, TELEGRAM_LONG_POLL_TIMEOUT, batch, TELEGRAM_UPDATE_BATCH_SIZE,
+                                         nextOffset);
+        
+        // Wait for the main loop to make room for the batch. Commands that
+        // still do not fit are left unacknowledged and fetched again.
+        unsigned long waitStart = millis();
+        while (count > 0 && (int)uxQueueSpacesAvailable(telegramCommandQueue) < count &&
+               millis() - waitStart < TELEGRAM_COMMAND_QUEUE_WAIT) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+        int queued = count;
+        if (count > 0 && (int)uxQueueSpacesAvailable(telegramCommandQueue) < count) {
+            queued = uxQueueSpacesAvailable(telegramCommandQueue);
+            nextOffset = batch[queued].updateId;
+            deferredCommands += count - queued;
+        }
+        
+        if (count >= 0) {
+            commitTelegramUpdateOffset(nextOffset);
+        }
+        for (int i = 0; i < queued; i++) {
+            xQueueSend(telegramCommandQueue, &batch[i], 0); // Room was checked above; this task is the only sender
+        }
+        
+        if (count < 0) {
+            vTaskDelay(pdMS_TO_TICKS(BOT_MTBS)); // Request failed - back off before retrying
+        }
+    }
+}
+#endif
+
+#if TELEGRAM_WEBHOOK_ENABLED
+// ===================================================================
+// WEBHOOK RECEIVER
+// ===================================================================
+
+// Telegram (or a LAN reverse proxy terminating TLS) POSTs each update to
+// WEBHOOK_PATH. Updates go through the same queue as long-polled ones.
+httpd_handle_t webhookServer = nullptr;
+volatile unsigned long webhookRequests = 0;
+volatile unsigned long webhookRejected = 0;
+volatile unsigned long webhookDuplicates = 0;
+
+// Secret Telegram must echo with every update: WEBHOOK_SECRET_TOKEN, or one
+// generated at boot when the device registers the webhook itself
+char webhookSecret[65] = "";
+
+// Compares in time that depends only on the expected length, so the secret
+// cannot be guessed a character at a time. `received` must be a buffer of at
+// least strlen(expected) + 1 bytes.
+bool secretEquals(const char* received, const char* expected) {
+    size_t expectedLength = strlen(expected);
+    uint8_t diff = strlen(received) != expectedLength;
+    for (size_t i = 0; i < expectedLength; i++) {
+        diff |= received[i] ^ expected[i];
+    }
+    return diff == 0;
+}
+
+esp_err_t webhookPostHandler(httpd_req_t* req) {
+    webhookRequests++;
+    
+    // Telegram echoes the secret_token given to setWebhook in this header
+    char secret[sizeof(webhookSecret) + 1] = "";
+    httpd_req_get_hdr_value_str(req, "X-Telegram-Bot-Api-Secret-Token", secret, sizeof(secret));
+    if (!secretEquals(secret, webhookSecret)) {
+        webhookRejected++;
+        httpd_resp_set_status(req, "401 Unauthorized");
+        httpd_resp_send(req, nullptr, 0);
+        return ESP_OK;
+    }
+    
+    // Oversized updates are acknowledged and dropped so Telegram does not retry them
+    if (req->content_len == 0 || req->content_len > WEBHOOK_MAX_BODY_SIZE) {
+        webhookRejected++;
+        httpd_resp_send(req, nullptr, 0);
+        return ESP_OK;
+    }
+    
+    // Parse the body as it is received; only the command fields are kept
+    CpuBoost boost;
+    TelegramInboundCommand command;
+    TelegramUpdateParser parser;
+    parser.begin(TelegramUpdateParser::LAYOUT_SINGLE_UPDATE, &command, 1);
+    char chunk[256];
+    size_t received = 0;
+    while (received < req->content_len) {
+        size_t wanted = req->content_len - received;
+        if (wanted > sizeof(chunk)) wanted = sizeof(chunk);
+        
+        int result = httpd_req_recv(req, chunk, wanted);
+        if (result == HTTPD_SOCK_ERR_TIMEOUT) {
+            continue;
+        }
+        if (result <= 0) {
+            return ESP_FAIL;
+        }
+        received += result;
+        parser.feed(chunk, result);
+    }
+    
+    if (!parser.ok() || parser.maxUpdateId() < 0) {
+        webhookRejected++;
+        httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Invalid update");
+        return ESP_OK;
+    }
+    
+    // Telegram redelivers updates it did not see acknowledged - skip those already handled
+    int64_t updateId = parser.maxUpdateId();
+    if (updateId < telegramUpdateOffset) {
+        webhookDuplicates++;
+    } else {
+        unsigned long waitStart = millis();
+        while (parser.commandCount() > 0 && uxQueueSpacesAvailable(telegramCommandQueue) == 0 &&
+               millis() - waitStart < TELEGRAM_COMMAND_QUEUE_WAIT) {
+            vTaskDelay(pdMS_TO_TICKS(20));
+        }
+        if (parser.commandCount() > 0 && uxQueueSpacesAvailable(telegramCommandQueue) == 0) {
+            // Main loop is not draining the queue - let Telegram redeliver the update later
+            deferredCommands++;
+            httpd_resp_set_status(req, "503 Service Unavailable");
+            httpd_resp_send(req, nullptr, 0);
+            return ESP_OK;
+        }
+        
+        commitTelegramUpdateOffset(updateId + 1);
+        updatesFetched++;
+        if (parser.commandCount() > 0) {
+            command.receivedAt = millis();
+            xQueueSend(telegramCommandQueue, &command, 0); // Room was checked above; this handler is the only sender
+        }
+    }
+    
+    httpd_resp_send(req, nullptr, 0);
+    return ESP_OK;
+}
+
+void startWebhookServer() {
+    if (webhookServer != nullptr) {
+        return;
+    }
+    
+    // Never accept unauthenticated updates: without a configured secret the
+    // device can only generate one if it also registers the webhook
+    if (strlen(WEBHOOK_SECRET_TOKEN) > 0) {
+        strncpy(webhookSecret, WEBHOOK_SECRET_TOKEN, sizeof(webhookSecret) - 1);
+    } else if (strlen(WEBHOOK_PUBLIC_URL) > 0) {
+        for (int i = 0; i < 32; i++) {
+            webhookSecret[i] = "0123456789abcdef"[esp_random() & 0x0F];
+        }
+        webhookSecret[32] = '\0';
+    } else {
+        logMessage(1, "Webhook not started: set WEBHOOK_SECRET_TOKEN (or WEBHOOK_PUBLIC_URL to register one)");
+        return;
+    }
+    
+    if (!initializeTelegramCommandQueue()) {
+        logMessage(1, "Failed to create Telegram command queue");
+        return;
+    }
+    
+    httpd_ssl_config_t config = HTTPD_SSL_CONFIG_DEFAULT();
+    config.httpd.max_open_sockets = 2;
+    config.httpd.stack_size = WEBHOOK_TASK_STACK;
+    
+    #if defined(WEBHOOK_SERVER_CERT_PEM) && defined(WEBHOOK_SERVER_KEY_PEM)
+    static const char serverCert[] = WEBHOOK_SERVER_CERT_PEM;
+    static const char serverKey[] = WEBHOOK_SERVER_KEY_PEM;
+    config.cacert_pem = (const uint8_t*)serverCert;
+    config.cacert_len = sizeof(serverCert);
+    config.prvtkey_pem = (const uint8_t*)serverKey;
+    config.prvtkey_len = sizeof(serverKey);
+    config.port_secure = WEBHOOK_PORT;
+    #else
+    // No certificate configured: serve plain HTTP for a TLS-terminating reverse proxy
+    config.transport_mode = HTTPD_SSL_TRANSPORT_INSECURE;
+    config.port_insecure = WEBHOOK_PORT;
+    #endif
+    
+    if (httpd_ssl_start(&webhookServer, &config) != ESP_OK) {
+        logMessage(1, "Failed to start webhook server");
+        webhookServer = nullptr;
+        return;
+    }
+    
+    httpd_uri_t updateUri = {};
+    updateUri.uri = WEBHOOK_PATH;
+    updateUri.method = HTTP_POST;
+    updateUri.handler = webhookPostHandler;
+    httpd_register_uri_handler(webhookServer, &updateUri);
+    
+    logMessage(2, "Webhook server listening on port " + String(WEBHOOK_PORT) + WEBHOOK_PATH);
+    
+    // Point Telegram at the device when a public URL is configured; otherwise
+    // setWebhook is expected to be done by whoever runs the reverse proxy.
+    if (strlen(WEBHOOK_PUBLIC_URL) > 0) {
+        registerTelegramWebhook();
+    }
+}
+
+// Query string value: everything but unreserved characters as %XX
+String percentEncode(const char* text) {
+    static const char hex[] = "0123456789ABCDEF";
+    String encoded;
+    encoded.reserve(strlen(text) * 3);
+    for (const char* p = text; *p; p++) {
+        uint8_t c = *p;
+        if (isalnum(c) || c == '-' || c == '_' || c == '.' || c == '~') {
+            encoded += (char)c;
+        } else {
+            encoded += '%';
+            encoded += hex[c >> 4];
+            encoded += hex[c & 0x0F];
+        }
+    }
+    return encoded;
+}
+
+bool registerTelegramWebhook() {
+    String query = "/setWebhook?url=" + percentEncode(WEBHOOK_PUBLIC_URL) +
+                   "&max_connections=1&allowed_updates=%5B%22message%22%2C%22channel_post%22%5D" +
+                   "&secret_token=" + percentEncode(webhookSecret);
+    
+    TelegramClientLock lock;
+    #ifdef USE_SECRETS_FILE
+    String response = bot->sendGetToTelegram("bot" + String(BOT_TOKEN_SECRET) + query);
+    #else
+    String response = bot->sendGetToTelegram("bot" + String(BOT_TOKEN) + query);
+    #endif
+    
+    bool ok = response.indexOf("\"ok\":true") >= 0;
+    logMessage(ok ? 2 : 1, ok ? "Telegram webhook registered" : "setWebhook failed: " + response);
+    return ok;
+}
+#endif
+
+#if TELEGRAM_FANOUT_ENABLED
+// ===================================================================
+// MULTI-CHAT FAN-OUT
+// ===================================================================
+
+// An alert goes to every target chat as pipelined sendMessage requests on the
+// shared keep-alive connection: all requests are written first, then the
+// responses are read in order. A chat that fails is retried on its own
+// schedule by the sender task, so it never holds up the others.
+
+// Alert text shared by the deliveries queued for it
+struct FanOutMessage {
+    bool active;
+    uint8_t messageClass;
+    String text;                    // JSON-escaped
+    int pending;                    // Deliveries not yet finished
+    int delivered;
+    unsigned long queuedAt;
+    unsigned long firstDeliveredAt;
+    unsigned long lastDeliveredAt;
+};
+
+// One chat waiting for an alert
+struct FanOutDelivery {
+    bool active;
+    int message;                    // Index into fanOutMessages
+    char chatId[24];
+    const char* name;
+    int attempts;
+    unsigned long retryAt;
+};
+
+FanOutMessage fanOutMessages[FANOUT_MESSAGE_SLOTS];
+FanOutDelivery fanOutDeliveries[FANOUT_MAX_DELIVERIES];
+int fanOutPending = 0;
+
+// Fan-out statistics
+unsigned long fanOutAlerts = 0;
+unsigned long fanOutRequests = 0;
+unsigned long fanOutRetries = 0;
+unsigned long fanOutFailures = 0;
+unsigned long lastFirstDeliveryMs = 0;
+unsigned long lastLastDeliveryMs = 0;
+unsigned long maxLastDeliveryMs = 0;
+
+// Queues `message` for every chat routed for its class and sends the first
+// round immediately. Returns true if at least one chat received it.
+bool fanOutTelegramNotification(const String& message, uint8_t messageClass) {
+    int slot = -1;
+    unsigned long oldest = 0;
+    for (int i = 0; i < FANOUT_MESSAGE_SLOTS; i++) {
+        if (!fanOutMessages[i].active) {
+            slot = i;
+            break;
+        }
+        if (slot < 0 || millis() - fanOutMessages[i].queuedAt > oldest) {
+            slot = i;
+            oldest = millis() - fanOutMessages[i].queuedAt;
+        }
+    }
+    
+    // Every slot is still retrying an earlier alert - give up on the oldest
+    if (fanOutMessages[slot].active) {
+        logMessage(1, "Fan-out queue full, abandoning retries of an earlier alert");
+        for (int i = 0; i < FANOUT_MAX_DELIVERIES; i++) {
+            if (fanOutDeliveries[i].active && fanOutDeliveries[i].message == slot) {
+                finishFanOutDelivery(fanOutDeliveries[i], false);
+            }
+        }
+    }
+    
+    FanOutMessage& entry = fanOutMessages[slot];
+    entry.active = true;
+    entry.messageClass = messageClass;
+    entry.text = jsonEscape(message);
+    entry.pending = 0;
+    entry.delivered = 0;
+    entry.queuedAt = millis();
+    
+    #ifdef USE_SECRETS_FILE
+    for (int i = 0; i < TELEGRAM_CHAT_COUNT; i++) {
+        if (!(chatRoutes[i] & messageClass)) {
+            continue;
+        }
+        
+        int freeSlot = -1;
+        for (int j = 0; j < FANOUT_MAX_DELIVERIES && freeSlot < 0; j++) {
+            if (!fanOutDeliveries[j].active) freeSlot = j;
+        }
+        if (freeSlot < 0) {
+            logMessage(1, "Fan-out delivery table full, skipping " + String(TELEGRAM_CHATS[i].name));
+            fanOutFailures++;
+            continue;
+        }
+        
+        FanOutDelivery& delivery = fanOutDeliveries[freeSlot];
+        delivery.active = true;
+        delivery.message = slot;
+        strlcpy(delivery.chatId, TELEGRAM_CHATS[i].chat_id, sizeof(delivery.chatId));
+        delivery.name = TELEGRAM_CHATS[i].name;
+        delivery.attempts = 0;
+        delivery.retryAt = entry.queuedAt;
+        entry.pending++;
+        fanOutPending++;
+    }
+    #endif
+    
+    if (entry.pending == 0) {
+        entry.active = false;
+        entry.text = "";
+        return false;
+    }
+    
+    fanOutAlerts++;
+    int delivered = serviceTelegramFanOut();
+    if (delivered == 0 && entry.pending > 0) {
+        logMessage(2, "Notification not delivered yet, retrying in background");
+    }
+    return delivered > 0;
+}
+
+// Sends every delivery whose retry time has come in one pipelined round.
+// Returns the number delivered in this round.
+int serviceTelegramFanOut() {
+    if (fanOutPending == 0 || !wifiConnected) {
+        return 0;
+    }
+    
+    int due[FANOUT_MAX_DELIVERIES];
+    int dueCount = 0;
+    unsigned long now = millis();
+    for (int i = 0; i < FANOUT_MAX_DELIVERIES; i++) {
+        FanOutDelivery& delivery = fanOutDeliveries[i];
+        if (!delivery.active || (long)(now - delivery.retryAt) < 0) {
+            continue;
+        }
+        
+        // Throttled for too long - the alert is stale by now
+        if (now - fanOutMessages[delivery.message].queuedAt > RATE_MAX_DEFER) {
+            logMessage(1, "Alert to " + String(delivery.name) + " dropped after rate limiting");
+            rateLimitDropped++;
+            finishFanOutDelivery(delivery, false);
+            continue;
+        }
+        
+        unsigned long wait = rateLimitWait(delivery.chatId);
+        if (wait > 0) {
+            delivery.retryAt = now + wait;
+            rateLimitDeferred++;
+            continue;
+        }
+        
+        rateLimitConsume(delivery.chatId);
+        due[dueCount++] = i;
+    }
+    if (dueCount == 0) {
+        return 0;
+    }
+    
+    #if ENABLE_WATCHDOG
+    esp_task_wdt_reset();
+    #endif
+    
+    TelegramClientLock lock;
+    notePrewarmUse();
+    CpuBoost boost;
+    if (!client.connected() && !connectTelegramClient(client)) {
+        for (int i = 0; i < dueCount; i++) {
+            scheduleFanOutRetry(fanOutDeliveries[due[i]]);
+        }
+        return 0;
+    }
+    
+    // Drop anything an earlier request left unread so responses line up
+    while (client.available() > 0) {
+        client.read();
+    }
+    
+    for (int i = 0; i < dueCount; i++) {
+        writeFanOutRequest(fanOutDeliveries[due[i]]);
+    }
+    fanOutRequests += dueCount;
+    
+    int delivered = 0;
+    int answered = 0;
+    unsigned long deadline = millis() + HTTP_TIMEOUT;
+    for (; answered < dueCount; answered++) {
+        FanOutDelivery& delivery = fanOutDeliveries[due[answered]];
+        int status = 0;
+        long contentLength = -1;
+        char responseBody[160];
+        if (!readTelegramResponseHead(client, deadline, status, contentLength) ||
+            !readResponseBody(client, contentLength, deadline, responseBody, sizeof(responseBody))) {
+            break;
+        }
+        
+        if (status == 200) {
+            #if LIVE_SESSION_ENABLED
+            if (fanOutMessages[delivery.message].messageClass & MESSAGE_CLASS_MOTION) {
+                recordLiveSessionMessage(delivery.chatId, parseMessageId(responseBody));
+            }
+            #endif
+            finishFanOutDelivery(delivery, true);
+            delivered++;
+        } else if (status == 429) {
+            // Flood control: wait as long as the server asks, without using up an attempt
+            unsigned long retryAfter = max(1UL, parseRetryAfter(responseBody));
+            rateLimitRetryAfter(delivery.chatId, retryAfter);
+            delivery.retryAt = millis() + retryAfter * 1000UL;
+            fanOutRetries++;
+        } else if (status >= 400 && status < 500 && status != 429) {
+            // Bad chat id, bot blocked, malformed Markdown... retrying will not help
+            logMessage(1, "Telegram rejected alert for " + String(delivery.name) + " (HTTP " + String(status) + ")");
+            finishFanOutDelivery(delivery, false);
+        } else {
+            scheduleFanOutRetry(delivery);
+        }
+    }
+    
+    // The connection failed part-way; the unanswered chats go again on a new one
+    if (answered < dueCount) {
+        client.stop();
+        for (int i = answered; i < dueCount; i++) {
+            scheduleFanOutRetry(fanOutDeliveries[due[i]]);
+        }
+    }
+    
+    #if ENABLE_WATCHDOG
+    esp_task_wdt_reset();
+    #endif
+    
+    return delivered;
+}
+
+void writeFanOutRequest(const FanOutDelivery& delivery) {
+    String body = "{\"chat_id\":\"" + String(delivery.chatId) + "\",";
+    if (strlen(MESSAGE_PARSE_MODE) > 0) {
+        body += "\"parse_mode\":\"" + String(MESSAGE_PARSE_MODE) + "\",";
+    }
+    body += "\"text\":\"" + fanOutMessages[delivery.message].text + "\"}";
+    
+    client.print("POST /bot");
+    #ifdef USE_SECRETS_FILE
+    client.print(BOT_TOKEN_SECRET);
+    #else
+    client.print(BOT_TOKEN);
+    #endif
+    client.print("/sendMessage HTTP/1.1\r\nHost: " TELEGRAM_API_HOST "\r\n"
+                 "Content-Type: application/json\r\nConnection: keep-alive\r\nContent-Length: ");
+    client.print(body.length());
+    client.print("\r\n\r\n");
+    client.print(body);
+}
+
+void scheduleFanOutRetry(FanOutDelivery& delivery) {
+    delivery.attempts++;
+    if (delivery.attempts >= BOT_RETRY_ATTEMPTS) {
+        logMessage(1, "Failed to send alert to " + String(delivery.name) + " after " +
+                   String(BOT_RETRY_ATTEMPTS) + " attempts");
+        finishFanOutDelivery(delivery, false);
+        return;
+    }
+    
+    delivery.retryAt = millis() + (unsigned long)BOT_RETRY_DELAY * delivery.attempts;
+    fanOutRetries++;
+    telegramFailureCount++;
+}
+
+void finishFanOutDelivery(FanOutDelivery& delivery, bool delivered) {
+    FanOutMessage& message = fanOutMessages[delivery.message];
+    unsigned long now = millis();
+    
+    if (delivered) {
+        if (message.delivered == 0) message.firstDeliveredAt = now;
+        message.lastDeliveredAt = now;
+        message.delivered++;
+        telegramFailureCount = 0;
+        logMessage(3, "Notification sent to " + String(delivery.name));
+    } else {
+        fanOutFailures++;
+    }
+    
+    delivery.active = false;
+    fanOutPending--;
+    if (--message.pending > 0) {
+        return;
+    }
+    
+    // Last chat for this alert is done
+    if (message.delivered > 0) {
+        lastFirstDeliveryMs = message.firstDeliveredAt - message.queuedAt;
+        lastLastDeliveryMs = message.lastDeliveredAt - message.queuedAt;
+        if (lastLastDeliveryMs > maxLastDeliveryMs) maxLastDeliveryMs = lastLastDeliveryMs;
+        logMessage(3, "Alert fan-out: " + String(message.delivered) + " chats, first " +
+                   String(lastFirstDeliveryMs) + "ms, last " + String(lastLastDeliveryMs) + "ms");
+    }
+    message.active = false;
+    message.text = "";
+}
+#endif
+
+// ===================================================================
+// SPECULATIVE PRE-WARM
+// ===================================================================
+
+// The raw PIR edge raises an interrupt that wakes a task, which opens the TLS
+// connection to the Bot API while the main loop is still sampling the pin,
+// running the session logic and blinking the motion LED. When the alert is
+// sent the socket is already up. A connection nothing used is closed after
+// TELEGRAM_PREWARM_TIMEOUT.
+
+SemaphoreHandle_t telegramClientMutex = nullptr;
+
+#if TELEGRAM_PREWARM_ENABLED
+TaskHandle_t prewarmTaskHandle = nullptr;
+volatile bool prewarmPending = false;   // Edge seen, task not finished yet
+bool prewarmOpen = false;               // `client` was opened speculatively and is unused
+unsigned long prewarmOpenedAt = 0;
+
+void IRAM_ATTR onMotionEdge() {
+    if (prewarmPending || prewarmTaskHandle == nullptr) {
+        return;
+    }
+    prewarmPending = true;
+    BaseType_t woken = pdFALSE;
+    vTaskNotifyGiveFromISR(prewarmTaskHandle, &woken);
+    if (woken) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+void startPrewarmTask() {
+    if (prewarmTaskHandle != nullptr) {
+        return; // Already running (initializeTelegram() is re-run on failures)
+    }
+    
+    createTelegramClientMutex();
+    if (telegramClientMutex == nullptr ||
+        xTaskCreatePinnedToCore(prewarmTask, "tg_prewarm", TELEGRAM_PREWARM_TASK_STACK, nullptr, 1,
+                                &prewarmTaskHandle, TELEGRAM_POLL_TASK_CORE) != pdPASS) {
+        logMessage(1, "Failed to start connection pre-warm task");
+        prewarmTaskHandle = nullptr;
+        return;
+    }
+    
+    attachInterrupt(digitalPinToInterrupt(MOTION_SENSOR_PIN), onMotionEdge,
+                    MOTION_ACTIVE_STATE == HIGH ? RISING : FALLING);
+}
+
+void prewarmTask(void* parameter) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        
+        if (wifiConnected && bot) {
+            TelegramClientLock lock; // A send in progress finishes first
+            if (client.connected()) {
+                prewarmAlreadyOpen++;
+            } else {
+                CpuBoost boost;
+                if (connectTelegramClient(client)) {
+                    prewarmOpened++;
+                    prewarmOpen = true;
+                    prewarmOpenedAt = millis();
+                } else {
+                    prewarmFailed++;
+                }
+            }
+        }
+        
+        prewarmPending = false;
+    }
+}
+
+void servicePrewarm() {
+    if (!prewarmOpen || millis() - prewarmOpenedAt < TELEGRAM_PREWARM_TIMEOUT) {
+        return;
+    }
+    
+    TelegramClientLock lock;
+    if (prewarmOpen) {
+        client.stop();
+        prewarmOpen = false;
+        prewarmMisses++;
+    }
+}
+#endif
+
+// Created before the first task that shares `client` starts
+void createTelegramClientMutex() {
+    if (telegramClientMutex == nullptr) {
+        telegramClientMutex = xSemaphoreCreateRecursiveMutex();
+    }
+}
+
+void telegramClientAcquire() {
+    if (telegramClientMutex != nullptr) {
+        xSemaphoreTakeRecursive(telegramClientMutex, portMAX_DELAY);
+    }
+}
+
+void telegramClientRelease() {
+    if (telegramClientMutex != nullptr) {
+        xSemaphoreGiveRecursive(telegramClientMutex);
+    }
+}
+
+// Called with the client lock held by every sender: counts a pre-warmed
+// connection that is still up as a hit
+void notePrewarmUse() {
+    #if TELEGRAM_PREWARM_ENABLED
+    if (prewarmOpen) {
+        prewarmOpen = false;
+        if (client.connected()) {
+            prewarmHits++;
+        } else {
+            prewarmMisses++; // Server closed it before it was needed
+        }
+    }
+    #endif
+}
+
+// ===================================================================
+// MQTT TRANSPORT
+// ===================================================================
+
+// Motion events, session boundaries and telemetry are published to a LAN
+// broker alongside Telegram. Every message is QoS 1: it stays in mqttQueue
+// until the broker's PUBACK, waits there through broker or WiFi outages and
+// is re-sent with DUP set after a reconnect or MQTT_RETRY_INTERVAL. The
+// retained status topic reads "online"; the last will sets it to "offline".
+
+#if MQTT_ENABLED
+struct MqttQueuedMessage {
+    bool sent;                          // Written to the broker at least once
+    bool acked;
+    bool retain;
+    uint16_t packetId;
+    unsigned long sentAt;
+    char topic[64];
+    char payload[MQTT_PAYLOAD_MAX_LENGTH];
+};
+
+WiFiClient mqttSocket;
+MqttClient mqtt(mqttSocket);
+MqttQueuedMessage mqttQueue[MQTT_QUEUE_SLOTS];
+int mqttQueueHead = 0;
+int mqttQueueCount = 0;
+uint16_t mqttNextPacketId = 1;
+unsigned long lastMqttAttempt = 0;
+unsigned long lastMqttTelemetry = 0;
+
+bool connectMqtt() {
+    char clientId[32];
+    mqtt.onAck(onMqttAck);
+    snprintf(clientId, sizeof(clientId), "esp32-motion-%06lx", (unsigned long)(ESP.getEfuseMac() & 0xFFFFFF));
+    
+    if (!mqtt.connect(MQTT_BROKER_HOST, MQTT_BROKER_PORT, clientId, MQTT_USERNAME, MQTT_PASSWORD,
+                      MQTT_BASE_TOPIC "/status", "offline", true, MQTT_KEEPALIVE, MQTT_CONNECT_TIMEOUT)) {
+        return false;
+    }
+    mqttConnects++;
+    
+    // The broker started a clean session: everything unacknowledged goes out again
+    for (int i = 0; i < mqttQueueCount; i++) {
+        mqttQueue[(mqttQueueHead + i) % MQTT_QUEUE_SLOTS].sentAt = 0;
+    }
+    
+    mqttEnqueue("status", "online", true);
+    mqttPublishTelemetry();
+    logMessage(2, "MQTT connected to " + String(MQTT_BROKER_HOST) + ":" + String(MQTT_BROKER_PORT));
+    return true;
+}
+
+void serviceMqtt() {
+    unsigned long now = millis();
+    
+    if (!mqtt.connected()) {
+        if (wifiConnected && strlen(MQTT_BROKER_HOST) > 0 &&
+            (lastMqttAttempt == 0 || now - lastMqttAttempt >= MQTT_RECONNECT_INTERVAL)) {
+            lastMqttAttempt = now;
+            if (!connectMqtt()) {
+                logMessage(3, "MQTT broker unreachable, " + String(mqttQueueCount) + " messages queued");
+            }
+        }
+        return;
+    }
+    
+    if (!mqtt.loop()) {
+        logMessage(2, "MQTT connection lost");
+        return;
+    }
+    
+    if (now - lastMqttTelemetry >= MQTT_TELEMETRY_INTERVAL) {
+        mqttPublishTelemetry();
+    }
+    mqttFlush();
+}
+
+// Queues a message under MQTT_BASE_TOPIC and sends it right away when connected
+void mqttEnqueue(const char* subtopic, const char* payload, bool retain) {
+    if (mqttQueueCount == MQTT_QUEUE_SLOTS) {
+        mqttQueueHead = (mqttQueueHead + 1) % MQTT_QUEUE_SLOTS;
+        mqttQueueCount--;
+        mqttDropped++;
+    }
+    
+    MqttQueuedMessage& message = mqttQueue[(mqttQueueHead + mqttQueueCount) % MQTT_QUEUE_SLOTS];
+    snprintf(message.topic, sizeof(message.topic), "%s/%s", MQTT_BASE_TOPIC, subtopic);
+    strncpy(message.payload, payload, sizeof(message.payload) - 1);
+    message.payload[sizeof(message.payload) - 1] = '\0';
+    message.retain = retain;
+    message.sent = false;
+    message.acked = false;
+    message.sentAt = 0;
+    message.packetId = mqttNextPacketId++;
+    if (mqttNextPacketId == 0) mqttNextPacketId = 1; // 0 is not a valid packet id
+    mqttQueueCount++;
+    mqttPublished++;
+    
+    mqttFlush();
+}
+
+// Sends messages not yet on this connection and retransmits overdue ones,
+// keeping at most MQTT_MAX_INFLIGHT unacknowledged
+void mqttFlush() {
+    if (!mqtt.connected()) {
+        return;
+    }
+    
+    unsigned long now = millis();
+    int inFlight = 0;
+    for (int i = 0; i < mqttQueueCount && inFlight < MQTT_MAX_INFLIGHT; i++) {
+        MqttQueuedMessage& message = mqttQueue[(mqttQueueHead + i) % MQTT_QUEUE_SLOTS];
+        if (message.acked) {
+            continue;
+        }
+        inFlight++;
+        if (message.sentAt != 0 && now - message.sentAt < MQTT_RETRY_INTERVAL) {
+            continue;
+        }
+        
+        if (!mqtt.publish(message.topic, (const uint8_t*)message.payload, strlen(message.payload),
+                          message.retain, message.packetId, message.sent)) {
+            return; // Connection dropped; the rest waits for the reconnect
+        }
+        if (message.sent) {
+            mqttRetransmits++;
+        }
+        message.sent = true;
+        message.sentAt = now;
+    }
+}
+
+void onMqttAck(uint16_t packetId) {
+    for (int i = 0; i < mqttQueueCount; i++) {
+        MqttQueuedMessage& message = mqttQueue[(mqttQueueHead + i) % MQTT_QUEUE_SLOTS];
+        if (message.packetId == packetId && message.sent && !message.acked) {
+            message.acked = true;
+            mqttAcked++;
+            lastMqttAckMillis = millis() - message.sentAt;
+            break;
+        }
+    }
+    
+    // Release acknowledged messages from the front of the queue
+    while (mqttQueueCount > 0 && mqttQueue[mqttQueueHead].acked) {
+        mqttQueueHead = (mqttQueueHead + 1) % MQTT_QUEUE_SLOTS;
+        mqttQueueCount--;
+    }
+}
+
+void mqttPublishMotion() {
+    char payload[MQTT_PAYLOAD_MAX_LENGTH];
+    snprintf(payload, sizeof(payload), "{\"ts\":%ld,\"uptime\":%lu,\"trigger\":%d,\"total\":%d}",
+             timeInitialized ? (long)time(nullptr) : 0L, millis(), sessionTriggerCount, totalMotionEvents);
+    mqttEnqueue("motion", payload, false);
+}
+
+void mqttPublishSession(bool started, unsigned long durationSeconds) {
+    char payload[MQTT_PAYLOAD_MAX_LENGTH];
+    if (started) {
+        snprintf(payload, sizeof(payload), "{\"state\":\"start\",\"ts\":%ld}",
+                 timeInitialized ? (long)time(nullptr) : 0L);
+    } else {
+        snprintf(payload, sizeof(payload), "{\"state\":\"end\",\"ts\":%ld,\"duration\":%lu,\"triggers\":%d}",
+                 timeInitialized ? (long)time(nullptr) : 0L, durationSeconds, sessionTriggerCount);
+    }
+    mqttEnqueue("session", payload, true); // Retained: subscribers see whether a session is open
+}
+
+void mqttPublishTelemetry() {
+    char payload[MQTT_PAYLOAD_MAX_LENGTH];
+    snprintf(payload, sizeof(payload),
+             "{\"uptime\":%lu,\"heap\":%lu,\"rssi\":%d,\"motion_events\":%d,\"alerts_today\":%d}",
+             (millis() - systemStartTime) / 1000, (unsigned long)ESP.getFreeHeap(), (int)WiFi.RSSI(),
+             totalMotionEvents, dailyNotificationCount);
+    mqttEnqueue("telemetry", payload, true);
+    lastMqttTelemetry = millis();
+}
+#endif
+
+// ===================================================================
+// OUTBOUND QUEUE
+// ===================================================================
+
+// Notifications and command replies wait here in one queue per priority.
+// The sender task does every Bot API write: it sends one message at a time
+// from the highest class that has any, so an alert never waits behind a
+// reply or status notice, and runs the fan-out retries and live session
+// edits in between. Queuing only wakes it, so a slow or unreachable Telegram
+// never holds up the main loop or the other notifier sinks. Under
+// backpressure, replies and status notices to the same place are merged and
+// the oldest is dropped when their queue is full; alerts and errors are
+// merged into the newest queued one instead of being dropped.
+
+struct OutboundMessage {
+    char chatId[24];                // Empty for notifications routed by messageClass
+    uint8_t messageClass;
+    String text;
+    unsigned long queuedAt;
+    unsigned long createdAt;        // NotifierEvent::createdAt (micros) of a notification
+};
+
+struct OutboundQueue {
+    OutboundMessage slots[OUTBOUND_QUEUE_SLOTS];
+    int head;
+    int count;
+    unsigned long sent;
+    unsigned long coalesced;
+    unsigned long dropped;
+    unsigned long totalWait;
+    unsigned long maxWait;
+};
+
+OutboundQueue outboundQueues[OUTBOUND_PRIORITY_COUNT];
+static const char* const OUTBOUND_PRIORITY_NAMES[] = {"Alert", "Error", "Reply", "Status"};
+SemaphoreHandle_t outboundMutex = nullptr;     // Guards outboundQueues (recursive: logging may queue)
+
+struct OutboundLock {
+    OutboundLock() { if (outboundMutex) xSemaphoreTakeRecursive(outboundMutex, portMAX_DELAY); }
+    ~OutboundLock() { if (outboundMutex) xSemaphoreGiveRecursive(outboundMutex); }
+};
+
+void wakeTelegramSender() {
+    if (telegramSendTaskHandle != nullptr) {
+        xTaskNotifyGive(telegramSendTaskHandle);
+    }
+}
+
+OutboundPriority outboundPriorityFor(uint8_t messageClass) {
+    if (messageClass & MESSAGE_CLASS_MOTION) return PRIORITY_ALERT;
+    if (messageClass & MESSAGE_CLASS_ERROR) return PRIORITY_ERROR;
+    return PRIORITY_STATUS;
+}
+
+void enqueueOutbound(OutboundPriority priority, const char* chatId, uint8_t messageClass, const String& text,
+                     unsigned long createdAt) {
+    bool droppedOldest = false;
+    {
+        OutboundLock lock;
+        OutboundQueue& queue = outboundQueues[priority];
+        bool merged = false;
+        
+        // Low-priority messages to the same destination are merged into one
+        if (priority >= PRIORITY_REPLY) {
+            for (int i = 0; i < queue.count && !merged; i++) {
+                OutboundMessage& queued = queue.slots[(queue.head + i) % OUTBOUND_QUEUE_SLOTS];
+                if (queued.messageClass == messageClass && strcmp(queued.chatId, chatId) == 0 &&
+                    queued.text.length() + text.length() + 2 <= BOT_MAX_MESSAGE_LENGTH) {
+                    queued.text += "\n\n";
+                    queued.text += text;
+                    queue.coalesced++;
+                    merged = true;
+                }
+            }
+        }
+        
+        if (!merged && queue.count >= OUTBOUND_QUEUE_SLOTS) {
+            if (priority >= PRIORITY_REPLY) {
+                queue.slots[queue.head].text = "";
+                queue.head = (queue.head + 1) % OUTBOUND_QUEUE_SLOTS;
+                queue.count--;
+                queue.dropped++;
+                droppedOldest = true;
+            } else {
+                // Alerts and errors are never dropped - the newest queued one
+                // carries this one too (cut to the message size limit)
+                OutboundMessage& newest = queue.slots[(queue.head + queue.count - 1) % OUTBOUND_QUEUE_SLOTS];
+                int room = BOT_MAX_MESSAGE_LENGTH - (int)newest.text.length() - 2;
+                if (room > 0) {
+                    newest.text += "\n\n";
+                    newest.text += text.substring(0, room);
+                }
+                queue.coalesced++;
+                merged = true;
+            }
+        }
+        
+        if (!merged) {
+            OutboundMessage& slot = queue.slots[(queue.head + queue.count) % OUTBOUND_QUEUE_SLOTS];
+            strlcpy(slot.chatId, chatId, sizeof(slot.chatId));
+            slot.messageClass = messageClass;
+            slot.text = text;
+            slot.queuedAt = millis();
+            slot.createdAt = createdAt;
+            queue.count++;
+        }
+    }
+    
+    if (droppedOldest) {
+        logMessage(2, String(OUTBOUND_PRIORITY_NAMES[priority]) + " queue full, oldest message dropped");
+    }
+    wakeTelegramSender();
+}
+
+// Sends the oldest message of one class. Returns false if the class is empty.
+bool sendOutboundMessage(OutboundPriority priority) {
+    // Take the message out first; sending may queue new ones
+    OutboundMessage message;
+    {
+        OutboundLock lock;
+        OutboundQueue& queue = outboundQueues[priority];
+        if (queue.count == 0) {
+            return false;
+        }
+        message = queue.slots[queue.head];
+        queue.slots[queue.head].text = "";
+        queue.head = (queue.head + 1) % OUTBOUND_QUEUE_SLOTS;
+        queue.count--;
+        
+        unsigned long wait = millis() - message.queuedAt;
+        queue.totalWait += wait;
+        if (wait > queue.maxWait) queue.maxWait = wait;
+        queue.sent++;
+    }
+    
+    TelegramClientLock lock;
+    if (message.chatId[0] == '\0') {
+        bool delivered = deliverTelegramNotification(message.text, message.messageClass);
+        telegramNotifier.recordDelivery(delivered, micros() - message.createdAt);
+    } else {
+        sendTelegramMessage(message.chatId, message.text);
+    }
+    return true;
+}
+
+// Sends one message from the highest-priority non-empty class; false if
+// nothing was sent. Status notices are held back while alert deliveries are
+// still being retried.
+bool serviceOutboundQueue() {
+    if (!wifiConnected) {
+        return false;
+    }
+    
+    for (int p = 0; p < OUTBOUND_PRIORITY_COUNT; p++) {
+        if (outboundQueues[p].count == 0) {
+            continue;
+        }
+        #if TELEGRAM_FANOUT_ENABLED
+        if (p == PRIORITY_STATUS && fanOutPending > 0) {
+            return false;
+        }
+        #endif
+        return sendOutboundMessage((OutboundPriority)p);
+    }
+    return false;
+}
+
+void startTelegramSendTask() {
+    if (telegramSendTaskHandle != nullptr) {
+        return; // Already running (initializeTelegram() is re-run on failures)
+    }
+    
+    createTelegramClientMutex();
+    outboundMutex = xSemaphoreCreateRecursiveMutex();
+    if (telegramClientMutex == nullptr || outboundMutex == nullptr ||
+        xTaskCreatePinnedToCore(telegramSendTask, "tg_send", TELEGRAM_SEND_TASK_STACK, nullptr, 1,
+                                &telegramSendTaskHandle, TELEGRAM_POLL_TASK_CORE) != pdPASS) {
+        logMessage(1, "Failed to start Telegram sender task, sending from the main loop");
+        telegramSendTaskHandle = nullptr;
+    }
+}
+
+void telegramSendTask(void* parameter) {
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(TELEGRAM_SEND_TASK_INTERVAL));
+        while (serviceTelegramSender()) {}
+    }
+}
+
+// One round of Bot API writes: due fan-out retries, the next queued message,
+// live session edits and closing an unused pre-warmed connection. Returns
+// true if a queued message was sent (more may be waiting).
+bool serviceTelegramSender() {
+    #if TELEGRAM_FANOUT_ENABLED
+    serviceTelegramFanOut();
+    #endif
+    bool sent = serviceOutboundQueue();
+    #if LIVE_SESSION_ENABLED
+    updateLiveSession();
+    #endif
+    #if TELEGRAM_PREWARM_ENABLED
+    servicePrewarm();
+    #endif
+    return sent;
+}
+
+// Sends everything still queued, highest priority first (used before a reboot)
+void drainOutboundQueue() {
+    for (int p = 0; p < OUTBOUND_PRIORITY_COUNT; p++) {
+        while (sendOutboundMessage((OutboundPriority)p)) {
+            #if ENABLE_WATCHDOG
+            esp_task_wdt_reset();
+            #endif
+        }
+    }
+}
+
+#if LIVE_SESSION_ENABLED
+// ===================================================================
+// LIVE SESSION MESSAGES
+// ===================================================================
+
+// The alert sent when a motion session starts is kept as a live message:
+// later triggers in the same session edit it (at most once per
+// LIVE_SESSION_EDIT_INTERVAL) instead of producing new messages, and a
+// final edit closes it when the session ends. The main loop opens and closes
+// sessions; the sender task records the message ids and makes the edits.
+// Closing hands the ids and the final text over, so a new session can start
+// before the closing edit has been sent.
+
+struct LiveSessionMessage {
+    char chatId[24];
+    long messageId;
+};
+
+LiveSessionMessage liveSessionMessages[LIVE_SESSION_MAX_CHATS];
+int liveSessionMessageCount = 0;
+bool liveSessionOpen = false;           // Collecting message ids for the current session
+volatile bool liveSessionDirty = false; // Triggers since the last edit
+unsigned long lastLiveSessionEdit = 0;
+unsigned long liveSessionEdits = 0;
+
+// Closed session waiting for its final edit
+LiveSessionMessage liveSessionClosing[LIVE_SESSION_MAX_CHATS];
+int liveSessionClosingCount = 0;
+char liveSessionClosingText[256];
+portMUX_TYPE liveSessionMux = portMUX_INITIALIZER_UNLOCKED; // Guards the ids, counts and flags above
+
+void beginLiveSession() {
+    portENTER_CRITICAL(&liveSessionMux);
+    liveSessionMessageCount = 0;
+    liveSessionOpen = true;
+    liveSessionDirty = false;
+    lastLiveSessionEdit = millis();
+    portEXIT_CRITICAL(&liveSessionMux);
+}
+
+// Called with the message id of each delivered motion alert
+void recordLiveSessionMessage(const char* chatId, long messageId) {
+    portENTER_CRITICAL(&liveSessionMux);
+    if (liveSessionOpen && messageId > 0 && liveSessionMessageCount < LIVE_SESSION_MAX_CHATS) {
+        LiveSessionMessage& entry = liveSessionMessages[liveSessionMessageCount++];
+        strlcpy(entry.chatId, chatId, sizeof(entry.chatId));
+        entry.messageId = messageId;
+    }
+    portEXIT_CRITICAL(&liveSessionMux);
+}
+
+void noteLiveSessionTrigger() {
+    liveSessionDirty = true;
+}
+
+// Sender task: the closing edit of an ended session, then the periodic edit
+// of the ongoing one
+void updateLiveSession() {
+    if (!wifiConnected) {
+        return;
+    }
+    
+    LiveSessionMessage entries[LIVE_SESSION_MAX_CHATS];
+    int count = 0;
+    char closingText[sizeof(liveSessionClosingText)];
+    portENTER_CRITICAL(&liveSessionMux);
+    if (liveSessionClosingCount > 0) {
+        count = liveSessionClosingCount;
+        memcpy(entries, liveSessionClosing, count * sizeof(LiveSessionMessage));
+        memcpy(closingText, liveSessionClosingText, sizeof(closingText));
+        liveSessionClosingCount = 0;
+    }
+    portEXIT_CRITICAL(&liveSessionMux);
+    if (count > 0) {
+        editLiveSessionMessages(entries, count, String(closingText), true);
+        return;
+    }
+    
+    if (!liveSessionDirty || millis() - lastLiveSessionEdit < LIVE_SESSION_EDIT_INTERVAL) {
+        return;
+    }
+    #if TELEGRAM_FANOUT_ENABLED
+    if (fanOutPending > 0) {
+        return; // Alert deliveries still retrying go first
+    }
+    #endif
+    
+    portENTER_CRITICAL(&liveSessionMux);
+    if (liveSessionOpen) {
+        count = liveSessionMessageCount;
+        memcpy(entries, liveSessionMessages, count * sizeof(LiveSessionMessage));
+    }
+    portEXIT_CRITICAL(&liveSessionMux);
+    if (count > 0) {
+        editLiveSessionMessages(entries, count, formatLiveSessionText(false), false);
+    }
+}
+
+// Main loop: hands the session's messages to the sender task for the final edit
+void closeLiveSession() {
+    String text = formatLiveSessionText(true);
+    portENTER_CRITICAL(&liveSessionMux);
+    if (liveSessionOpen && liveSessionMessageCount > 0) {
+        liveSessionClosingCount = liveSessionMessageCount;
+        memcpy(liveSessionClosing, liveSessionMessages, liveSessionClosingCount * sizeof(LiveSessionMessage));
+        strlcpy(liveSessionClosingText, text.c_str(), sizeof(liveSessionClosingText));
+    }
+    liveSessionOpen = false;
+    liveSessionMessageCount = 0;
+    portEXIT_CRITICAL(&liveSessionMux);
+    wakeTelegramSender();
+}
+
+String formatLiveSessionText(bool closed) {
+    unsigned long elapsed = ((closed ? lastMotionEnd : millis()) - motionSessionStart) / 1000;
+    
+    String text = closed ? "✅ *Motion Session Ended*\n" : "🚨 *Motion Detected*\n";
+    text += "📍 " + String(DEVICE_LOCATION) + "\n";
+    text += "⏱️ " + String(elapsed / 60) + "m " + String(elapsed % 60) + "s\n";
+    text += "🔢 " + String(sessionTriggerCount) + (sessionTriggerCount == 1 ? " trigger" : " triggers");
+    if (!closed) {
+        text += "\n🔴 Ongoing";
+    }
+    return text;
+}
+
+void editLiveSessionMessages(const LiveSessionMessage* entries, int count, const String& text, bool closed) {
+    for (int i = 0; i < count; i++) {
+        const LiveSessionMessage& entry = entries[i];
+        
+        // Updates are skipped while a chat is throttled; the closing edit waits briefly
+        unsigned long wait = rateLimitWait(entry.chatId);
+        if (wait > 0) {
+            if (!closed || wait > RATE_MAX_BLOCKING_WAIT) {
+                rateLimitDeferred++;
+                continue;
+            }
+            delay(wait);
+        }
+        rateLimitConsume(entry.chatId);
+        
+        #if ENABLE_WATCHDOG
+        esp_task_wdt_reset();
+        #endif
+        
+        TelegramClientLock lock;
+        notePrewarmUse();
+        CpuBoost boost;
+        if (!client.connected()) {
+            connectTelegramClient(client);
+        }
+        DynamicJsonDocument payload(JSON_OBJECT_SIZE(4) + text.length() + 64);
+        payload["chat_id"] = entry.chatId;
+        payload["message_id"] = entry.messageId;
+        payload["text"] = text;
+        if (strlen(MESSAGE_PARSE_MODE) > 0) {
+            payload["parse_mode"] = MESSAGE_PARSE_MODE;
+        }
+        
+        String response = bot->sendPostToTelegram("editMessageText", payload.as<JsonObject>());
+        unsigned long retryAfter = parseRetryAfter(response.c_str());
+        if (retryAfter > 0) {
+            rateLimitRetryAfter(entry.chatId, retryAfter);
+        } else if (response.indexOf("\"ok\":true") >= 0) {
+            liveSessionEdits++;
+        }
+    }
+    
+    if (!closed) {
+        liveSessionDirty = false;
+        lastLiveSessionEdit = millis();
+    }
+}
+#endif
+
+// ===================================================================
+// RATE LIMITING
+// ===================================================================
+
+// Outgoing messages draw from a global token bucket and one per chat, so a
+// burst of alerts stays inside the Bot API limits instead of hitting 429.
+// A 429 retry_after blocks that chat for the time the server asks for.
+// Motion notifications are additionally capped per sliding hour.
+
+struct TokenBucket {
+    long milliTokens;               // 1000 per message
+    unsigned long lastRefill;
+    unsigned long blockedSince;     // Set from a 429 retry_after
+    unsigned long blockedFor;
+    bool primed;
+};
+
+struct ChatRateLimit {
+    char chatId[24];
+    TokenBucket bucket;
+    unsigned long lastUsed;
+};
+
+TokenBucket globalRateBucket;
+ChatRateLimit chatRateLimits[RATE_CHAT_BUCKETS];
+
+// Sliding one-hour window of motion notifications, one bucket per slot
+uint16_t notificationWindow[NOTIFICATION_WINDOW_BUCKETS];
+unsigned long notificationWindowSlot = 0;   // Absolute slot of the newest bucket
+int notificationWindowTotal = 0;
+
+// Returns how long (ms) until the bucket can pay for one message
+unsigned long bucketWait(TokenBucket& bucket, long perMinute, long burst) {
+    unsigned long now = millis();
+    if (!bucket.primed) {
+        bucket.milliTokens = burst * 1000;
+        bucket.lastRefill = now;
+        bucket.primed = true;
+    }
+    
+    unsigned long elapsed = now - bucket.lastRefill;
+    if (elapsed > 60000UL) elapsed = 60000UL; // Bucket is full long before this
+    bucket.milliTokens = min(burst * 1000, bucket.milliTokens + (long)(elapsed * perMinute / 60));
+    bucket.lastRefill = now;
+    
+    unsigned long wait = 0;
+    if (bucket.blockedFor > 0) {
+        unsigned long blocked = now - bucket.blockedSince;
+        if (blocked < bucket.blockedFor) {
+            wait = bucket.blockedFor - blocked;
+        } else {
+            bucket.blockedFor = 0;
+        }
+    }
+    if (bucket.milliTokens < 1000) {
+        wait = max(wait, (unsigned long)((1000 - bucket.milliTokens) * 60 / perMinute) + 1);
+    }
+    return wait;
+}
+
+ChatRateLimit& chatRateLimit(const char* chatId) {
+    unsigned long now = millis();
+    int victim = 0;
+    for (int i = 0; i < RATE_CHAT_BUCKETS; i++) {
+        if (strcmp(chatRateLimits[i].chatId, chatId) == 0) {
+            chatRateLimits[i].lastUsed = now;
+            return chatRateLimits[i];
+        }
+        if (chatRateLimits[i].chatId[0] == '\0' ||
+            (chatRateLimits[victim].chatId[0] != '\0' &&
+             now - chatRateLimits[i].lastUsed > now - chatRateLimits[victim].lastUsed)) {
+            victim = i;
+        }
+    }
+    
+    // Reuse the least recently used entry
+    ChatRateLimit& entry = chatRateLimits[victim];
+    strlcpy(entry.chatId, chatId, sizeof(entry.chatId));
+    entry.bucket = TokenBucket();
+    entry.lastUsed = now;
+    return entry;
+}
+
+// Returns how long (ms) a message to chatId has to wait; 0 means send now
+unsigned long rateLimitWait(const char* chatId) {
+    unsigned long globalWait = bucketWait(globalRateBucket, RATE_GLOBAL_PER_MINUTE, RATE_GLOBAL_BURST);
+    unsigned long chatWait = bucketWait(chatRateLimit(chatId).bucket, RATE_CHAT_PER_MINUTE, RATE_CHAT_BURST);
+    return max(globalWait, chatWait);
+}
+
+// Takes the tokens for one message; call only after rateLimitWait() returned 0
+void rateLimitConsume(const char* chatId) {
+    globalRateBucket.milliTokens -= 1000;
+    chatRateLimit(chatId).bucket.milliTokens -= 1000;
+}
+
+// Applies a 429 retry_after hint to the chat it came from
+void rateLimitRetryAfter(const char* chatId, unsigned long retryAfterSeconds) {
+    TokenBucket& bucket = chatRateLimit(chatId).bucket;
+    bucket.blockedSince = millis();
+    bucket.blockedFor = max(1UL, retryAfterSeconds) * 1000UL;
+    
+    rateLimit429Count++;
+    lastRetryAfterSeconds = retryAfterSeconds;
+    logMessage(2, "Telegram flood control: retry after " + String(retryAfterSeconds) + "s for " + String(chatId));
+}
+
+// Extracts parameters.retry_after from a Bot API error body (0 if absent)
+unsigned long parseRetryAfter(const char* body) {
+    const char* field = strstr(body, "\"retry_after\":");
+    return field ? strtoul(field + 14, nullptr, 10) : 0;
+}
+
+void advanceNotificationWindow() {
+    unsigned long slot = millis() / NOTIFICATION_WINDOW_BUCKET_MS;
+    unsigned long steps = slot - notificationWindowSlot;
+    if (steps > NOTIFICATION_WINDOW_BUCKETS) steps = NOTIFICATION_WINDOW_BUCKETS;
+    
+    // Expire the buckets that slid out of the hour
+    for (unsigned long i = 1; i <= steps; i++) {
+        uint16_t& bucket = notificationWindow[(notificationWindowSlot + i) % NOTIFICATION_WINDOW_BUCKETS];
+        notificationWindowTotal -= bucket;
+        bucket = 0;
+    }
+    notificationWindowSlot = slot;
+}
+
+int notificationsInLastHour() {
+    advanceNotificationWindow();
+    return notificationWindowTotal;
+}
+
+void recordNotificationInWindow() {
+    advanceNotificationWindow();
+    notificationWindow[notificationWindowSlot % NOTIFICATION_WINDOW_BUCKETS]++;
+    notificationWindowTotal++;
+}
+
+// ===================================================================
+// BOT COMMAND DISPATCH
+// ===================================================================
+
+// Commands are looked up through a perfect hash computed at compile time:
+// the FNV-1a hash of the command name (up to '@' or whitespace) is seeded
+// with BOT_COMMAND_HASH_SEED and its top bits select a slot. The static_assert
+// below fails the build if two commands share a slot - change the seed then.
+#define BOT_COMMAND_TABLE_BITS 5
+#define BOT_COMMAND_TABLE_SIZE (1 << BOT_COMMAND_TABLE_BITS)
+#define BOT_COMMAND_HASH_SEED 2166136309u
+
+typedef void (*BotCommandHandler)(const String& chatId, const char* args, String& response);
+
+struct BotCommand {
+    const char* name;
+    uint8_t nameLength;
+    BotCommandHandler handler;
+    const char* help;
+    uint32_t invocations;
+    uint32_t totalMicros;
+    uint32_t maxMicros;
+};
+
+BotCommand botCommandTable[BOT_COMMAND_TABLE_SIZE];
+uint8_t botCommandOrder[BOT_COMMAND_TABLE_SIZE];  // Registration order, used for /help
+int botCommandCount = 0;
+uint32_t unknownCommandCount = 0;
+
+constexpr bool isCommandTerminator(char c) {
+    return c == '\0' || c == '@' || c == ' ' || c == '\n' || c == '\t';
+}
+
+constexpr uint32_t botCommandHash(const char* s, uint32_t h = BOT_COMMAND_HASH_SEED) {
+    return isCommandTerminator(*s) ? h : botCommandHash(s + 1, (h ^ (uint8_t)*s) * 16777619u);
+}
+
+constexpr uint8_t botCommandSlot(const char* name) {
+    return (uint8_t)(botCommandHash(name) >> (32 - BOT_COMMAND_TABLE_BITS));
+}
+
+// Command name, handler, help text. Order here is the order shown in /help.
+#define BOT_COMMAND_LIST(X) \
+    X("/status",        cmdStatus,        "Show system status") \
+    X("/test",          cmdTest,          "Send test message") \
+    X("/stats",         cmdStats,         "Show statistics") \
+    X("/cmdstats",      cmdCommandStats,  "Show command dispatch statistics") \
+    X("/botstats",      cmdBotStats,      "Show Telegram polling statistics") \
+    X("/info",          cmdInfo,          "Show device information") \
+    X("/reset",         cmdReset,         "Reset counters") \
+    X("/reboot",        cmdReboot,        "Restart device") \
+    X("/sensor_config", cmdSensorConfig,  "Enter sensor config mode") \
+    X("/sensitivity",   cmdSensitivity,   "[0-4|auto] Set sensor sensitivity") \
+    X("/range",         cmdRange,         "[0-2] Set sensor range") \
+    X("/test_sensor",   cmdTestSensor,    "Test current sensor settings") \
+    X("/show_settings", cmdShowSettings,  "Show current sensor settings") \
+    X("/history",       cmdHistory,       "[hour|week|year] Show motion history") \
+    X("/trace",         cmdTrace,         "[seconds|off] Stream the raw PIR signal to serial") \
+    X("/help",          cmdHelp,          "Show this help")
+
+#define BOT_COMMAND_SLOT_ENTRY(name, handler, help) botCommandSlot(name),
+static constexpr uint8_t BOT_COMMAND_SLOTS[] = { BOT_COMMAND_LIST(BOT_COMMAND_SLOT_ENTRY) };
+#undef BOT_COMMAND_SLOT_ENTRY
+
+constexpr bool botCommandSlotUniqueFrom(const uint8_t* slots, size_t count, size_t i, size_t j) {
+    return j >= count || (slots[i] != slots[j] && botCommandSlotUniqueFrom(slots, count, i, j + 1));
+}
+
+constexpr bool botCommandSlotsUnique(const uint8_t* slots, size_t count, size_t i = 0) {
+    return i >= count || (botCommandSlotUniqueFrom(slots, count, i, i + 1) && botCommandSlotsUnique(slots, count, i + 1));
+}
+
+static_assert(sizeof(BOT_COMMAND_SLOTS) <= BOT_COMMAND_TABLE_SIZE, "Too many bot commands for BOT_COMMAND_TABLE_BITS");
+static_assert(botCommandSlotsUnique(BOT_COMMAND_SLOTS, sizeof(BOT_COMMAND_SLOTS)),
+              "Bot command hash collision - change BOT_COMMAND_HASH_SEED");
+
+bool registerBotCommand(const char* name, BotCommandHandler handler, const char* help) {
+    uint8_t slot = botCommandSlot(name);
+    if (botCommandTable[slot].handler != nullptr) {
+        logMessage(1, "Bot command slot collision: " + String(name));
+        return false;
+    }
+    
+    botCommandTable[slot].name = name;
+    botCommandTable[slot].nameLength = strlen(name);
+    botCommandTable[slot].handler = handler;
+    botCommandTable[slot].help = help;
+    botCommandTable[slot].invocations = 0;
+    botCommandTable[slot].totalMicros = 0;
+    botCommandTable[slot].maxMicros = 0;
+    botCommandOrder[botCommandCount++] = slot;
+    return true;
+}
+
+void initializeBotCommands() {
+    memset(botCommandTable, 0, sizeof(botCommandTable));
+    botCommandCount = 0;
+    
+    #define BOT_COMMAND_REGISTER(name, handler, help) registerBotCommand(name, handler, help);
+    BOT_COMMAND_LIST(BOT_COMMAND_REGISTER)
+    #undef BOT_COMMAND_REGISTER
+}
+
+// Resolves "/cmd", "/cmd@botname" and "/cmd@botname args" without allocating.
+// On success, *args points at the first non-blank character after the command.
+BotCommand* findBotCommand(const char* text, const char** args) {
+    const char* end = text;
+    while (!isCommandTerminator(*end)) end++;
+    size_t length = end - text;
+    
+    BotCommand* entry = &botCommandTable[botCommandSlot(text)];
+    if (!entry->handler || entry->nameLength != length || strncmp(entry->name, text, length) != 0) {
+        return nullptr;
+    }
+    
+    // Skip optional @botname suffix, then leading blanks of the arguments
+    if (*end == '@') {
+        while (*end != '\0' && *end != ' ' && *end != '\n' && *end != '\t') end++;
+    }
+    while (*end == ' ' || *end == '\n' || *end == '\t') end++;
+    *args = end;
+    return entry;
+}
+
+// Parses a non-negative integer argument. Returns -1 when absent or malformed.
+int parseCommandIntArg(const char* args) {
+    if (*args < '0' || *args > '9') {
+        return -1;
+    }
+    char* end = nullptr;
+    long value = strtol(args, &end, 10);
+    while (*end == ' ' || *end == '\n' || *end == '\t') end++;
+    return (*end == '\0' && value <= INT16_MAX) ? (int)value : -1;
+}
+
+void processCommand(const String& chatId, const String& command, const String& fromName) {
+    String response;
+    response.reserve(256);
+    
+    const char* args = "";
+    BotCommand* entry = findBotCommand(command.c_str(), &args);
+    
+    if (entry) {
+        unsigned long startMicros = micros();
+        entry->handler(chatId, args, response);
+        uint32_t elapsed = micros() - startMicros;
+        
+        entry->invocations++;
+        entry->totalMicros += elapsed;
+        if (elapsed > entry->maxMicros) entry->maxMicros = elapsed;
+    } else {
+        unknownCommandCount++;
+        response = "❓ Unknown command: " + command + "\nSend /help for available commands.";
+    }
+    
+    if (response.length() > 0) {
+        queueCommandReply(chatId, response);
+    }
+}
+
+void cmdStatus(const String& chatId, const char* args, String& response) {
+    response = "📊 *System Status*\n";
+    #ifdef USE_SECRETS_FILE
+    response += "📍 " + String(DEVICE_LOCATION_SECRET) + "\n";
+    #else
+    response += "📍 " + String(DEVICE_LOCATION) + "\n";
+    #endif
+    response += "🔋 Uptime: " + getUptimeString() + "\n";
+    response += "💾 Memory: " + String(ESP.getFreeHeap()) + " bytes\n";
+    response += "📶 WiFi: " + String(WiFi.RSSI()) + " dBm";
+    
+    response += "\n🔢 Motion Events: " + String(totalMotionEvents);
+    response += "\n📊 Daily Notifications: " + String(dailyNotificationCount);
+    #ifdef SOC_TEMP_SENSOR_SUPPORTED
+    response += "\n🌡️ CPU Temp: " + String(temperatureRead()) + "°C";
+    #endif
+}
+
+void cmdTest(const String& chatId, const char* args, String& response) {
+    response = "🧪 *Test Message*\n";
+    response += "Device: " + String(DEVICE_NAME) + "\n";
+    response += "Location: " + String(DEVICE_LOCATION) + "\n";
+    response += "Time: " + getCurrentTimeString();
+}
+
+void cmdHelp(const String& chatId, const char* args, String& response) {
+    response = "🤖 *Available Commands:*\n";
+    for (int i = 0; i < botCommandCount; i++) {
+        const BotCommand& entry = botCommandTable[botCommandOrder[i]];
+        response += entry.name;
+        response += " - ";
+        response += entry.help;
+        response += "\n";
+    }
+}
+
+void cmdStats(const String& chatId, const char* args, String& response) {
+    response = "📈 *System Statistics:*\n";
+    response += "Total Motion Events: " + String(totalMotionEvents) + "\n";
+    response += "Daily Notifications: " + String(dailyNotificationCount) + "\n";
+    response += "WiFi Failures: " + String(wifiFailureCount) + "\n";
+    response += "Telegram Failures: " + String(telegramFailureCount) + "\n";
+    response += "Free Memory: " + String(ESP.getFreeHeap()) + " bytes\n";
+    response += "Max Loop Time: " + String(maxLoopTime) + " μs\n";
+    response += "Avg Loop Time: " + String(avgLoopTime) + " μs";
+    #if LIVE_SESSION_ENABLED
+    response += "\nLive Session Edits: " + String(liveSessionEdits);
+    #endif
+    response += formatNotifierStats();
+    #if EVENT_JOURNAL_ENABLED
+    response += formatJournalStats();
+    #endif
+    #if CLUSTER_ENABLED
+    response += formatClusterStats();
+    #endif
+    #if MQTT_ENABLED
+    response += "\nMQTT: " + String(mqtt.connected() ? "connected" : "offline") + ", " + String(mqttPublished) +
+                " published, " + String(mqttAcked) + " acked (last " + String(lastMqttAckMillis) + "ms), " +
+                String(mqttQueueCount) + " queued, " + String(mqttDropped) + " dropped, " +
+                String(mqttRetransmits) + " retransmits";
+    #endif
+    #if DIGEST_MODE_ENABLED
+    response += "\nDigests Sent: " + String(digestsSent) + " (" + String(digestedSessions) + " sessions, " +
+                String(motionDigest.sessions) + " pending)";
+    #endif
+}
+
+void cmdCommandStats(const String& chatId, const char* args, String& response) {
+    response = "⌨️ *Command Statistics:*\n";
+    for (int i = 0; i < botCommandCount; i++) {
+        const BotCommand& entry = botCommandTable[botCommandOrder[i]];
+        if (entry.invocations == 0) continue;
+        response += String(entry.name) + ": " + String(entry.invocations) + "x, avg " +
+                    String(entry.totalMicros / entry.invocations) + " μs, max " +
+                    String(entry.maxMicros) + " μs\n";
+    }
+    response += "Unknown: " + String(unknownCommandCount);
+}
+
+void cmdBotStats(const String& chatId, const char* args, String& response) {
+    unsigned long uptimeHours = max(1UL, (millis() - systemStartTime) / 3600000UL);
+    
+    response = "📡 *Telegram Polling:*\n";
+    #if TELEGRAM_WEBHOOK_ENABLED
+    response += "Mode: webhook (port " + String(WEBHOOK_PORT) + ")\n";
+    response += "Webhook Requests: " + String(webhookRequests) + " (" + String(webhookRejected) +
+                " rejected, " + String(webhookDuplicates) + " duplicate)\n";
+    #elif TELEGRAM_LONG_POLL_ENABLED
+    response += "Mode: long poll (" + String(TELEGRAM_LONG_POLL_TIMEOUT) + "s)\n";
+    #else
+    response += "Mode: short poll (" + String(BOT_MTBS) + "ms)\n";
+    #endif
+    response += "getUpdates Requests: " + String(telegramPollRequests) + " (" +
+                String(telegramPollRequests / uptimeHours) + "/h)\n";
+    response += "Updates Fetched: " + String(updatesFetched) + "\n";
+    response += "Update Offset: " + String((long)telegramUpdateOffset) + "\n";
+    response += "Last Batch: " + String(lastUpdateBatchSize) + " (max " + String(maxUpdateBatchSize) + ")\n";
+    response += "Last Response: " + String(lastResponseBytes) + " bytes, parsed in " + String(lastParseMicros) +
+                "µs (max " + String(maxResponseBytes) + " bytes)\n";
+    
+    // Backlog: commands waiting for the main loop, plus more on the server if the last batch was full
+    int backlog = 0;
+    #if TELEGRAM_LONG_POLL_ENABLED || TELEGRAM_WEBHOOK_ENABLED
+    if (telegramCommandQueue) backlog = uxQueueMessagesWaiting(telegramCommandQueue);
+    #endif
+    response += "Backlog: " + String(backlog) + (lastUpdateBatchSize >= TELEGRAM_UPDATE_BATCH_SIZE ? "+ (server)" : "") + "\n";
+    if (lastDrainCount > 0) {
+        response += "Drain Rate: " + String(lastDrainCount * 1000 / max(1UL, lastDrainMillis)) + " cmd/s (" +
+                    String(lastDrainCount) + " in " + String(lastDrainMillis) + "ms)\n";
+    }
+    response += "Commands Handled: " + String(commandsHandled) + "\n";
+    response += "Replies Merged: " + String(mergedReplies) + "\n";
+    response += "Commands Deferred: " + String(deferredCommands) + "\n";
+    if (commandsHandled > 0) {
+        response += "Latency: last " + String(lastCommandLatency) + "ms, avg " +
+                    String(totalCommandLatency / commandsHandled) + "ms, max " +
+                    String(maxCommandLatency) + "ms";
+    }
+    
+    #if TELEGRAM_FANOUT_ENABLED
+    response += "\n\n📤 *Alert Fan-out:*\n";
+    response += "Alerts: " + String(fanOutAlerts) + " (" + String(fanOutRequests) + " requests, " +
+                String(fanOutRetries) + " retries, " + String(fanOutFailures) + " failed)\n";
+    response += "Pending Deliveries: " + String(fanOutPending) + "\n";
+    response += "First Delivery: " + String(lastFirstDeliveryMs) + "ms\n";
+    response += "Last Delivery: " + String(lastLastDeliveryMs) + "ms (max " + String(maxLastDeliveryMs) + "ms)";
+    #endif
+    
+    response += "\n\n🔐 *TLS:*\n";
+    response += "Profile: " + String(USE_SSL_VERIFICATION ? "pinned CA" : "insecure") + "\n";
+    response += "Handshakes: " + String(tlsHandshakes) + " (" + String(tlsHandshakeFailures) + " failed)\n";
+    if (tlsHandshakes > 0) {
+        response += "Handshake: last " + String(tlsLastHandshakeMillis) + "ms, avg " +
+                    String(tlsTotalHandshakeMillis / tlsHandshakes) + "ms, max " + String(tlsMaxHandshakeMillis) + "ms\n";
+    }
+    response += "Session Heap: " + String(tlsLastHeapBytes) + " bytes";
+    
+    #if DNS_CACHE_ENABLED
+    response += "\n\n🧭 *DNS Cache:*\n";
+    response += "Lookups: " + String(dnsLookups) + " (" + String(dnsHits) + " hit, " + String(dnsStaleHits) + " stale)\n";
+    response += "Queries: " + String(dnsQueries) + " (" + String(dnsFailures) + " failed)\n";
+    response += "Resolve Time: " + String(lastResolveMillis) + "ms (max " + String(maxResolveMillis) + "ms)";
+    #endif
+    
+    #if TELEGRAM_PREWARM_ENABLED
+    response += "\n\n🔥 *Connection Pre-warm:*\n";
+    response += "Opened: " + String(prewarmOpened) + " (" + String(prewarmHits) + " hit, " +
+                String(prewarmMisses) + " miss, " + String(prewarmFailed) + " failed)\n";
+    response += "Already Open: " + String(prewarmAlreadyOpen);
+    #endif
+    
+    response += "\n\n📬 *Outbound Queue:*\n";
+    for (int p = 0; p < OUTBOUND_PRIORITY_COUNT; p++) {
+        const OutboundQueue& queue = outboundQueues[p];
+        response += String(OUTBOUND_PRIORITY_NAMES[p]) + ": " + String(queue.count) + " queued, " +
+                    String(queue.sent) + " sent";
+        if (queue.sent > 0) {
+            response += ", wait avg " + String(queue.totalWait / queue.sent) + "ms max " + String(queue.maxWait) + "ms";
+        }
+        if (queue.coalesced > 0 || queue.dropped > 0) {
+            response += ", " + String(queue.coalesced) + " merged, " + String(queue.dropped) + " dropped";
+        }
+        response += "\n";
+    }
+    
+    response += "\n🚦 *Rate Limits:*\n";
+    response += "Alerts Last Hour: " + String(notificationsInLastHour()) + "/" + String(MAX_NOTIFICATIONS_PER_HOUR) + "\n";
+    response += "Deferred: " + String(rateLimitDeferred) + "\n";
+    response += "Dropped: " + String(rateLimitDropped) + "\n";
+    response += "Over Hourly Limit: " + String(rateLimitWindowSuppressed) + "\n";
+    response += "429 Responses: " + String(rateLimit429Count);
+    if (rateLimit429Count > 0) {
+        response += " (last retry_after " + String(lastRetryAfterSeconds) + "s)";
+    }
+}
+
+void cmdInfo(const String& chatId, const char* args, String& response) {
+    response = "ℹ️ *Device Information:*\n";
+    response += "Model: " + String(ESP.getChipModel()) + "\n";
+    response += "Revision: " + String(ESP.getChipRevision()) + "\n";
+    response += "CPU Freq: " + String(ESP.getCpuFreqMHz()) + " MHz\n";
+    response += getPowerSummary() + "\n";
+    response += "Flash: " + String(ESP.getFlashChipSize() / 1024 / 1024) + " MB\n";
+    response += "SDK: " + String(ESP.getSdkVersion()) + "\n";
+    response += "MAC: " + WiFi.macAddress() + "\n";
+    static const char* const timeSourceNames[] = {"not set", "HTTP Date header", "SNTP"};
+    response += "Clock: " + String(timeSourceNames[timeSource]) + " (" + String(timeSyncCount) + " syncs)\n";
+    response += "Reset: " + String(resetReasonName(resetReason)) + ", boot " + String(bootDuration) + " ms";
+    response += fastBoot ? " (fast)" : "";
+    response += ", warm boots: " + String(rtcBootState.bootCount - 1);
+}
+
+void cmdReset(const String& chatId, const char* args, String& response) {
+    resetDailyCounters();
+    response = "🔄 *Counters Reset*\nDaily statistics have been reset.";
+}
+
+void cmdReboot(const String& chatId, const char* args, String& response) {
+    flushCommandReplies(); // Deliver replies from earlier commands in the batch first
+    drainOutboundQueue();
+    TelegramClientLock lock;
+    bot->sendMessage(chatId, "🔄 *Rebooting System*\nDevice will restart in 5 seconds...", MESSAGE_PARSE_MODE);
+    #if HISTORY_ENABLED
+    saveHistory();
+    #endif
+    delay(5000);
+    ESP.restart();
+}
+
+void cmdHistory(const String& chatId, const char* args, String& response) {
+    #if HISTORY_ENABLED
+    response = formatHistory(args);
+    #else
+    response = "❌ Motion history is disabled (HISTORY_ENABLED)";
+    #endif
+}
+
+void cmdTrace(const String& chatId, const char* args, String& response) {
+    #if TRACE_CAPTURE_ENABLED
+    if (strcmp(args, "off") == 0) {
+        if (traceCaptureActive()) {
+            stopTraceCapture();
+            response = "⏹️ Trace capture stopped";
+        } else {
+            response = "ℹ️ No trace capture running";
+        }
+        return;
+    }
+    if (traceCaptureActive()) {
+        response = "🎞️ *Trace Capture Running*\n" + formatTraceStatus();
+        return;
+    }
+    
+    int seconds = *args ? parseCommandIntArg(args) : TRACE_DEFAULT_DURATION;
+    if (seconds < 0) {
+        response = "❌ Usage: `/trace [seconds|off]`";
+        return;
+    }
+    if (!startTraceCapture(seconds)) {
+        response = "❌ Could not start trace capture";
+        return;
+    }
+    response = "🎞️ *Trace Capture Started*\n";
+    response += "Sampling the PIR pin at " + String(TRACE_SAMPLE_RATE) + " Hz ";
+    response += seconds ? "for " + String(seconds) + "s" : String("until /trace off");
+    response += "\nRecord the serial port with the host trace recorder.";
+    #else
+    response = "❌ Trace capture is disabled (TRACE_CAPTURE_ENABLED)";
+    #endif
+}
+
+void cmdSensorConfig(const String& chatId, const char* args, String& response) {
+    if (!sensor_config_mode_active) {
+        enterSensorConfigMode();
+        response = "🔧 *Sensor Config Mode Activated*\nUse physical button or /sensitivity and /range commands to adjust settings.";
+    } else {
+        response = "⚠️ Sensor config mode already active.";
+    }
+}
+
+void cmdSensitivity(const String& chatId, const char* args, String& response) {
+    if (*args == '\0') {
+        response = "🎚️ *Current Sensitivity*\n";
+        response += "Level: " + String(current_sensitivity_level) + "/4 (" + SENSITIVITY_LEVEL_NAMES[current_sensitivity_level] + ")\n";
+        #if AUTO_CALIBRATION_ENABLED
+        if (calibrationActive || sensorCalibrated) {
+            response += formatCalibrationStatus() + "\n";
+        }
+        response += "Use `/sensitivity [0-4]` to change, `/sensitivity auto [minutes]` to calibrate.";
+        #else
+        response += "Use `/sensitivity [0-4]` to change.";
+        #endif
+        return;
+    }
+    
+    if (strncmp(args, "auto", 4) == 0) {
+        #if AUTO_CALIBRATION_ENABLED
+        const char* minutesArg = args + 4;
+        while (*minutesArg == ' ') minutesArg++;
+        int minutes = *minutesArg ? parseCommandIntArg(minutesArg) : CALIBRATION_PERIOD / 60000;
+        if (minutes <= 0) {
+            response = "❌ Usage: `/sensitivity auto [minutes]`";
+        } else if (!startCalibration(minutes * 60000UL)) {
+            response = "⏳ The sensor is still warming up, try again in a minute.";
+        } else {
+            response = "🎯 *Calibration Started*\n";
+            response += "Learning the sensor's noise for " + String(minutes) + " min.\n";
+            response += "Keep the area empty; the result is sent when done.";
+        }
+        #else
+        response = "❌ Auto-calibration is disabled (AUTO_CALIBRATION_ENABLED)";
+        #endif
+        return;
+    }
+    
+    int newSensitivity = parseCommandIntArg(args);
+    if (newSensitivity >= SENSITIVITY_VERY_LOW && newSensitivity <= SENSITIVITY_VERY_HIGH) {
+        #if AUTO_CALIBRATION_ENABLED
+        clearCalibration(); // Set by hand from now on
+        #endif
+        current_sensitivity_level = newSensitivity;
+        applySensorSettings();
+        saveSensorSettings();
         
-        if (sensor_config_mode_active) {
-            response += "\n🔧 Config mode is currently active";
-        }
+        response = "🎚️ *Sensitivity Updated*\n";
+        response += "Level: " + String(newSensitivity) + "/4 (" + SENSITIVITY_LEVEL_NAMES[newSensitivity] + ")\n";
+        response += "Debounce: " + String(getSensorDebounceDelay()) + "ms";
+    } else {
+        response = "❌ Invalid sensitivity level. Use 0-4.";
+    }
+}
+
+void cmdRange(const String& chatId, const char* args, String& response) {
+    if (*args == '\0') {
+        response = "📏 *Current Range*\n";
+        response += "Setting: " + String(current_range_setting) + "/2 (" + RANGE_SETTING_NAMES[current_range_setting] + ")\n";
+        response += "Use `/range [0-2]` to change.";
+        return;
+    }
+    
+    int newRange = parseCommandIntArg(args);
+    if (newRange >= RANGE_SHORT && newRange <= RANGE_LONG) {
+        #if AUTO_CALIBRATION_ENABLED
+        clearCalibration(); // Set by hand from now on
+        #endif
+        current_range_setting = newRange;
+        applySensorSettings();
+        saveSensorSettings();
         
+        response = "📏 *Range Updated*\n";
+        response += "Setting: " + String(newRange) + "/2 (" + RANGE_SETTING_NAMES[newRange] + ")\n";
+        response += "Cooldown: " + String(getMotionCooldownPeriod()) + "ms";
     } else {
-        response = "❓ Unknown command: " + command + "\nSend /help for available commands.";
+        response = "❌ Invalid range setting. Use 0-2.";
+    }
+}
+
+void cmdTestSensor(const String& chatId, const char* args, String& response) {
+    {
+        TelegramClientLock lock;
+        bot->sendMessage(chatId, "🧪 *Starting Sensor Test*\nMove in front of sensor for 10 seconds...", MESSAGE_PARSE_MODE);
     }
     
-    if (response.length() > 0) {
-        sendTelegramMessage(chatId.c_str(), response);
+    // Run the sensor test - it sends its own results
+    testSensorSettings();
+}
+
+void cmdShowSettings(const String& chatId, const char* args, String& response) {
+    response = "⚙️ *Current Sensor Settings*\n";
+    response += "🎚️ Sensitivity: " + String(current_sensitivity_level) + "/4 (" + SENSITIVITY_LEVEL_NAMES[current_sensitivity_level] + ")\n";
+    response += "📏 Range: " + String(current_range_setting) + "/2 (" + RANGE_SETTING_NAMES[current_range_setting] + ")\n";
+    response += "⏱️ Debounce: " + String(getSensorDebounceDelay()) + "ms\n";
+    response += "🕐 Cooldown: " + String(getMotionCooldownPeriod()) + "ms\n";
+    #if AUTO_CALIBRATION_ENABLED
+    if (calibrationActive || sensorCalibrated) {
+        response += formatCalibrationStatus() + "\n";
+    }
+    #endif
+    
+    if (sensor_config_mode_active) {
+        response += "\n🔧 Config mode is currently active";
     }
 }
 
@@ -1217,8 +5239,16 @@ void handleMotionDetection() {
         return;
     }
     
-    bool currentMotionState = isMotionDetected();
+    // Pulses shorter than the pin debounce are noise
+    static bool pinActive = false;
+    static unsigned long pinActiveSince = 0;
+    bool pinState = isMotionDetected();
     unsigned long currentTime = millis();
+    if (pinState && !pinActive) {
+        pinActiveSince = currentTime;
+    }
+    pinActive = pinState;
+    bool currentMotionState = pinState && currentTime - pinActiveSince >= getMotionPinDebounce();
     
     if (currentMotionState) {
         // Motion detected
@@ -1229,21 +5259,60 @@ void handleMotionDetection() {
             
             if (!motionSessionActive) {
                 // Start new motion session
+                #if DIGEST_MODE_ENABLED
+                sessionDigested = shouldDigestSession(currentTime);
+                #endif
                 motionSessionActive = true;
                 motionSessionStart = currentTime;
                 motionSessionNotified = false;
+                sessionTriggerCount = 1;
                 
                 #if LOG_MOTION_EVENTS
                 logMessage(2, "🚨 Motion session started!");
                 #endif
                 
-                // Send notification for new session
-                if (shouldSendNotification()) {
-                    processMotionEvent();
-                    motionSessionNotified = true;
+                #if MQTT_ENABLED
+                mqttPublishSession(true, 0);
+                mqttPublishMotion();
+                #endif
+                #if HISTORY_ENABLED
+                historyRecordTrigger(true);
+                #endif
+                
+                if (sessionDigested) {
+                    // Busy period - reported in the next digest
+                    updateMotionStatistics();
+                } else {
+                    #if LIVE_SESSION_ENABLED
+                    beginLiveSession();
+                    #endif
+                    
+                    // Send notification for new session
+                    if (shouldSendNotification()) {
+                        processMotionEvent();
+                        motionSessionNotified = true;
+                    }
                 }
+                #if EVENT_JOURNAL_ENABLED
+                journalEvent(MOTION_EVENT_SESSION_START, 0, (motionSessionNotified ? MOTION_FLAG_NOTIFIED : 0) |
+                                                            (sessionDigested ? MOTION_FLAG_DIGESTED : 0) |
+                                                            (isQuietHours() ? MOTION_FLAG_QUIET_HOURS : 0));
+                #endif
             } else {
                 // Continue existing session
+                sessionTriggerCount++;
+                #if MQTT_ENABLED
+                mqttPublishMotion();
+                #endif
+                #if EVENT_JOURNAL_ENABLED
+                journalEvent(MOTION_EVENT_TRIGGER, 0, 0);
+                #endif
+                #if HISTORY_ENABLED
+                historyRecordTrigger(false);
+                #endif
+                #if LIVE_SESSION_ENABLED
+                noteLiveSessionTrigger();
+                #endif
                 #if LOG_MOTION_EVENTS
                 logMessage(3, "📍 Motion continues in session");
                 #endif
@@ -1270,6 +5339,23 @@ void handleMotionDetection() {
             #if LOG_MOTION_EVENTS
             logMessage(2, "🏁 Motion session ended (Duration: " + String(sessionDuration) + "s)");
             #endif
+            #if MQTT_ENABLED
+            mqttPublishSession(false, sessionDuration);
+            #endif
+            #if EVENT_JOURNAL_ENABLED
+            journalEvent(MOTION_EVENT_SESSION_END, currentTime - motionSessionStart, 0);
+            #endif
+            #if HISTORY_ENABLED
+            historyRecordSessionEnd(sessionDuration);
+            #endif
+            #if LIVE_SESSION_ENABLED
+            closeLiveSession();
+            #endif
+            #if DIGEST_MODE_ENABLED
+            if (sessionDigested) {
+                addSessionToDigest(motionSessionStart, lastMotionEnd, sessionTriggerCount);
+            }
+            #endif
         }
         
         updateStatusLED();
@@ -1296,12 +5382,18 @@ void processMotionEvent() {
     
     // Check if notification should be sent
     if (shouldSendNotification()) {
+        #if CLUSTER_ENABLED
+        // The cluster leader sends one alert for all detectors that fired
+        clusterReportMotion();
+        #else
         // Minimal payload for fastest API call
         String motionMessage = ".";
         
-        sendTelegramNotification(motionMessage);
+        sendNotification(motionMessage, MESSAGE_CLASS_MOTION);
+        #endif
         lastNotificationTime = currentTime;
         dailyNotificationCount++;
+        recordNotificationInWindow();
         
         #if LOG_MOTION_EVENTS
         logMessage(2, "Motion notification sent (Daily: " + String(dailyNotificationCount) + ")");
@@ -1327,8 +5419,9 @@ bool shouldSendNotification() {
         return false;
     }
     
-    // Check daily notification limit
-    if (dailyNotificationCount >= MAX_NOTIFICATIONS_PER_HOUR && MAX_NOTIFICATIONS_PER_HOUR > 0) {
+    // Check hourly notification limit (sliding window)
+    if (MAX_NOTIFICATIONS_PER_HOUR > 0 && notificationsInLastHour() >= MAX_NOTIFICATIONS_PER_HOUR) {
+        rateLimitWindowSuppressed++;
         return false;
     }
     
@@ -1359,7 +5452,7 @@ bool isQuietHours() {
         return false;
     }
     
-    int currentHour = timeClient.getHours();
+    int currentHour = currentLocalTime().tm_hour;
     
     if (QUIET_START_HOUR < QUIET_END_HOUR) {
         // Same day quiet hours (e.g., 22:00 to 06:00 next day)
@@ -1370,34 +5463,676 @@ bool isQuietHours() {
     }
 }
 
+#if DIGEST_MODE_ENABLED
+// ===================================================================
+// MOTION DIGEST
+// ===================================================================
+
+// In busy places, sessions that start within DIGEST_QUIET_PERIOD of the
+// previous one are not alerted individually. They are summed into one
+// digest that is sent every DIGEST_FLUSH_INTERVAL, or once
+// DIGEST_FLUSH_THRESHOLD sessions have built up (at most once per
+// DIGEST_MIN_FLUSH_INTERVAL). The first session after a quiet period is
+// still alerted immediately. This caps motion messages at one per quiet
+// period plus one per flush interval, whatever the foot traffic. A digest
+// obeys the same quiet hours, spacing and hourly limit as an alert; while
+// they hold it back, sessions keep adding up in it.
+
+// Decides at session start whether the session goes into the digest
+bool shouldDigestSession(unsigned long currentTime) {
+    // lastMotionEnd still belongs to the previous session here
+    return totalMotionEvents > 0 && currentTime - lastMotionEnd < DIGEST_QUIET_PERIOD;
+}
+
+void addSessionToDigest(unsigned long sessionStart, unsigned long sessionEnd, int triggers) {
+    if (motionDigest.sessions == 0) {
+        motionDigest.openedAt = millis();
+        strlcpy(motionDigest.firstTime, getCurrentTimeString().c_str(), sizeof(motionDigest.firstTime));
+        motionDigest.triggers = 0;
+        motionDigest.longestSession = 0;
+    }
+    
+    motionDigest.sessions++;
+    motionDigest.triggers += triggers;
+    unsigned long duration = sessionEnd - sessionStart;
+    if (duration > motionDigest.longestSession) motionDigest.longestSession = duration;
+    strlcpy(motionDigest.lastTime, getCurrentTimeString().c_str(), sizeof(motionDigest.lastTime));
+}
+
+void serviceMotionDigest() {
+    if (motionDigest.sessions == 0) {
+        return;
+    }
+    
+    unsigned long now = millis();
+    bool intervalElapsed = now - motionDigest.openedAt >= DIGEST_FLUSH_INTERVAL;
+    bool thresholdReached = motionDigest.sessions >= DIGEST_FLUSH_THRESHOLD &&
+                            now - lastDigestFlush >= DIGEST_MIN_FLUSH_INTERVAL;
+    if (!intervalElapsed && !thresholdReached) {
+        return;
+    }
+    
+    if ((QUIET_HOURS_ENABLED && isQuietHours()) || !wifiConnected) {
+        return;
+    }
+    if (now - lastNotificationTime < NOTIFICATION_INTERVAL) {
+        return;
+    }
+    if (MAX_NOTIFICATIONS_PER_HOUR > 0 && notificationsInLastHour() >= MAX_NOTIFICATIONS_PER_HOUR) {
+        return;
+    }
+    flushMotionDigest();
+}
+
+void flushMotionDigest() {
+    unsigned long longest = motionDigest.longestSession / 1000;
+    
+    String message = "📋 *Motion Digest*\n";
+    message += "📍 " + String(DEVICE_LOCATION) + "\n";
+    message += "🔢 " + String(motionDigest.sessions) + " sessions, " + String(motionDigest.triggers) + " triggers\n";
+    message += "🕐 " + String(motionDigest.firstTime) + " - " + String(motionDigest.lastTime) + "\n";
+    message += "⏱️ Longest: " + String(longest / 60) + "m " + String(longest % 60) + "s";
+    sendNotification(message, MESSAGE_CLASS_MOTION);
+    
+    logMessage(2, "Motion digest sent (" + String(motionDigest.sessions) + " sessions)");
+    digestsSent++;
+    digestedSessions += motionDigest.sessions;
+    lastDigestFlush = millis();
+    lastNotificationTime = lastDigestFlush;
+    dailyNotificationCount++;
+    recordNotificationInWindow();
+    motionDigest.sessions = 0;
+}
+#endif
+
+#if HISTORY_ENABLED
+// ===================================================================
+// MOTION HISTORY
+// ===================================================================
+
+// Fixed-memory rollups of motion: per minute for the last hour, per hour
+// for the last week and per day for the last year (about 4.7 KB). Each ring
+// is indexed by the slot number of local wall-clock time, so an update is
+// one increment plus clearing the slots skipped since the previous update.
+// Session time is credited to the slot in which the session ends. The
+// rings are saved to flash every HISTORY_SAVE_INTERVAL and restored at boot.
+// Motion before the clock is first set is not recorded.
+
+struct HistoryBucket {
+    uint16_t triggers;
+    uint16_t sessions;
+    uint32_t activeSeconds;
+};
+
+struct HistoryRing {
+    const char* key;                    // Preferences key of the snapshot
+    uint32_t slotSeconds;
+    uint16_t length;
+    uint32_t lastSlot;                  // Slot number of the newest bucket, 0 if empty
+    HistoryBucket* buckets;
+};
+
+enum { HISTORY_MINUTES, HISTORY_HOURS, HISTORY_DAYS, HISTORY_RING_COUNT };
+
+HistoryBucket historyMinuteBuckets[60];
+HistoryBucket historyHourBuckets[7 * 24];
+HistoryBucket historyDayBuckets[366];
+HistoryRing historyRings[HISTORY_RING_COUNT] = {
+    {"min", 60, 60, 0, historyMinuteBuckets},
+    {"hour", 3600, 7 * 24, 0, historyHourBuckets},
+    {"day", 86400, 366, 0, historyDayBuckets},
+};
+Preferences historyPrefs;
+bool historyDirty = false;
+unsigned long lastHistorySave = 0;
+
+// Local time in seconds since the epoch, 0 if the clock is not set
+uint32_t historyClock() {
+    time_t epoch = time(nullptr);
+    if (epoch < MIN_VALID_EPOCH) {
+        return 0;
+    }
+    return epoch + TIMEZONE_OFFSET * 3600 + (DAYLIGHT_SAVING_ENABLED ? 3600 : 0);
+}
+
+// Bucket covering `now`, after clearing the slots skipped since the last update
+HistoryBucket& historyBucket(HistoryRing& ring, uint32_t now) {
+    uint32_t slot = now / ring.slotSeconds;
+    if (slot > ring.lastSlot) {
+        uint32_t skipped = slot - ring.lastSlot;
+        if (ring.lastSlot == 0 || skipped > ring.length) skipped = ring.length;
+        for (uint32_t s = slot - skipped + 1; s <= slot; s++) {
+            ring.buckets[s % ring.length] = HistoryBucket();
+        }
+        ring.lastSlot = slot;
+    } else if (ring.lastSlot - slot >= ring.length) {
+        slot = ring.lastSlot;           // Clock stepped back past the ring: use the newest slot
+    }
+    return ring.buckets[slot % ring.length];
+}
+
+void historyRecordTrigger(bool sessionStart) {
+    uint32_t now = historyClock();
+    if (now == 0) {
+        return;
+    }
+    
+    for (int i = 0; i < HISTORY_RING_COUNT; i++) {
+        HistoryBucket& bucket = historyBucket(historyRings[i], now);
+        if (bucket.triggers < 0xFFFF) bucket.triggers++;
+        if (sessionStart && bucket.sessions < 0xFFFF) bucket.sessions++;
+    }
+    historyDirty = true;
+}
+
+void historyRecordSessionEnd(unsigned long durationSeconds) {
+    uint32_t now = historyClock();
+    if (now == 0) {
+        return;
+    }
+    
+    for (int i = 0; i < HISTORY_RING_COUNT; i++) {
+        historyBucket(historyRings[i], now).activeSeconds += durationSeconds;
+    }
+    historyDirty = true;
+}
+
+void loadHistory() {
+    historyPrefs.begin("history", true);
+    for (int i = 0; i < HISTORY_RING_COUNT; i++) {
+        HistoryRing& ring = historyRings[i];
+        size_t size = ring.length * sizeof(HistoryBucket);
+        char slotKey[12];
+        snprintf(slotKey, sizeof(slotKey), "%s_at", ring.key);
+        if (historyPrefs.getBytesLength(ring.key) == size) {
+            historyPrefs.getBytes(ring.key, ring.buckets, size);
+            ring.lastSlot = historyPrefs.getUInt(slotKey, 0);
+        }
+    }
+    historyPrefs.end();
+    logMessage(3, "Motion history restored");
+}
+
+void saveHistory() {
+    historyPrefs.begin("history", false);
+    for (int i = 0; i < HISTORY_RING_COUNT; i++) {
+        HistoryRing& ring = historyRings[i];
+        char slotKey[12];
+        snprintf(slotKey, sizeof(slotKey), "%s_at", ring.key);
+        historyPrefs.putBytes(ring.key, ring.buckets, ring.length * sizeof(HistoryBucket));
+        historyPrefs.putUInt(slotKey, ring.lastSlot);
+    }
+    historyPrefs.end();
+    historyDirty = false;
+    lastHistorySave = millis();
+}
+
+void serviceHistory() {
+    if (historyDirty && millis() - lastHistorySave >= HISTORY_SAVE_INTERVAL) {
+        saveHistory();
+    }
+}
+
+// Triggers of `slot`, 0 if it is outside the ring
+uint16_t historyTriggers(const HistoryRing& ring, uint32_t slot) {
+    if (slot > ring.lastSlot || ring.lastSlot - slot >= ring.length) {
+        return 0;
+    }
+    return ring.buckets[slot % ring.length].triggers;
+}
+
+// One character per slot: "·" for none, then eight bar heights up to `peak`
+String historySparkline(const HistoryRing& ring, uint32_t firstSlot, int count, uint16_t peak) {
+    static const char* const bars[] = {"▁", "▂", "▃", "▄", "▅", "▆", "▇", "█"};
+    String line;
+    line.reserve(count * 3);
+    for (int i = 0; i < count; i++) {
+        uint16_t value = historyTriggers(ring, firstSlot + i);
+        if (value == 0) {
+            line += "·";
+        } else {
+            int level = ((uint32_t)value * 8 + peak - 1) / peak;
+            line += bars[constrain(level, 1, 8) - 1];
+        }
+    }
+    return line;
+}
+
+// Sums of the `count` slots ending with the newest one
+HistoryBucket historyTotals(const HistoryRing& ring, int count, uint16_t* peak) {
+    HistoryBucket total = {};
+    *peak = 1;
+    for (int i = 0; i < count; i++) {
+        uint32_t slot = ring.lastSlot - i;
+        if (i >= ring.length || slot > ring.lastSlot) break;
+        const HistoryBucket& bucket = ring.buckets[slot % ring.length];
+        total.triggers = min(0xFFFF, total.triggers + bucket.triggers);
+        total.sessions = min(0xFFFF, total.sessions + bucket.sessions);
+        total.activeSeconds += bucket.activeSeconds;
+        if (bucket.triggers > *peak) *peak = bucket.triggers;
+    }
+    return total;
+}
+
+String formatHistoryTotals(const HistoryBucket& total) {
+    return String(total.triggers) + " triggers, " + String(total.sessions) + " sessions, " +
+           String(total.activeSeconds / 60) + " min active";
+}
+
+String formatHistory(const char* args) {
+    uint32_t now = historyClock();
+    if (now == 0) {
+        return "⏳ Motion history needs the clock - time is not set yet";
+    }
+    for (int i = 0; i < HISTORY_RING_COUNT; i++) {
+        historyBucket(historyRings[i], now); // Age out slots without motion
+    }
+    
+    String response;
+    uint16_t peak;
+    if (strncmp(args, "week", 4) == 0) {
+        // One row per day, one column per hour
+        const HistoryRing& ring = historyRings[HISTORY_HOURS];
+        HistoryBucket total = historyTotals(ring, ring.length, &peak);
+        static const char* const weekdays[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"};
+        uint32_t today = ring.lastSlot / 24;
+        response = "📊 *Motion - last 7 days*\n```\n    0     6     12    18\n";
+        for (int d = 6; d >= 0; d--) {
+            response += String(weekdays[(today - d) % 7]) + " " + historySparkline(ring, (today - d) * 24, 24, peak) + "\n";
+        }
+        
+        // The hour of day with the most triggers over the week
+        uint32_t byHour[24] = {};
+        for (uint32_t slot = ring.lastSlot - ring.length + 1; slot <= ring.lastSlot; slot++) {
+            byHour[slot % 24] += historyTriggers(ring, slot);
+        }
+        int busiest = 0;
+        for (int h = 1; h < 24; h++) {
+            if (byHour[h] > byHour[busiest]) busiest = h;
+        }
+        response += "```\n" + formatHistoryTotals(total);
+        if (byHour[busiest] > 0) {
+            response += "\nBusiest hour: " + String(busiest) + ":00 (" + String(byHour[busiest]) + " triggers)";
+        }
+    } else if (strncmp(args, "year", 4) == 0) {
+        // One row per calendar month, one column per day
+        const HistoryRing& ring = historyRings[HISTORY_DAYS];
+        HistoryBucket total = historyTotals(ring, 365, &peak);
+        static const char* const months[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+                                             "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+        response = "📊 *Motion - last 12 months*\n```\n";
+        uint32_t first = ring.lastSlot - 364;
+        uint32_t rowStart = first;
+        int rowMonth = -1;
+        for (uint32_t day = first; day <= ring.lastSlot + 1; day++) {
+            int month = -1;
+            if (day <= ring.lastSlot) {
+                time_t dayStart = (time_t)day * 86400;
+                struct tm date;
+                gmtime_r(&dayStart, &date); // Slots are already in local time
+                month = date.tm_mon;
+            }
+            if (month != rowMonth) {
+                if (rowMonth >= 0) {
+                    response += String(months[rowMonth]) + " " + historySparkline(ring, rowStart, day - rowStart, peak) + "\n";
+                }
+                rowMonth = month;
+                rowStart = day;
+            }
+        }
+        response += "```\n" + formatHistoryTotals(total);
+    } else {
+        // Last hour, one column per minute
+        const HistoryRing& ring = historyRings[HISTORY_MINUTES];
+        HistoryBucket total = historyTotals(ring, ring.length, &peak);
+        response = "📊 *Motion - last hour*\n```\n" + historySparkline(ring, ring.lastSlot - 59, 60, peak) + "\n";
+        response += "-60m           -45m           -30m           -15m        now\n```\n";
+        response += formatHistoryTotals(total) + "\nPeak: " + String(peak) + " triggers/min";
+        
+        uint16_t dayPeak;
+        HistoryBucket today = historyTotals(historyRings[HISTORY_HOURS], 24, &dayPeak);
+        response += "\nLast 24h: " + formatHistoryTotals(today);
+    }
+    return response;
+}
+#endif
+
+#if TRACE_CAPTURE_ENABLED
+// ===================================================================
+// PIR TRACE CAPTURE
+// ===================================================================
+
+// /trace samples the PIR pin from a hardware timer interrupt and run-length
+// encodes it on the spot: the interrupt only stores a run in a ring when the
+// level changes (or a run reaches TRACE_FLUSH_INTERVAL, so idle periods
+// still reach the recorder). A task packs the runs into pir_trace.h packets
+// and writes them to the serial port, where the UART driver drains them
+// while sampling goes on. A slow port only fills the ring; runs dropped
+// then are flagged as a gap and counted in the STOP packet.
+
+#define TRACE_RING_MASK (TRACE_RING_RUNS - 1)
+#define TRACE_LEVEL_BIT 0x80000000u     // Set in a ring entry for a high run
+#define TRACE_MAX_RUN ((uint32_t)TRACE_SAMPLE_RATE * TRACE_FLUSH_INTERVAL / 1000)
+
+#if MOTION_SENSOR_PIN < 32
+#define TRACE_READ_PIN() ((REG_READ(GPIO_IN_REG) >> MOTION_SENSOR_PIN) & 1)
+#else
+#define TRACE_READ_PIN() ((REG_READ(GPIO_IN1_REG) >> (MOTION_SENSOR_PIN - 32)) & 1)
+#endif
+
+static_assert((TRACE_RING_RUNS & TRACE_RING_MASK) == 0, "TRACE_RING_RUNS must be a power of 2");
+
+hw_timer_t* traceTimer = nullptr;
+TaskHandle_t traceTaskHandle = nullptr;
+esp_pm_lock_handle_t traceClockLock = nullptr;
+volatile bool traceStopRequested = false;
+unsigned long traceStartedAt = 0;
+unsigned long traceDuration = 0;        // ms, 0 = until /trace off
+unsigned long traceFrames = 0;
+
+// Ring of completed runs; the interrupt advances the head, the task the tail
+uint32_t traceRingStart[TRACE_RING_RUNS];
+uint32_t traceRingLength[TRACE_RING_RUNS];
+volatile uint32_t traceRingHead = 0;
+volatile uint32_t traceRingTail = 0;
+volatile uint32_t traceSamples = 0;
+volatile uint32_t traceDroppedRuns = 0;
+
+// Run in progress (interrupt only while the timer runs)
+uint32_t traceRunStart = 0;
+uint32_t traceRunLength = 0;
+uint32_t traceRunLevel = 0;
+
+void IRAM_ATTR pushTraceRun() {
+    uint32_t head = traceRingHead;
+    if (head - traceRingTail < TRACE_RING_RUNS) {
+        traceRingStart[head & TRACE_RING_MASK] = traceRunStart;
+        traceRingLength[head & TRACE_RING_MASK] = traceRunLength | traceRunLevel;
+        traceRingHead = head + 1;
+    } else {
+        traceDroppedRuns++;
+    }
+}
+
+void IRAM_ATTR onTraceSample() {
+    uint32_t level = TRACE_READ_PIN() ? TRACE_LEVEL_BIT : 0;
+    if (level != traceRunLevel || traceRunLength >= TRACE_MAX_RUN) {
+        if (traceRunLength > 0) {
+            pushTraceRun();
+        }
+        traceRunStart = traceSamples;
+        traceRunLength = 0;
+        traceRunLevel = level;
+    }
+    traceRunLength++;
+    traceSamples++;
+}
+
+// One write per frame, so log lines from other tasks cannot split it
+void writeTraceFrame(PirTracePacketWriter& packet) {
+    uint8_t frame[PIR_TRACE_MAX_FRAME];
+    size_t length = packet.frame(frame);
+    Serial.write(frame, length);
+    traceFrames++;
+}
+
+void traceTask(void* parameter) {
+    PirTracePacketWriter packet;
+    uint16_t seq = 0;
+    
+    packet.begin(PIR_TRACE_START, seq++, 0);
+    packet.putU32(TRACE_SAMPLE_RATE);
+    packet.putByte(MOTION_SENSOR_PIN);
+    packet.putByte(MOTION_ACTIVE_STATE == HIGH ? 1 : 0);
+    packet.putU32(eventBootId);
+    packet.putU32(millis());
+    writeTraceFrame(packet);
+    
+    // The interrupt is allocated on this core and kept in IRAM, so flash
+    // writes (journal, history) do not delay samples
+    traceRunLevel = TRACE_READ_PIN() ? TRACE_LEVEL_BIT : 0;
+    traceTimer = timerBegin(TRACE_TIMER, 80, true); // 1 MHz from the 80 MHz APB clock
+    timerAttachInterruptFlag(traceTimer, onTraceSample, true, ESP_INTR_FLAG_IRAM);
+    timerAlarmWrite(traceTimer, 1000000 / TRACE_SAMPLE_RATE, true);
+    timerAlarmEnable(traceTimer);
+    
+    bool open = false;
+    bool gap = false;
+    bool stopping = false;
+    uint32_t nextStart = 0;             // Where the next run starts unless runs were dropped
+    uint32_t lastLevel = 0;
+    unsigned long openedAt = 0;
+    
+    while (true) {
+        if (traceStopRequested || (traceDuration > 0 && millis() - traceStartedAt >= traceDuration)) {
+            timerAlarmDisable(traceTimer);
+            timerEnd(traceTimer);
+            traceTimer = nullptr;
+            if (traceRunLength > 0) {
+                pushTraceRun(); // The run in progress is the last one
+            }
+            stopping = true;
+        }
+        
+        while (traceRingTail != traceRingHead) {
+            uint32_t slot = traceRingTail & TRACE_RING_MASK;
+            uint32_t start = traceRingStart[slot];
+            uint32_t length = traceRingLength[slot] & ~TRACE_LEVEL_BIT;
+            uint32_t level = traceRingLength[slot] & TRACE_LEVEL_BIT;
+            traceRingTail = traceRingTail + 1;
+            
+            if (start != nextStart) {
+                gap = true;
+            }
+            if (open && (gap || packet.remaining() < 10)) {
+                writeTraceFrame(packet);
+                open = false;
+            }
+            if (!open) {
+                packet.begin(PIR_TRACE_RUNS, seq++, gap ? PIR_TRACE_FLAG_GAP : 0);
+                packet.putVarint(start);
+                packet.putByte(level ? 1 : 0);
+                openedAt = millis();
+                open = true;
+                gap = false;
+            } else if (level == lastLevel) {
+                packet.putVarint(0); // Split run: empty run of the other level
+            }
+            packet.putVarint(length);
+            lastLevel = level;
+            nextStart = start + length;
+        }
+        
+        if (open && (stopping || millis() - openedAt >= TRACE_FLUSH_INTERVAL)) {
+            writeTraceFrame(packet);
+            open = false;
+        }
+        if (stopping) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(10));
+    }
+    
+    packet.begin(PIR_TRACE_STOP, seq++, 0);
+    packet.putVarint(traceSamples);
+    packet.putVarint(traceDroppedRuns);
+    writeTraceFrame(packet);
+    
+    if (traceClockLock != nullptr) {
+        esp_pm_lock_release(traceClockLock);
+    }
+    logMessage(2, "PIR trace capture ended: " + String(traceSamples) + " samples, " + String(traceFrames) +
+               " frames, " + String(traceDroppedRuns) + " runs dropped");
+    traceTaskHandle = nullptr;
+    vTaskDelete(nullptr);
+}
+
+bool startTraceCapture(unsigned long seconds) {
+    if (traceTaskHandle != nullptr) {
+        return false;
+    }
+    
+    traceRingHead = 0;
+    traceRingTail = 0;
+    traceSamples = 0;
+    traceDroppedRuns = 0;
+    traceRunStart = 0;
+    traceRunLength = 0;
+    traceFrames = 0;
+    traceStopRequested = false;
+    traceStartedAt = millis();
+    traceDuration = seconds * 1000;
+    
+    // The timer counts APB cycles, which frequency scaling would slow down
+    if (cpuScalingAutomatic) {
+        if (traceClockLock == nullptr) {
+            esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "pir_trace", &traceClockLock);
+        }
+        if (traceClockLock != nullptr) {
+            esp_pm_lock_acquire(traceClockLock);
+        }
+    }
+    
+    if (xTaskCreatePinnedToCore(traceTask, "pir_trace", TRACE_TASK_STACK, nullptr, 2, &traceTaskHandle,
+                                ARDUINO_RUNNING_CORE) != pdPASS) {
+        traceTaskHandle = nullptr;
+        if (traceClockLock != nullptr) {
+            esp_pm_lock_release(traceClockLock);
+        }
+        logMessage(1, "Failed to start PIR trace task");
+        return false;
+    }
+    logMessage(2, "PIR trace capture started at " + String(TRACE_SAMPLE_RATE) + " Hz");
+    return true;
+}
+
+void stopTraceCapture() {
+    traceStopRequested = true;
+}
+
+bool traceCaptureActive() {
+    return traceTaskHandle != nullptr;
+}
+
+String formatTraceStatus() {
+    String status = "Samples: " + String(traceSamples) + " (" + String(traceSamples / TRACE_SAMPLE_RATE) + "s)\n";
+    status += "Frames sent: " + String(traceFrames) + "\n";
+    status += "Runs dropped: " + String(traceDroppedRuns);
+    return status;
+}
+#endif
+
 // ===================================================================
 // TIME FUNCTIONS
 // ===================================================================
 
+// The system clock is kept by the IDF SNTP client in the background; until
+// its first sync it can be seeded from the Date header of a Telegram
+// response. Callers read a cache that is refreshed at most once a second,
+// so taking a timestamp never touches the network.
+
 void initializeTime() {
-    Serial.println("🕐 Initializing NTP time sync...");
+    Serial.println("🕐 Starting SNTP time sync...");
     
-    timeClient.begin();
-    timeClient.setTimeOffset(TIMEZONE_OFFSET * 3600);
+    sntp_set_time_sync_notification_cb(onTimeSync);
+    sntp_set_sync_interval(TIME_SYNC_INTERVAL);
+    configTime(TIMEZONE_OFFSET * 3600, DAYLIGHT_SAVING_ENABLED ? 3600 : 0, NTP_SERVER);
     
-    int attempts = 0;
-    while (!timeClient.update() && attempts < 5) {
-        delay(1000);
-        attempts++;
-        Serial.print(".");
+    // No waiting here - the clock is set whenever the first sync completes
+    logMessage(3, "SNTP started (" + String(NTP_SERVER) + ")");
+}
+
+// Runs on the SNTP task after every successful sync
+void onTimeSync(struct timeval* tv) {
+    timeSource = TIME_SOURCE_SNTP;
+    timeSyncCount++;
+    timeCacheStale = true;
+}
+
+// Sets the clock from an RFC 1123 HTTP date ("Sun, 06 Nov 1994 08:49:37 GMT")
+// if nothing better has set it yet
+void seedClockFromHttpDate(const char* value) {
+    if (timeSource != TIME_SOURCE_NONE) {
+        return;
     }
     
-    if (timeClient.isTimeSet()) {
-        timeInitialized = true;
-        Serial.println("\n✅ Time synchronized: " + getCurrentTimeString());
-        logMessage(2, "NTP time sync successful");
-    } else {
-        Serial.println("\n⚠️ Failed to sync time with NTP server");
-        logMessage(2, "NTP time sync failed");
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char month[4] = "";
+    int day, year, hour, minute, second;
+    if (sscanf(value, " %*3s, %d %3s %d %d:%d:%d", &day, month, &year, &hour, &minute, &second) != 6) {
+        return;
+    }
+    const char* found = strstr(months, month);
+    if (!found || strlen(month) != 3) {
+        return;
+    }
+    
+    // Days since 1970-01-01 for a proleptic Gregorian date
+    int m = (found - months) / 3 + 1;
+    int y = year - (m <= 2);
+    long era = y / 400;
+    long yearOfEra = y - era * 400;
+    long dayOfYear = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    long days = era * 146097 + dayOfEra - 719468;
+    
+    struct timeval tv = {};
+    tv.tv_sec = (time_t)days * 86400 + hour * 3600 + minute * 60 + second;
+    settimeofday(&tv, nullptr);
+    
+    timeSource = TIME_SOURCE_HTTP;
+    timeCacheStale = true;
+    logMessage(3, "Clock seeded from Telegram Date header");
+}
+
+// Returns a copy of the cached time, refreshing it at most once per second.
+// The main loop, the poll task and the notifier workers all log, so the cache
+// is only touched under timeCacheMux; the conversion itself runs on the copy
+// outside the spinlock (localtime_r may block).
+TimeCache timeCacheSnapshot() {
+    unsigned long now = millis();
+    portENTER_CRITICAL(&timeCacheMux);
+    TimeCache snapshot = timeCache;
+    bool fresh = !timeCacheStale && now - timeCache.refreshedAt < 1000;
+    if (!fresh) {
+        timeCacheStale = false;
+        timeCache.refreshedAt = now;
+    }
+    portEXIT_CRITICAL(&timeCacheMux);
+    if (fresh) {
+        return snapshot;
     }
+    
+    time_t epoch = time(nullptr);
+    if (epoch < MIN_VALID_EPOCH || epoch == snapshot.epoch) {
+        return snapshot; // Clock not set yet, or still the same second
+    }
+    
+    snapshot.epoch = epoch;
+    snapshot.refreshedAt = now;
+    localtime_r(&epoch, &snapshot.local);
+    strftime(snapshot.formatted, sizeof(snapshot.formatted), "%H:%M:%S", &snapshot.local);
+    #ifdef LOG_TIMESTAMP_FORMAT
+    snprintf(snapshot.logStamp, sizeof(snapshot.logStamp), LOG_TIMESTAMP_FORMAT,
+             snapshot.local.tm_hour, snapshot.local.tm_min, snapshot.local.tm_sec);
+    #endif
+    
+    // Another task may have published a newer second meanwhile
+    portENTER_CRITICAL(&timeCacheMux);
+    if (epoch > timeCache.epoch) {
+        timeCache = snapshot;
+    }
+    portEXIT_CRITICAL(&timeCacheMux);
+    timeInitialized = true;
+    return snapshot;
+}
+
+struct tm currentLocalTime() {
+    return timeCacheSnapshot().local;
 }
 
 String getCurrentTimeString() {
+    TimeCache cached = timeCacheSnapshot();
     if (!timeInitialized) {
         unsigned long seconds = millis() / 1000;
         unsigned long hours = seconds / 3600;
@@ -1409,8 +6144,7 @@ String getCurrentTimeString() {
         return String(timeStr);
     }
     
-    timeClient.update();
-    return timeClient.getFormattedTime();
+    return String(cached.formatted);
 }
 
 String getUptimeString() {
@@ -1431,6 +6165,110 @@ String getUptimeString() {
     return uptimeStr;
 }
 
+// ===================================================================
+// POWER MANAGEMENT
+// ===================================================================
+
+// Enables dynamic frequency scaling through esp_pm. Cores built without
+// CONFIG_PM_ENABLE reject the configuration; the clock is then switched
+// directly with setCpuFrequencyMhz() on the first/last boost instead.
+void initializePowerManagement() {
+    powerAccountingStart = millis();
+    
+    #if CPU_SCALING_ENABLED
+    cpuBoostMutex = xSemaphoreCreateMutex();
+    
+    esp_pm_config_esp32_t pmConfig = {};
+    pmConfig.max_freq_mhz = CPU_FREQUENCY;
+    pmConfig.min_freq_mhz = CPU_IDLE_FREQUENCY;
+    pmConfig.light_sleep_enable = ENABLE_LIGHT_SLEEP;
+    
+    if (esp_pm_configure(&pmConfig) == ESP_OK &&
+        esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "cpu_boost", &cpuBoostLock) == ESP_OK) {
+        cpuScalingAutomatic = true;
+        logMessage(2, "Dynamic frequency scaling: " + String(CPU_IDLE_FREQUENCY) + "-" + String(CPU_FREQUENCY) + " MHz");
+    } else {
+        setCpuFrequencyMhz(CPU_IDLE_FREQUENCY < 80 ? 80 : CPU_IDLE_FREQUENCY); // WiFi needs 80 MHz without DFS
+        logMessage(2, "esp_pm unavailable, switching CPU frequency manually");
+    }
+    #else
+    setCpuFrequencyMhz(CPU_FREQUENCY);
+    #endif
+}
+
+void cpuBoostAcquire() {
+    #if CPU_SCALING_ENABLED
+    if (cpuBoostMutex == nullptr) {
+        return; // Still booting at full clock
+    }
+    
+    xSemaphoreTake(cpuBoostMutex, portMAX_DELAY);
+    if (cpuBoostDepth++ == 0) {
+        if (cpuScalingAutomatic) {
+            esp_pm_lock_acquire(cpuBoostLock);
+        } else {
+            setCpuFrequencyMhz(CPU_FREQUENCY);
+        }
+        cpuBoostStartedAt = millis();
+        cpuBoostCount++;
+    }
+    xSemaphoreGive(cpuBoostMutex);
+    #endif
+}
+
+void cpuBoostRelease() {
+    #if CPU_SCALING_ENABLED
+    if (cpuBoostMutex == nullptr) {
+        return;
+    }
+    
+    xSemaphoreTake(cpuBoostMutex, portMAX_DELAY);
+    if (cpuBoostDepth > 0 && --cpuBoostDepth == 0) {
+        cpuBoostedMillis += millis() - cpuBoostStartedAt;
+        if (cpuScalingAutomatic) {
+            esp_pm_lock_release(cpuBoostLock);
+        } else {
+            setCpuFrequencyMhz(CPU_IDLE_FREQUENCY < 80 ? 80 : CPU_IDLE_FREQUENCY);
+        }
+    }
+    xSemaphoreGive(cpuBoostMutex);
+    #endif
+}
+
+// Time at full clock, including a boost that is still held
+unsigned long cpuBoostedTime() {
+    unsigned long boosted = cpuBoostedMillis;
+    if (cpuBoostDepth > 0) {
+        boosted += millis() - cpuBoostStartedAt;
+    }
+    return boosted;
+}
+
+// Time per frequency and an energy estimate from the CPU_*_CURRENT_MA figures
+String getPowerSummary() {
+    #if CPU_SCALING_ENABLED
+    unsigned long elapsed = millis() - powerAccountingStart;
+    unsigned long boosted = cpuBoostedTime();
+    if (boosted > elapsed) boosted = elapsed;
+    unsigned long idle = elapsed - boosted;
+    
+    // mA * ms -> mWh
+    float scaledMilliwattHours = (boosted * (float)CPU_ACTIVE_CURRENT_MA + idle * (float)CPU_IDLE_CURRENT_MA) *
+                                 SUPPLY_VOLTAGE / 3600000.0f;
+    float fixedMilliwattHours = elapsed * (float)CPU_ACTIVE_CURRENT_MA * SUPPLY_VOLTAGE / 3600000.0f;
+    float saved = fixedMilliwattHours > 0 ? 100.0f * (1.0f - scaledMilliwattHours / fixedMilliwattHours) : 0;
+    
+    float idleShare = elapsed > 0 ? 100.0f * idle / elapsed : 100.0f;
+    
+    return "Clock: " + String(CPU_FREQUENCY) + " MHz " + String(boosted / 1000.0f, 1) + "s (" + String(cpuBoostCount) +
+           " boosts), " + String(CPU_IDLE_FREQUENCY) + " MHz " + String(idleShare, 1) + "%" +
+           (cpuScalingAutomatic ? " [DFS]" : " [manual]") + "\n" +
+           "Energy: ~" + String(scaledMilliwattHours, 1) + " mWh (" + String(saved, 0) + "% below fixed clock)";
+    #else
+    return "Clock: fixed " + String(CPU_FREQUENCY) + " MHz";
+    #endif
+}
+
 // ===================================================================
 // LED AND STATUS FUNCTIONS
 // ===================================================================
@@ -1446,8 +6284,10 @@ void initializeLED() {
     pinMode(BUZZER_PIN, OUTPUT);
     #endif
     
-    // Initial LED test
-    blinkLED(3, LED_BLINK_FAST);
+    // Initial LED test (skipped on a fast boot)
+    if (!fastBoot) {
+        blinkLED(3, LED_BLINK_FAST);
+    }
     digitalWrite(LED_PIN, LOW);
     
     Serial.println("✅ LED initialized on GPIO " + String(LED_PIN));
@@ -1558,6 +6398,7 @@ void logSystemPerformance() {
     Serial.println("Total Loops: " + String(loopCount));
     Serial.println("Free Memory: " + String(ESP.getFreeHeap()) + " bytes");
     Serial.println("WiFi RSSI: " + String(WiFi.RSSI()) + " dBm");
+    Serial.println(getPowerSummary());
     
     // Reset max loop time
     maxLoopTime = 0;
@@ -1573,7 +6414,7 @@ void resetDailyCounters() {
     
     #if !PRODUCTION_MODE
     if (wifiConnected) {
-        sendTelegramNotification("📅 Daily statistics reset - New day started!");
+        sendNotification("📅 Daily statistics reset - New day started!", MESSAGE_CLASS_STATUS);
     }
     #endif
 }
@@ -1630,14 +6471,9 @@ void logMessage(int level, const String& message) {
     #if DEBUG_SERIAL
     String timestamp = "";
     #if ENABLE_TIMESTAMP_IN_MESSAGES && defined(LOG_TIMESTAMP_FORMAT)
+    TimeCache cached = timeCacheSnapshot();
     if (timeInitialized) {
-        timeClient.update();
-        char timeStr[32];
-        sprintf(timeStr, LOG_TIMESTAMP_FORMAT, 
-                timeClient.getHours(), 
-                timeClient.getMinutes(), 
-                timeClient.getSeconds());
-        timestamp = String(timeStr);
+        timestamp = String(cached.logStamp);
     }
     #endif
     
@@ -1664,7 +6500,7 @@ void handleSystemError(const String& error) {
             getCurrentTimeString().c_str()
         );
         
-        sendTelegramNotification(errorMsg);
+        sendNotification(errorMsg, MESSAGE_CLASS_ERROR);
     }
     
     // Handle specific errors
@@ -1682,6 +6518,31 @@ void handleSystemError(const String& error) {
     }
 }
 
+// Escapes text for use inside a JSON string literal
+String jsonEscape(const String& text) {
+    String escaped;
+    escaped.reserve(text.length() + 16);
+    for (unsigned int i = 0; i < text.length(); i++) {
+        char c = text[i];
+        switch (c) {
+            case '"':  escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\r': escaped += "\\r"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if ((unsigned char)c < 0x20) {
+                    char code[8];
+                    snprintf(code, sizeof(code), "\\u%04x", c);
+                    escaped += code;
+                } else {
+                    escaped += c;
+                }
+        }
+    }
+    return escaped;
+}
+
 bool validateConfiguration() {
     bool valid = true;
     